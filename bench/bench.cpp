@@ -0,0 +1,36 @@
+//
+// Created by timetraveler314 on 6/2/24.
+//
+
+#include <benchmark/benchmark.h>
+
+#include "../src/eval_env.h"
+#include "../src/tokenizer.h"
+#include "../src/parser.h"
+#include "../src/builtins.h"
+#include "../src/ndarray.h"
+#include "../src/simd.h"
+
+struct BenchCtx {
+    std::shared_ptr<EvalEnv> env = EvalEnv::createGlobal();
+
+    ValuePtr parse(const std::string& input) {
+        Tokenizer tokenizer;
+        Parser parser(tokenizer);
+        auto valueTask = parser.parse();
+        tokenizer.feed(input);
+        return valueTask.get_result().value();
+    }
+
+    ValuePtr eval(const std::string& input) {
+        return env->eval(parse(input));
+    }
+};
+
+#include "bench_env.cpp"
+#include "bench_value.cpp"
+#include "bench_number.cpp"
+#include "bench_simd.cpp"
+#include "bench_ndarray.cpp"
+
+BENCHMARK_MAIN();
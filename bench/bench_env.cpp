@@ -0,0 +1,103 @@
+//
+// Created by timetraveler314 on 6/2/24.
+//
+
+// Cost of entering a procedure / let frame
+
+static void BM_CreateChildEnv(benchmark::State& state) {
+    auto env = EvalEnv::createGlobal();
+    std::vector<ValuePtr> args {std::make_shared<NumericValue>(1.0)};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(env->createChild(args, args.size()));
+    }
+}
+BENCHMARK(BM_CreateChildEnv);
+
+static void BM_LambdaCall(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (id x) x)");
+    auto call = ctx.parse("(id 1)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_LambdaCall);
+
+static void BM_Let(benchmark::State& state) {
+    BenchCtx ctx;
+    auto expr = ctx.parse("(let ((x 1) (y 2)) (+ x y))");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(expr));
+    }
+}
+BENCHMARK(BM_Let);
+
+static void BM_Fib(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    auto call = ctx.parse("(fib " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_Fib)->Arg(15)->Unit(benchmark::kMillisecond);
+
+static void BM_FibVM(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.env->setEngine(Engine::VM);
+    ctx.eval("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    auto call = ctx.parse("(fib " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_FibVM)->Arg(15)->Unit(benchmark::kMillisecond);
+
+// Memoized recursion: each (fib k) reaches the procedure once, later calls hit the cache
+static void BM_MemoFib(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (slow-fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    auto call = ctx.parse("(fib " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        // A fresh cache per iteration
+        ctx.eval("(define fib (memoize slow-fib))");
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_MemoFib)->Arg(15)->Unit(benchmark::kMillisecond);
+
+// Calls of builtins with one and two arguments, the common case in list and numeric code
+static void BM_BuiltinCall(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (iota n) (if (= n 0) '() (cons n (iota (- n 1)))))");
+    ctx.eval("(define (sum xs acc) (if (null? xs) acc (sum (cdr xs) (+ acc (car xs)))))");
+    ctx.eval("(define xs (iota 100))");
+    auto call = ctx.parse("(sum xs 0)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_BuiltinCall);
+
+// A loop whose body recomputes constant subexpressions on every iteration
+static void BM_ConstantSubexpressions(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (seconds n acc) (if (= n 0) acc (seconds (- n 1) (+ acc (* 60 60 24) (if (> (* 2 3) 5) 1 0)))))");
+    auto call = ctx.parse("(seconds 100 0)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_ConstantSubexpressions);
+
+// Calls of a small helper procedure from a loop
+static void BM_HelperCall(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (square x) (* x x))");
+    ctx.eval("(define (sum-squares n acc) (if (= n 0) acc (sum-squares (- n 1) (+ acc (square n)))))");
+    auto call = ctx.parse("(sum-squares 100 0)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_HelperCall);
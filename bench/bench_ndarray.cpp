@@ -0,0 +1,49 @@
+//
+// Created by timetraveler314 on 6/17/24.
+//
+
+// Square matrix products: the textbook triple loop, and ndarray-matmul with
+// its cache blocking, SIMD rows and threads
+
+static std::shared_ptr<NDArrayValue> benchMatrix(size_t n) {
+    auto matrix = std::make_shared<NDArrayValue>(n, n);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) (*matrix)(i, j) = static_cast<double>((i * 7 + j * 3) % 11) - 5;
+    }
+    return matrix;
+}
+
+static void setFlops(benchmark::State& state, size_t n) {
+    state.counters["FLOPS"] = benchmark::Counter(2.0 * n * n * n, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void BM_MatmulNaive(benchmark::State& state) {
+    size_t n = state.range(0);
+    auto x = benchMatrix(n), y = benchMatrix(n);
+    for (auto _ : state) {
+        NDArrayValue result(n, n);
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                double sum = 0;
+                for (size_t p = 0; p < n; p++) sum += (*x)(i, p) * (*y)(p, j);
+                result(i, j) = sum;
+            }
+        }
+        benchmark::DoNotOptimize(result.row(0));
+    }
+    setFlops(state, n);
+}
+BENCHMARK(BM_MatmulNaive)->Arg(512)->Unit(benchmark::kMillisecond);
+
+static void BM_Matmul(benchmark::State& state) {
+    size_t n = state.range(0);
+    BenchCtx ctx;
+    ctx.env->defineBinding("x", benchMatrix(n));
+    ctx.env->defineBinding("y", benchMatrix(n));
+    auto call = ctx.parse("(ndarray-matmul x y)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+    setFlops(state, n);
+}
+BENCHMARK(BM_Matmul)->Arg(512)->Arg(2048)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,33 @@
+//
+// Created by timetraveler314 on 6/11/24.
+//
+
+// Exact integer arithmetic past the fixnum range
+
+static void BM_Factorial(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (fact n acc) (if (= n 0) acc (fact (- n 1) (* n acc))))");
+    auto call = ctx.parse("(fact " + std::to_string(state.range(0)) + " 1)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_Factorial)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+static void BM_Pow2(benchmark::State& state) {
+    BenchCtx ctx;
+    auto expr = ctx.parse("(expt 2 " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(expr));
+    }
+}
+BENCHMARK(BM_Pow2)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+// Squaring a 100000-digit number: Karatsuba against the schoolbook method
+static void BM_BigIntSquare(benchmark::State& state) {
+    auto x = BigInt::pow(7, 118000);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(state.range(0) ? x * x : BigInt::multiplySchoolbook(x, x));
+    }
+}
+BENCHMARK(BM_BigIntSquare)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
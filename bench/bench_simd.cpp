@@ -0,0 +1,64 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+// Summing a million numbers: boxed in a list, and unboxed in an f64vector at
+// each SIMD level (0 scalar, 1 SSE2, 2 AVX2)
+
+static constexpr size_t SUM_LENGTH = 1000000;
+
+static void BM_ListSum(benchmark::State& state) {
+    BenchCtx ctx;
+    std::vector<ValuePtr> numbers;
+    for (size_t i = 0; i < SUM_LENGTH; i++) numbers.push_back(Value::number(i * 0.5));
+    ctx.env->defineBinding("xs", Value::fromVector(numbers));
+    auto call = ctx.parse("(reduce + xs)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_ListSum)->Unit(benchmark::kMillisecond);
+
+static void BM_F64VectorSum(benchmark::State& state) {
+    BenchCtx ctx;
+    auto vector = std::make_shared<F64VectorValue>(SUM_LENGTH);
+    for (size_t i = 0; i < SUM_LENGTH; i++) (*vector)[i] = i * 0.5;
+    ctx.env->defineBinding("xs", vector);
+    auto call = ctx.parse("(f64vector-sum xs)");
+    auto initial = Simd::level();
+    Simd::setLevel(static_cast<Simd::Level>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+    Simd::setLevel(initial);
+}
+BENCHMARK(BM_F64VectorSum)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+static void BM_F64VectorAxpy(benchmark::State& state) {
+    std::vector<double> x(SUM_LENGTH, 1.5), y(SUM_LENGTH, 2);
+    auto initial = Simd::level();
+    Simd::setLevel(static_cast<Simd::Level>(state.range(0)));
+    for (auto _ : state) {
+        Simd::axpy(0.5, x.data(), y.data(), SUM_LENGTH);
+        benchmark::DoNotOptimize(y.data());
+    }
+    Simd::setLevel(initial);
+}
+BENCHMARK(BM_F64VectorAxpy)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+// (lambda (x) (+ (* a x) b)) over a million numbers: compiled into a batch
+// kernel, and called on each element (the `begin` keeps it from compiling)
+static void BM_ArrayMap(benchmark::State& state) {
+    BenchCtx ctx;
+    auto vector = std::make_shared<F64VectorValue>(SUM_LENGTH);
+    for (size_t i = 0; i < SUM_LENGTH; i++) (*vector)[i] = i * 0.5;
+    ctx.env->defineBinding("xs", vector);
+    ctx.eval("(define a 1.5)");
+    ctx.eval("(define b -2)");
+    auto call = ctx.parse(state.range(0) ? "(array-map (lambda (x) (+ (* a x) b)) xs)"
+                                         : "(array-map (lambda (x) (begin (+ (* a x) b))) xs)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_ArrayMap)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,129 @@
+//
+// Created by timetraveler314 on 6/6/24.
+//
+
+// Cost of type dispatch on values
+
+static void BM_TypeDispatch(benchmark::State& state) {
+    std::vector<ValuePtr> values {
+        std::make_shared<NumericValue>(1.0), std::make_shared<StringValue>("s"), std::make_shared<BooleanValue>(true),
+        std::make_shared<SymbolValue>("x"), std::make_shared<NilValue>(),
+        std::make_shared<PairValue>(std::make_shared<NumericValue>(2.0), std::make_shared<NilValue>()),
+        Builtins::builtinMap.at("+"),
+    };
+    for (auto _ : state) {
+        size_t count = 0;
+        for (const auto& value : values) {
+            count += value->is<AtomicValue>();
+            count += value->is<SelfEvaluatingValue>();
+            count += value->is<ProcedureValue>();
+            count += value->as<NumericValue>().has_value();
+        }
+        benchmark::DoNotOptimize(count);
+    }
+}
+BENCHMARK(BM_TypeDispatch);
+
+// Compiling dispatches on the type of every subexpression
+static void BM_EvalDispatch(benchmark::State& state) {
+    BenchCtx ctx;
+    auto expr = ctx.parse("(list 1 \"a\" #t 'b (quote (1 2)) (if #f 2 3))");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(expr));
+    }
+}
+BENCHMARK(BM_EvalDispatch);
+
+// Allocation throughput of cons cells
+static void BM_ListBuild(benchmark::State& state) {
+    std::vector<ValuePtr> elements(state.range(0), Value::number(1));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Value::fromVector(elements));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ListBuild)->Arg(1000);
+
+static void BM_ListTraverse(benchmark::State& state) {
+    auto list = Value::fromVector(std::vector<ValuePtr>(state.range(0), Value::number(1)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(list->toVector());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ListTraverse)->Arg(1000);
+
+static void BM_ListMap(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (range n) (if (= n 0) '() (cons n (range (- n 1)))))");
+    ctx.eval("(define l (range 1000))");
+    auto expr = ctx.parse("(map (lambda (x) (+ x 1)) l)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(expr));
+    }
+}
+BENCHMARK(BM_ListMap);
+
+// Numbers outside the small integer cache are allocated on every operation
+static void BM_FloatLoop(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (loop i acc) (if (= i 0) acc (loop (- i 1) (+ acc 0.5))))");
+    auto call = ctx.parse("(loop 10000 0)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_FloatLoop)->Unit(benchmark::kMillisecond);
+
+// Lookups of every key, in an association list and in a hash table
+static void BM_AssocLookup(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (pairs i n) (if (= i n) '() (cons (cons i (* i i)) (pairs (+ i 1) n))))");
+    ctx.eval("(define (assoc key alist) (if (equal? (car (car alist)) key) (cdr (car alist)) (assoc key (cdr alist))))");
+    ctx.eval("(define (lookup-all i n table) (if (= i n) 0 (+ (assoc i table) (lookup-all (+ i 1) n table))))");
+    ctx.eval("(define table (pairs 0 " + std::to_string(state.range(0)) + "))");
+    auto call = ctx.parse("(lookup-all 0 " + std::to_string(state.range(0)) + " table)");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_AssocLookup)->Arg(200);
+
+static void BM_HashLookup(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define table (make-hash-table))");
+    ctx.eval("(define (fill i n) (if (< i n) (begin (hash-set! table i (* i i)) (fill (+ i 1) n)) '()))");
+    ctx.eval("(define (lookup-all i n) (if (= i n) 0 (+ (hash-ref table i) (lookup-all (+ i 1) n))))");
+    ctx.eval("(fill 0 " + std::to_string(state.range(0)) + ")");
+    auto call = ctx.parse("(lookup-all 0 " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_HashLookup)->Arg(200);
+
+// Reading every element by index, from a list and from a vector
+static void BM_ListRef(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (iota i n) (if (= i n) '() (cons i (iota (+ i 1) n))))");
+    ctx.eval("(define (list-ref xs k) (if (= k 0) (car xs) (list-ref (cdr xs) (- k 1))))");
+    ctx.eval("(define (sum-all xs i n) (if (= i n) 0 (+ (list-ref xs i) (sum-all xs (+ i 1) n))))");
+    ctx.eval("(define xs (iota 0 " + std::to_string(state.range(0)) + "))");
+    auto call = ctx.parse("(sum-all xs 0 " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_ListRef)->Arg(200);
+
+static void BM_VectorRef(benchmark::State& state) {
+    BenchCtx ctx;
+    ctx.eval("(define (iota i n) (if (= i n) '() (cons i (iota (+ i 1) n))))");
+    ctx.eval("(define (sum-all xs i n) (if (= i n) 0 (+ (vector-ref xs i) (sum-all xs (+ i 1) n))))");
+    ctx.eval("(define xs (list->vector (iota 0 " + std::to_string(state.range(0)) + ")))");
+    auto call = ctx.parse("(sum-all xs 0 " + std::to_string(state.range(0)) + ")");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ctx.env->eval(call));
+    }
+}
+BENCHMARK(BM_VectorRef)->Arg(200);
@@ -0,0 +1,69 @@
+//
+// Created by timetraveler314 on 6/9/24.
+//
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+Arena::Chunk* Arena::takeChunk() {
+    if (auto chunk = freeChunks) {
+        freeChunks = chunk->next;
+        chunk->next = nullptr;
+        return chunk;
+    }
+    if (chunks.size() >= MAX_CHUNKS) return nullptr; // All pinned by live values
+    // Chunks are aligned to their size, so chunkOf() finds the header of any object
+    auto memory = std::aligned_alloc(CHUNK_SIZE, CHUNK_SIZE);
+    if (!memory) throw std::bad_alloc();
+    auto chunk = new (memory) Chunk {.top = nullptr};
+    chunk->top = begin(chunk);
+    auto start = static_cast<const std::byte*>(memory);
+    chunks.insert(std::upper_bound(chunks.begin(), chunks.end(), start), start);
+    return chunk;
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    while (true) {
+        if (current) {
+            auto address = reinterpret_cast<uintptr_t>(current->top);
+            auto aligned = (address + align - 1) & ~(align - 1);
+            if (aligned + size <= reinterpret_cast<uintptr_t>(current) + CHUNK_SIZE) {
+                current->top = reinterpret_cast<std::byte*>(aligned + size);
+                current->live++;
+                return reinterpret_cast<void*>(aligned);
+            }
+            if (current->live == 0) {
+                current->top = begin(current); // Everything in it is gone already
+                continue;
+            }
+            // Full; it goes to the free list when its last object dies
+        }
+        current = takeChunk();
+        if (!current) return nullptr;
+    }
+}
+
+void Arena::deallocate(void* pointer) {
+    auto chunk = chunkOf(pointer);
+    if (--chunk->live > 0) return;
+    chunk->top = begin(chunk);
+    if (chunk != current) {
+        chunk->next = freeChunks;
+        freeChunks = chunk;
+    }
+}
+
+void Arena::beginRegion() {
+    if (current && current->live > 0) {
+        current = nullptr;
+    }
+}
+
+bool Arena::contains(const void* pointer) const {
+    auto address = static_cast<const std::byte*>(pointer);
+    auto chunk = std::upper_bound(chunks.begin(), chunks.end(), address);
+    return chunk != chunks.begin() && address < *std::prev(chunk) + CHUNK_SIZE;
+}
@@ -0,0 +1,103 @@
+//
+// Created by timetraveler314 on 6/9/24.
+//
+
+#ifndef MINI_LISP_ARENA_H
+#define MINI_LISP_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Region allocator for short-lived values. Allocation bumps a pointer in the
+// current chunk; each chunk counts its live objects and is reused as a whole
+// once they are all gone, without freeing them one by one. The REPL starts a
+// region per top level form, so a form's temporaries share chunks that are
+// recycled together. Values that outlive their form pin their chunk; the
+// global environment, pairs, vectors and hash tables promote the ones they
+// store, see Value::promote. Whatever else stays alive pins at most
+// MAX_CHUNKS chunks: beyond them allocation falls back to the system
+// allocator until a chunk is free again.
+// Not thread-safe, like the rest of the interpreter.
+class Arena {
+    struct Chunk {
+        size_t live = 0;
+        std::byte* top;
+        Chunk* next = nullptr; // In the free list
+    };
+
+public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    // Larger requests go to the system allocator
+    static constexpr size_t MAX_OBJECT_SIZE = CHUNK_SIZE / 16;
+    static constexpr size_t MAX_CHUNKS = 64;
+
+private:
+    Chunk* current = nullptr;
+    Chunk* freeChunks = nullptr;
+    std::vector<const std::byte*> chunks; // Sorted, for contains()
+
+    static Chunk* chunkOf(const void* pointer) {
+        return reinterpret_cast<Chunk*>(reinterpret_cast<uintptr_t>(pointer) & ~(CHUNK_SIZE - 1));
+    }
+
+    static std::byte* begin(Chunk* chunk) {
+        return reinterpret_cast<std::byte*>(chunk + 1);
+    }
+
+    Chunk* takeChunk();
+
+public:
+    // Never destroyed: arena objects may outlive static destructors
+    static Arena& instance() {
+        static auto arena = new Arena;
+        return *arena;
+    }
+
+    // nullptr once MAX_CHUNKS chunks are in use and none has room
+    void* allocate(size_t size, size_t align);
+    void deallocate(void* pointer);
+
+    // Later allocations go to a fresh chunk, apart from the values of the previous region still alive
+    void beginRegion();
+
+    bool contains(const void* pointer) const;
+
+    // Chunks allocated so far, in use or free
+    size_t chunkCount() const {
+        return chunks.size();
+    }
+};
+
+// Standard allocator over the Arena, for use with std::allocate_shared
+template<class T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() = default;
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n * sizeof(T) <= Arena::MAX_OBJECT_SIZE) {
+            if (auto pointer = Arena::instance().allocate(n * sizeof(T), alignof(T))) return static_cast<T*>(pointer);
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* pointer, size_t n) {
+        if (n * sizeof(T) <= Arena::MAX_OBJECT_SIZE && Arena::instance().contains(pointer)) {
+            return Arena::instance().deallocate(pointer);
+        }
+        std::allocator<T>().deallocate(pointer, n);
+    }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>&) const {
+        return true;
+    }
+};
+
+#endif //MINI_LISP_ARENA_H
@@ -0,0 +1,308 @@
+//
+// Created by timetraveler314 on 6/18/24.
+//
+
+#include "batch.h"
+
+#include <algorithm>
+
+#include "builtins.h"
+#include "eval_env.h"
+#include "folding.h"
+#include "forms.h"
+#include "simd.h"
+
+namespace Batch {
+    struct Program {
+        // A register holding a number when the program is bound: a constant,
+        // a (depth, slot) counted from the frame the lambda was created in, or
+        // a global name
+        struct Leaf {
+            uint32_t reg;
+            std::optional<double> constant;
+            std::optional<std::pair<size_t, size_t>> local;
+            std::optional<Symbol> global;
+        };
+
+        uint32_t registers = 1;
+        std::vector<Leaf> leaves;
+        std::vector<Folding::Assumption> assumptions;
+        std::vector<Instruction> code;
+        uint32_t result = 0;
+    };
+
+    namespace {
+        enum class Operator {
+            PLUS,
+            MINUS,
+            TIMES,
+            DIVIDE,
+            ABS,
+            NOT,
+            EQUAL,
+            LESS,
+            GREATER,
+            LESS_EQUAL,
+            GREATER_EQUAL,
+        };
+
+        std::optional<Operator> findOperator(Symbol name) {
+            static const std::unordered_map<Symbol, Operator> operators = {
+                {"+", Operator::PLUS},
+                {"-", Operator::MINUS},
+                {"*", Operator::TIMES},
+                {"/", Operator::DIVIDE},
+                {"abs", Operator::ABS},
+                {"not", Operator::NOT},
+                {"=", Operator::EQUAL},
+                {"<", Operator::LESS},
+                {">", Operator::GREATER},
+                {"<=", Operator::LESS_EQUAL},
+                {">=", Operator::GREATER_EQUAL},
+            };
+            auto entry = operators.find(name);
+            return entry == operators.end() ? std::nullopt : std::optional(entry->second);
+        }
+
+        // Builds the program of a body in registers allocated one after another
+        class Builder {
+            Program program;
+            Symbol param;
+            const Compiler::ScopePtr& scope;
+            std::unordered_map<Symbol, uint32_t> variables;
+
+            uint32_t constant(double value) {
+                program.leaves.push_back({.reg = program.registers, .constant = value, .local = std::nullopt, .global = std::nullopt});
+                return program.registers++;
+            }
+
+            uint32_t variable(Symbol name) {
+                if (name == param) return 0;
+                if (auto found = variables.find(name); found != variables.end()) return found->second;
+                Program::Leaf leaf{.reg = program.registers, .constant = std::nullopt, .local = std::nullopt, .global = std::nullopt};
+                size_t depth = 0;
+                for (auto current = scope.get(); current && !leaf.local; current = current->parent.get(), depth++) {
+                    if (auto slot = current->find(name)) leaf.local = {depth, *slot};
+                }
+                if (!leaf.local) leaf.global = name;
+                program.leaves.push_back(leaf);
+                return variables[name] = program.registers++;
+            }
+
+            uint32_t emit(Op op, uint32_t x, uint32_t y = 0, uint32_t z = 0) {
+                program.code.push_back({op, program.registers, x, y, z});
+                return program.registers++;
+            }
+
+            // The operator `name` means, if it is one of those above and no local variable shadows it
+            std::optional<Operator> builtin(Symbol name) {
+                auto op = findOperator(name);
+                if (!op || name == param) return std::nullopt;
+                for (auto current = scope.get(); current; current = current->parent.get()) {
+                    if (current->find(name)) return std::nullopt;
+                }
+                if (std::ranges::none_of(program.assumptions, [&](const Folding::Assumption& a) { return a.name == name; })) {
+                    program.assumptions.push_back({name, Builtins::builtinMap.at(name)});
+                }
+                return op;
+            }
+
+            static std::optional<std::pair<Symbol, std::vector<ValuePtr>>> call(const ValuePtr& expr) {
+                auto pair = valueCast<PairValue>(expr);
+                if (!pair || !pair->isList()) return std::nullopt;
+                auto head = pair->getCar()->asSymbol();
+                if (!head) return std::nullopt;
+                return std::pair(*head, pair->getCdr()->toVector());
+            }
+
+        public:
+            Builder(Symbol param, const Compiler::ScopePtr& scope): param{param}, scope{scope} {}
+
+            // The register of a numeric expression
+            std::optional<uint32_t> number(const ValuePtr& expr) {
+                if (expr->isNumber() && !expr->is<BignumValue>()) return constant(*expr->asNumber());
+                if (auto symbol = expr->asSymbol()) return variable(*symbol);
+                auto form = call(expr);
+                if (!form) return std::nullopt;
+                auto& [head, operands] = *form;
+
+                if (head == Symbol::IF) {
+                    if (operands.size() != 3) return std::nullopt;
+                    auto test = condition(operands[0]);
+                    auto then = test ? number(operands[1]) : std::nullopt;
+                    auto otherwise = then ? number(operands[2]) : std::nullopt;
+                    if (!otherwise) return std::nullopt;
+                    auto [mask, negated] = *test;
+                    return negated ? emit(Op::SELECT, mask, *otherwise, *then) : emit(Op::SELECT, mask, *then, *otherwise);
+                }
+                if (SpecialForms::SPECIAL_FORMS.contains(head)) return std::nullopt;
+                auto op = builtin(head);
+                if (!op) return std::nullopt;
+                std::vector<uint32_t> args;
+                for (const auto& operand : operands) {
+                    auto arg = number(operand);
+                    if (!arg) return std::nullopt;
+                    args.push_back(*arg);
+                }
+
+                switch (*op) {
+                    case Operator::PLUS:
+                    case Operator::TIMES: {
+                        // Folded from the left, like the builtins. Adding 0 turns -0.0 into 0.
+                        bool plus = *op == Operator::PLUS;
+                        if (args.empty()) return constant(plus ? 0 : 1);
+                        auto result = plus && args.size() == 1 ? emit(Op::ADD, constant(0), args[0]) : args[0];
+                        for (size_t i = 1; i < args.size(); i++) result = emit(plus ? Op::ADD : Op::MUL, result, args[i]);
+                        return result;
+                    }
+                    case Operator::MINUS:
+                        if (args.size() == 1) return emit(Op::SUB, constant(0), args[0]);
+                        if (args.size() == 2) return emit(Op::SUB, args[0], args[1]);
+                        return std::nullopt;
+                    case Operator::DIVIDE:
+                        if (args.size() == 1) return emit(Op::DIV, constant(1), args[0]);
+                        if (args.size() == 2) return emit(Op::DIV, args[0], args[1]);
+                        return std::nullopt;
+                    case Operator::ABS:
+                        if (args.size() == 1) return emit(Op::ABS, args[0]);
+                        return std::nullopt;
+                    default:
+                        return std::nullopt; // Booleans are no numbers
+                }
+            }
+
+            // The register of the mask of a test, and whether the test is its negation
+            std::optional<std::pair<uint32_t, bool>> condition(const ValuePtr& expr) {
+                auto form = call(expr);
+                if (!form) return std::nullopt;
+                auto& [head, operands] = *form;
+                if (SpecialForms::SPECIAL_FORMS.contains(head)) return std::nullopt;
+                auto op = builtin(head);
+                if (!op) return std::nullopt;
+
+                if (*op == Operator::NOT) {
+                    if (operands.size() != 1) return std::nullopt;
+                    auto test = condition(operands[0]);
+                    if (!test) return std::nullopt;
+                    return std::pair(test->first, !test->second);
+                }
+                if (operands.size() != 2) return std::nullopt;
+                auto x = number(operands[0]);
+                auto y = x ? number(operands[1]) : std::nullopt;
+                if (!y) return std::nullopt;
+                switch (*op) {
+                    case Operator::EQUAL: return std::pair(emit(Op::EQUAL, *x, *y), false);
+                    case Operator::LESS: return std::pair(emit(Op::LESS, *x, *y), false);
+                    case Operator::GREATER: return std::pair(emit(Op::LESS, *y, *x), false);
+                    case Operator::LESS_EQUAL: return std::pair(emit(Op::LESS_EQUAL, *x, *y), false);
+                    case Operator::GREATER_EQUAL: return std::pair(emit(Op::LESS_EQUAL, *y, *x), false);
+                    default: return std::nullopt;
+                }
+            }
+
+            ProgramPtr finish(uint32_t result) {
+                if (program.registers > MAX_REGISTERS) return nullptr;
+                program.result = result;
+                return std::make_shared<const Program>(std::move(program));
+            }
+        };
+
+        // An instruction on numbers that do not depend on the argument,
+        // nothing for a division by zero
+        std::optional<double> evaluate(const Instruction& instruction, const std::vector<double>& values) {
+            double x = values[instruction.x], y = values[instruction.y];
+            double result;
+            switch (instruction.op) {
+                case Op::ADD: Simd::add(&x, &y, &result, 1); break;
+                case Op::SUB: Simd::sub(&x, &y, &result, 1); break;
+                case Op::MUL: Simd::mul(&x, &y, &result, 1); break;
+                case Op::DIV:
+                    if (y == 0) return std::nullopt;
+                    Simd::div(&x, &y, &result, 1);
+                    break;
+                case Op::ABS: Simd::abs(&x, &result, 1); break;
+                case Op::LESS: Simd::less(&x, &y, &result, 1); break;
+                case Op::LESS_EQUAL: Simd::lessEqual(&x, &y, &result, 1); break;
+                case Op::EQUAL: Simd::equal(&x, &y, &result, 1); break;
+                case Op::SELECT: Simd::select(&x, &y, &values[instruction.z], &result, 1); break;
+            }
+            return result;
+        }
+    }
+
+    ProgramPtr compile(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const Compiler::ScopePtr& scope) {
+        if (params.size() != 1 || body.size() != 1) return nullptr;
+        Builder builder(params[0], scope);
+        auto result = builder.number(body[0]);
+        return result ? builder.finish(*result) : nullptr;
+    }
+
+    std::optional<Kernel> bind(const LambdaValue& lambda) {
+        auto& program = lambda.getProgram();
+        if (!program) return std::nullopt;
+        auto& env = *lambda.getEnv();
+        auto& globalEnv = env.global();
+        for (const auto& assumption : program->assumptions) {
+            auto binding = globalEnv.lookupSlot(assumption.name);
+            if (!binding || *binding != assumption.builtin) return std::nullopt;
+        }
+
+        // Registers not depending on the argument are computed here once
+        std::vector<double> values(program->registers);
+        std::vector<bool> varying(program->registers);
+        varying[0] = true;
+        for (const auto& leaf : program->leaves) {
+            if (leaf.constant) {
+                values[leaf.reg] = *leaf.constant;
+                continue;
+            }
+            auto value = leaf.local ? std::optional(env.local(leaf.local->first, leaf.local->second)) : globalEnv.lookupBinding(*leaf.global);
+            if (!value || !*value || !(*value)->isNumber() || (*value)->is<BignumValue>()) return std::nullopt;
+            values[leaf.reg] = *(*value)->asNumber();
+        }
+
+        Kernel kernel;
+        for (const auto& instruction : program->code) {
+            if (varying[instruction.x] || varying[instruction.y] || (instruction.op == Op::SELECT && varying[instruction.z])) {
+                varying[instruction.out] = true;
+                kernel.code.push_back(instruction);
+            } else if (auto value = evaluate(instruction, values)) {
+                values[instruction.out] = *value;
+            } else {
+                return std::nullopt;
+            }
+        }
+        kernel.registers.resize(program->registers * SIZE);
+        for (uint32_t reg = 1; reg < program->registers; reg++) {
+            if (!varying[reg]) std::fill_n(kernel.registers.data() + reg * SIZE, SIZE, values[reg]);
+        }
+        kernel.result = program->result;
+        return kernel;
+    }
+
+    bool Kernel::run(const double* in, double* out, size_t n) {
+        auto column = [&](uint32_t reg) -> const double* {
+            return reg == 0 ? in : registers.data() + reg * SIZE;
+        };
+        for (const auto& instruction : code) {
+            auto x = column(instruction.x), y = column(instruction.y);
+            auto result = registers.data() + instruction.out * SIZE;
+            switch (instruction.op) {
+                case Op::ADD: Simd::add(x, y, result, n); break;
+                case Op::SUB: Simd::sub(x, y, result, n); break;
+                case Op::MUL: Simd::mul(x, y, result, n); break;
+                case Op::DIV:
+                    if (std::any_of(y, y + n, [](double divisor) { return divisor == 0; })) return false;
+                    Simd::div(x, y, result, n);
+                    break;
+                case Op::ABS: Simd::abs(x, result, n); break;
+                case Op::LESS: Simd::less(x, y, result, n); break;
+                case Op::LESS_EQUAL: Simd::lessEqual(x, y, result, n); break;
+                case Op::EQUAL: Simd::equal(x, y, result, n); break;
+                case Op::SELECT: Simd::select(x, y, column(instruction.z), result, n); break;
+            }
+        }
+        std::copy_n(column(result), n, out);
+        return true;
+    }
+}
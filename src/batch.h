@@ -0,0 +1,74 @@
+//
+// Created by timetraveler314 on 6/18/24.
+//
+
+#ifndef MINI_LISP_BATCH_H
+#define MINI_LISP_BATCH_H
+
+#include <optional>
+#include <vector>
+
+#include "compiler.h"
+
+// Numeric procedures run over arrays a batch of elements at a time. A lambda
+// of one parameter whose body is built from numbers, variables, the
+// arithmetic builtins (+ - * / abs) and `if`s testing comparisons (= < > <= >=,
+// possibly under `not`) is compiled into a Program along with its code. The
+// Program evaluates the body for SIZE elements at once, each operation a
+// kernel from simd.h over a column of SIZE doubles.
+//
+// Like folded code (see folding.h), a Program assumes the operators still
+// mean the builtins, and its variables are read when it is bound to a lambda:
+// bind() gives up when either does not hold, and the lambda is called as usual.
+//
+// The kernels compute on doubles where the builtins keep integers exact, so
+// results beyond 2^53 may round differently, and zeros may come out negative.
+namespace Batch {
+    // Elements run through the program at a time
+    constexpr size_t SIZE = 256;
+    // Registers a program may use, each a column of SIZE doubles
+    constexpr size_t MAX_REGISTERS = 64;
+
+    enum class Op : uint8_t {
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        ABS,
+        LESS,       // The comparisons make masks, see Simd::less
+        LESS_EQUAL,
+        EQUAL,
+        SELECT,     // x ? y : z, x a mask
+    };
+
+    // out = x op y. Register 0 holds the argument.
+    struct Instruction {
+        Op op;
+        uint32_t out, x, y, z;
+    };
+
+    struct Program;
+    using ProgramPtr = std::shared_ptr<const Program>;
+
+    // The program of a lambda with `params` and `body` created in `scope`, null if it is not of the form above
+    ProgramPtr compile(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const Compiler::ScopePtr& scope);
+
+    // A program with its variables bound to their values
+    class Kernel {
+        std::vector<Instruction> code;  // The instructions that depend on the argument
+        std::vector<double> registers;  // Columns, those not depending on the argument filled in
+        uint32_t result = 0;
+
+        friend std::optional<Kernel> bind(const LambdaValue& lambda);
+
+    public:
+        // out[i] = lambda(in[i]) for n <= SIZE elements. False if an element
+        // would divide by zero, for the lambda to be called on the batch instead.
+        bool run(const double* in, double* out, size_t n);
+    };
+
+    // The kernel of `lambda`, if it has a program whose assumptions hold and whose variables hold numbers
+    std::optional<Kernel> bind(const LambdaValue& lambda);
+}
+
+#endif //MINI_LISP_BATCH_H
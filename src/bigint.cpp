@@ -0,0 +1,343 @@
+//
+// Created by timetraveler314 on 6/11/24.
+//
+
+#include "bigint.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <span>
+
+namespace {
+    using Limb = BigInt::Limb;
+    using Limbs = std::vector<Limb>;
+    using Magnitude = std::span<const Limb>;
+
+    constexpr uint64_t BASE = uint64_t{1} << 32;
+
+    void trim(Limbs& x) {
+        while (!x.empty() && x.back() == 0) x.pop_back();
+    }
+
+    Magnitude trimmed(Magnitude x) {
+        while (!x.empty() && x.back() == 0) x = x.first(x.size() - 1);
+        return x;
+    }
+
+    int compareMagnitude(Magnitude x, Magnitude y) {
+        if (x.size() != y.size()) return x.size() < y.size() ? -1 : 1;
+        for (size_t i = x.size(); i-- > 0;) {
+            if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // r += x * BASE^offset
+    void addInto(Limbs& r, Magnitude x, size_t offset) {
+        if (r.size() < x.size() + offset) r.resize(x.size() + offset);
+        uint64_t carry = 0;
+        size_t i = offset;
+        for (auto limb : x) {
+            uint64_t sum = uint64_t{r[i]} + limb + carry;
+            r[i++] = static_cast<Limb>(sum);
+            carry = sum >> 32;
+        }
+        for (; carry; i++) {
+            if (i == r.size()) r.push_back(0);
+            uint64_t sum = uint64_t{r[i]} + carry;
+            r[i] = static_cast<Limb>(sum);
+            carry = sum >> 32;
+        }
+    }
+
+    // r -= x, where r >= x
+    void subtractFrom(Limbs& r, Magnitude x) {
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < r.size() && (i < x.size() || borrow); i++) {
+            uint64_t subtrahend = (i < x.size() ? x[i] : 0) + borrow;
+            borrow = r[i] < subtrahend;
+            r[i] = static_cast<Limb>(r[i] - subtrahend);
+        }
+        trim(r);
+    }
+
+    Limbs add(Magnitude x, Magnitude y) {
+        Limbs result(x.begin(), x.end());
+        addInto(result, y, 0);
+        return result;
+    }
+
+    // r = r * factor + addend
+    void multiplyAdd(Limbs& r, Limb factor, Limb addend) {
+        uint64_t carry = addend;
+        for (auto& limb : r) {
+            uint64_t product = uint64_t{limb} * factor + carry;
+            limb = static_cast<Limb>(product);
+            carry = product >> 32;
+        }
+        if (carry) r.push_back(static_cast<Limb>(carry));
+    }
+
+    // r = r / divisor, returns the remainder
+    Limb divideSmall(Limbs& r, Limb divisor) {
+        uint64_t remainder = 0;
+        for (size_t i = r.size(); i-- > 0;) {
+            uint64_t current = remainder << 32 | r[i];
+            r[i] = static_cast<Limb>(current / divisor);
+            remainder = current % divisor;
+        }
+        trim(r);
+        return static_cast<Limb>(remainder);
+    }
+
+    Limbs multiplySchoolbook(Magnitude x, Magnitude y) {
+        Limbs result(x.size() + y.size());
+        for (size_t i = 0; i < x.size(); i++) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < y.size(); j++) {
+                // At most (BASE - 1)^2 + 2 (BASE - 1), which fits 64 bits
+                uint64_t t = uint64_t{x[i]} * y[j] + result[i + j] + carry;
+                result[i + j] = static_cast<Limb>(t);
+                carry = t >> 32;
+            }
+            result[i + y.size()] = static_cast<Limb>(carry);
+        }
+        trim(result);
+        return result;
+    }
+
+    Limbs multiplyKaratsuba(Magnitude x, Magnitude y) {
+        x = trimmed(x);
+        y = trimmed(y);
+        if (x.size() < y.size()) std::swap(x, y);
+        if (y.size() < BigInt::KARATSUBA_THRESHOLD) {
+            return multiplySchoolbook(x, y);
+        }
+        if (2 * y.size() <= x.size()) {
+            // Unbalanced: multiply y by slices of x as long as y
+            Limbs result;
+            for (size_t i = 0; i < x.size(); i += y.size()) {
+                addInto(result, multiplyKaratsuba(x.subspan(i, std::min(y.size(), x.size() - i)), y), i);
+            }
+            trim(result);
+            return result;
+        }
+        // With x = x1 B + x0 and y = y1 B + y0, where B = BASE^m:
+        // x y = z2 B^2 + z1 B + z0, z1 = (x0 + x1)(y0 + y1) - z2 - z0
+        size_t m = x.size() / 2;
+        auto x0 = x.first(m), x1 = x.subspan(m);
+        auto y0 = y.first(m), y1 = y.subspan(m);
+        auto z0 = multiplyKaratsuba(x0, y0);
+        auto z2 = multiplyKaratsuba(x1, y1);
+        auto z1 = multiplyKaratsuba(add(x0, x1), add(y0, y1));
+        subtractFrom(z1, z0);
+        subtractFrom(z1, z2);
+
+        Limbs result;
+        result.reserve(x.size() + y.size() + 1);
+        result.assign(z0.begin(), z0.end());
+        addInto(result, z1, m);
+        addInto(result, z2, 2 * m);
+        trim(result);
+        return result;
+    }
+
+    // Long division of magnitudes, Knuth's Algorithm D (TAOCP 4.3.1)
+    std::pair<Limbs, Limbs> divideMagnitude(Magnitude u, Magnitude v) {
+        if (compareMagnitude(u, v) < 0) {
+            return {{}, Limbs(u.begin(), u.end())};
+        }
+        if (v.size() == 1) {
+            Limbs quotient(u.begin(), u.end());
+            auto remainder = divideSmall(quotient, v[0]);
+            return {quotient, remainder ? Limbs{remainder} : Limbs{}};
+        }
+
+        // Shift both so the top limb of the divisor has its high bit set,
+        // which keeps the estimate of each quotient limb off by at most 2
+        size_t n = v.size(), m = u.size() - n;
+        int shift = std::countl_zero(v.back());
+        auto shifted = [shift](Magnitude x, size_t i) -> Limb {
+            Limb high = i < x.size() ? x[i] << shift : 0;
+            Limb low = i > 0 && shift ? x[i - 1] >> (32 - shift) : 0;
+            return high | low;
+        };
+        Limbs vn(n), un(u.size() + 1);
+        for (size_t i = 0; i < n; i++) vn[i] = shifted(v, i);
+        for (size_t i = 0; i <= u.size(); i++) un[i] = shifted(u, i);
+
+        Limbs quotient(m + 1);
+        for (size_t j = m + 1; j-- > 0;) {
+            uint64_t numerator = uint64_t{un[j + n]} << 32 | un[j + n - 1];
+            uint64_t qhat = numerator / vn[n - 1];
+            uint64_t rhat = numerator % vn[n - 1];
+            while (qhat >= BASE || qhat * vn[n - 2] > (rhat << 32 | un[j + n - 2])) {
+                qhat--;
+                rhat += vn[n - 1];
+                if (rhat >= BASE) break;
+            }
+
+            // un[j..j+n] -= qhat * vn
+            int64_t borrow = 0, t;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t product = qhat * vn[i];
+                t = un[i + j] - borrow - static_cast<int64_t>(product & 0xFFFFFFFF);
+                un[i + j] = static_cast<Limb>(t);
+                borrow = static_cast<int64_t>(product >> 32) - (t >> 32);
+            }
+            t = un[j + n] - borrow;
+            un[j + n] = static_cast<Limb>(t);
+
+            if (t < 0) {
+                // qhat was one too large, add vn back
+                qhat--;
+                uint64_t carry = 0;
+                for (size_t i = 0; i < n; i++) {
+                    uint64_t sum = uint64_t{un[i + j]} + vn[i] + carry;
+                    un[i + j] = static_cast<Limb>(sum);
+                    carry = sum >> 32;
+                }
+                un[j + n] = static_cast<Limb>(un[j + n] + carry);
+            }
+            quotient[j] = static_cast<Limb>(qhat);
+        }
+
+        Limbs remainder(n);
+        for (size_t i = 0; i < n; i++) {
+            remainder[i] = un[i] >> shift | (shift ? static_cast<Limb>(uint64_t{un[i + 1]} << (32 - shift)) : 0);
+        }
+        trim(quotient);
+        trim(remainder);
+        return {quotient, remainder};
+    }
+}
+
+BigInt::BigInt(bool negative, std::vector<Limb> limbs): limbs{std::move(limbs)} {
+    trim(this->limbs);
+    this->negative = negative && !this->limbs.empty();
+}
+
+BigInt::BigInt(int64_t value): negative{value < 0} {
+    auto magnitude = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    for (; magnitude; magnitude >>= 32) {
+        limbs.push_back(static_cast<Limb>(magnitude));
+    }
+}
+
+std::optional<BigInt> BigInt::parse(std::string_view text) {
+    bool negative = !text.empty() && text[0] == '-';
+    if (!text.empty() && (text[0] == '-' || text[0] == '+')) text.remove_prefix(1);
+    if (text.empty() || !std::ranges::all_of(text, [](char c) { return '0' <= c && c <= '9'; })) {
+        return std::nullopt;
+    }
+    // Nine decimal digits at a time fit a limb
+    Limbs limbs;
+    for (size_t i = 0; i < text.size();) {
+        size_t length = std::min<size_t>(9, text.size() - i);
+        Limb chunk = 0, scale = 1;
+        for (size_t j = 0; j < length; j++, i++) {
+            chunk = chunk * 10 + (text[i] - '0');
+            scale *= 10;
+        }
+        multiplyAdd(limbs, scale, chunk);
+    }
+    return BigInt(negative, std::move(limbs));
+}
+
+std::optional<int64_t> BigInt::toInt64() const {
+    if (limbs.size() > 2) return std::nullopt;
+    uint64_t magnitude = 0;
+    for (size_t i = limbs.size(); i-- > 0;) {
+        magnitude = magnitude << 32 | limbs[i];
+    }
+    if (negative) {
+        if (magnitude > uint64_t{1} << 63) return std::nullopt;
+        return static_cast<int64_t>(0 - magnitude);
+    }
+    if (magnitude >= uint64_t{1} << 63) return std::nullopt;
+    return static_cast<int64_t>(magnitude);
+}
+
+double BigInt::toDouble() const {
+    // The top three limbs hold more bits than a double keeps
+    double result = 0;
+    size_t top = std::min<size_t>(3, limbs.size());
+    for (size_t i = 0; i < top; i++) {
+        result = result * static_cast<double>(BASE) + limbs[limbs.size() - 1 - i];
+    }
+    result = std::ldexp(result, static_cast<int>(32 * (limbs.size() - top)));
+    return negative ? -result : result;
+}
+
+std::string BigInt::toString() const {
+    if (limbs.empty()) return "0";
+    // Peel off nine decimal digits at a time, least significant first
+    Limbs magnitude = limbs;
+    std::vector<Limb> chunks;
+    while (!magnitude.empty()) {
+        chunks.push_back(divideSmall(magnitude, 1000000000));
+    }
+    std::string result = negative ? "-" : "";
+    result += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        auto digits = std::to_string(chunks[i]);
+        result.append(9 - digits.size(), '0');
+        result += digits;
+    }
+    return result;
+}
+
+int BigInt::compare(const BigInt& x, const BigInt& y) {
+    if (x.negative != y.negative) return x.negative ? -1 : 1;
+    auto result = compareMagnitude(x.limbs, y.limbs);
+    return x.negative ? -result : result;
+}
+
+BigInt BigInt::operator-() const {
+    return BigInt(!negative, limbs);
+}
+
+BigInt BigInt::abs() const {
+    return BigInt(false, limbs);
+}
+
+BigInt operator+(const BigInt& x, const BigInt& y) {
+    if (x.negative == y.negative) {
+        return BigInt(x.negative, add(x.limbs, y.limbs));
+    }
+    // Opposite signs: the larger magnitude decides the sign
+    bool xLarger = compareMagnitude(x.limbs, y.limbs) >= 0;
+    const auto& larger = xLarger ? x : y;
+    const auto& smaller = xLarger ? y : x;
+    auto magnitude = larger.limbs;
+    subtractFrom(magnitude, smaller.limbs);
+    return BigInt(larger.negative, std::move(magnitude));
+}
+
+BigInt operator-(const BigInt& x, const BigInt& y) {
+    return x + -y;
+}
+
+BigInt operator*(const BigInt& x, const BigInt& y) {
+    return BigInt(x.negative != y.negative, multiplyKaratsuba(x.limbs, y.limbs));
+}
+
+std::pair<BigInt, BigInt> BigInt::divide(const BigInt& x, const BigInt& y) {
+    auto [quotient, remainder] = divideMagnitude(x.limbs, y.limbs);
+    return {BigInt(x.negative != y.negative, std::move(quotient)), BigInt(x.negative, std::move(remainder))};
+}
+
+BigInt BigInt::pow(BigInt base, uint64_t exponent) {
+    BigInt result(1);
+    while (exponent > 0) {
+        if (exponent & 1) result = result * base;
+        exponent >>= 1;
+        if (exponent > 0) base = base * base;
+    }
+    return result;
+}
+
+BigInt BigInt::multiplySchoolbook(const BigInt& x, const BigInt& y) {
+    return BigInt(x.negative != y.negative, ::multiplySchoolbook(x.limbs, y.limbs));
+}
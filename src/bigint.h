@@ -0,0 +1,81 @@
+//
+// Created by timetraveler314 on 6/11/24.
+//
+
+#ifndef MINI_LISP_BIGINT_H
+#define MINI_LISP_BIGINT_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Arbitrary-precision integer: a sign and a magnitude of 32-bit limbs, least
+// significant first. The magnitude has no leading zero limbs, so zero has no
+// limbs at all (and is never negative).
+class BigInt {
+public:
+    using Limb = uint32_t;
+
+    // Products of operands with fewer limbs are computed by the schoolbook
+    // method, larger ones by Karatsuba's
+    static constexpr size_t KARATSUBA_THRESHOLD = 32;
+
+private:
+    bool negative = false;
+    std::vector<Limb> limbs;
+
+    BigInt(bool negative, std::vector<Limb> limbs);
+
+public:
+    BigInt() = default;
+    BigInt(int64_t value);
+
+    // Decimal digits with an optional sign
+    static std::optional<BigInt> parse(std::string_view text);
+
+    bool isZero() const {
+        return limbs.empty();
+    }
+
+    bool isNegative() const {
+        return negative;
+    }
+
+    bool isEven() const {
+        return limbs.empty() || (limbs[0] & 1) == 0;
+    }
+
+    // Size of the magnitude in limbs
+    size_t size() const {
+        return limbs.size();
+    }
+
+    std::optional<int64_t> toInt64() const;
+    // The nearest double, infinite if out of range
+    double toDouble() const;
+    std::string toString() const;
+
+    static int compare(const BigInt& x, const BigInt& y);
+    bool operator==(const BigInt& other) const = default;
+
+    BigInt operator-() const;
+    BigInt abs() const;
+    friend BigInt operator+(const BigInt& x, const BigInt& y);
+    friend BigInt operator-(const BigInt& x, const BigInt& y);
+    friend BigInt operator*(const BigInt& x, const BigInt& y);
+
+    // Truncating division: the quotient rounds toward zero and the remainder
+    // takes the sign of x. `y` must not be zero.
+    static std::pair<BigInt, BigInt> divide(const BigInt& x, const BigInt& y);
+
+    // By repeated squaring
+    static BigInt pow(BigInt base, uint64_t exponent);
+
+    // Schoolbook multiplication at any size, to check and measure Karatsuba against
+    static BigInt multiplySchoolbook(const BigInt& x, const BigInt& y);
+};
+
+#endif //MINI_LISP_BIGINT_H
@@ -2,116 +2,371 @@
 // Created by timetraveler314 on 5/4/24.
 //
 
-#include <numeric>
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <cmath>
 #include <cfenv>
+#include <new>
+#include <stdexcept>
+#include "batch.h"
 #include "builtins.h"
 #include "eval_env.h"
+#include "memo.h"
+#include "number.h"
+#include "simd.h"
 
-const std::unordered_map<std::string, ValuePtr> Builtins::builtinMap = {
+namespace {
+    using Utils::FastPath;
+
+    ValuePtr builtin(const BuiltinSpec& spec) {
+        return std::make_shared<BuiltinProcValue>(spec);
+    }
+
+    bool isEq(const ValuePtr& x, const ValuePtr& y) {
+        if (x->is<BooleanValue>() || x->isNumber() || x->is<ProcedureValue>() || x->is<SymbolValue>() || x->is<NilValue>()) {
+            return x->isEqual(y);
+        } else if (x->is<StringValue>() || x->is<PairValue>() || x->is<VectorValue>() || x->is<HashTableValue>() ||
+               x->is<F64VectorValue>() || x->is<NDArrayValue>()) {
+            return x == y;
+        }
+        return false;
+    }
+
+    // The array `make` returns, holding `length` elements; lengths beyond memory are errors
+    template<typename F>
+    ValuePtr allocate(const char* name, int64_t length, F make) {
+        try {
+            return make();
+        } catch (const std::bad_alloc&) {
+            throw LispError(std::format("{}: cannot allocate {} elements", name, length));
+        } catch (const std::length_error&) {
+            throw LispError(std::format("{}: cannot allocate {} elements", name, length));
+        }
+    }
+
+    void checkIndex(const char* name, const VectorValue& vector, int64_t index) {
+        if (index < 0 || static_cast<size_t>(index) >= vector.size()) {
+            throw LispError(std::format("{}: index {} out of range for a vector of length {}", name, index, vector.size()));
+        }
+    }
+
+    void checkIndex(const char* name, const F64VectorValue& vector, int64_t index) {
+        if (index < 0 || static_cast<size_t>(index) >= vector.size()) {
+            throw LispError(std::format("{}: index {} out of range for an f64vector of length {}", name, index, vector.size()));
+        }
+    }
+
+    void checkLengths(const char* name, const F64VectorValue& x, const F64VectorValue& y) {
+        if (x.size() != y.size()) {
+            throw LispError(std::format("{}: f64vectors of different lengths {} and {}", name, x.size(), y.size()));
+        }
+    }
+
+    void checkIndex(const char* name, const NDArrayValue& array, int64_t row, int64_t col) {
+        if (row < 0 || static_cast<size_t>(row) >= array.rows() || col < 0 || static_cast<size_t>(col) >= array.cols()) {
+            throw LispError(std::format("{}: index ({}, {}) out of range for an ndarray of shape ({}, {})",
+                                        name, row, col, array.rows(), array.cols()));
+        }
+    }
+
+    void checkShapes(const char* name, const NDArrayValue& x, const NDArrayValue& y) {
+        if (x.rows() != y.rows() || x.cols() != y.cols()) {
+            throw LispError(std::format("{}: ndarrays of different shapes ({}, {}) and ({}, {})",
+                                        name, x.rows(), x.cols(), y.rows(), y.cols()));
+        }
+    }
+
+    using Kernel = void (*)(const double* x, const double* y, double* out, size_t n);
+
+    ValuePtr elementwise(const char* name, Arguments params, Kernel kernel) {
+        auto [x, y] = Utils::resolveParams(name, params, Utils::isF64Vector, Utils::isF64Vector);
+        checkLengths(name, x, y);
+        auto result = std::make_shared<F64VectorValue>(x.size());
+        kernel(x.data(), y.data(), result->data(), x.size());
+        return result;
+    }
+
+    ValuePtr ndarrayElementwise(const char* name, Arguments params, Kernel kernel) {
+        auto [x, y] = Utils::resolveParams(name, params, Utils::isNDArray, Utils::isNDArray);
+        checkShapes(name, x, y);
+        return NDArrayValue::elementwise(x, y, kernel);
+    }
+
+    // The entry of `proc` on words for calls with `argc` arguments, if it is a builtin with one.
+    // map and reduce call it on numbers so that they are not boxed.
+    WordFuncType wordFunc(const ValuePtr& proc, size_t argc) {
+        auto builtin = valueCast<BuiltinProcValue>(proc.get());
+        return builtin && builtin->accepts(argc) ? builtin->getWordFunc() : nullptr;
+    }
+
+    // out[i] = proc(in[i]) for n numbers. Lambdas with a batch kernel run on it
+    // (see batch.h), builtins on words, and other procedures are called.
+    void mapNumbers(const char* name, const ValuePtr& proc, const double* in, double* out, size_t n, EvalEnv& env) {
+        auto lambda = valueCast<LambdaValue>(proc.get());
+        auto kernel = lambda ? Batch::bind(*lambda) : std::nullopt;
+        auto word = wordFunc(proc, 1);
+        for (size_t start = 0; start < n; start += Batch::SIZE) {
+            size_t end = std::min(start + Batch::SIZE, n);
+            if (kernel && kernel->run(in + start, out + start, end - start)) continue;
+            for (size_t i = start; i < end; i++) {
+                if (word) {
+                    Word arg = Word::number(in[i]);
+                    if (auto value = word({&arg, 1}); value.isNumber()) {
+                        out[i] = value.asNumber();
+                        continue;
+                    }
+                }
+                auto value = env.apply(proc, {Value::number(in[i])});
+                if (!value->isNumber()) throw LispError(std::string(name) + ": expected a number for an array element, but got " + value->toString());
+                out[i] = *value->asNumber();
+            }
+        }
+    }
+
+    // Folds elements from `start` on into `result` by calling `proc`
+    ValuePtr fold(const ValuePtr& proc, ValuePtr result, size_t start, size_t size, auto element, EvalEnv& env) {
+        if (auto word = wordFunc(proc, 2)) {
+            // Partial results stay unboxed while they are numbers
+            auto acc = Word::from(result);
+            for (; start < size && acc.isNumber(); start++) {
+                std::array<Word, 2> args{acc, Word::from(element(start))};
+                auto next = word(args);
+                if (next.isUndefined()) break;
+                acc = next;
+            }
+            if (!acc.isObject()) result = acc.toValue();
+        }
+        for (; start < size; start++) {
+            result = env.apply(proc, {result, element(start)});
+        }
+        return result;
+    }
+}
+
+const std::unordered_map<Symbol, ValuePtr> Builtins::builtinMap = {
     // Core Library
-    {"apply", std::make_shared<BuiltinProcValue>(_apply)},
-    {"display", std::make_shared<BuiltinProcValue>(_display)},
-    {"displayln", std::make_shared<BuiltinProcValue>(_displayln)},
-    {"error", std::make_shared<BuiltinProcValue>(_error)},
-    {"eval", std::make_shared<BuiltinProcValue>(_eval)},
-    {"exit", std::make_shared<BuiltinProcValue>(_exit)},
-    {"newline", std::make_shared<BuiltinProcValue>(_newline)},
-    {"print", std::make_shared<BuiltinProcValue>(_print)},
+    {"apply", builtin({.func = _apply, .minArgs = 2, .maxArgs = 2})},
+    {"display", builtin({.func = _display, .minArgs = 1, .maxArgs = 1})},
+    {"displayln", builtin({.func = _displayln, .minArgs = 1, .maxArgs = 1})},
+    {"error", builtin({.func = _error, .minArgs = 1, .maxArgs = 1})},
+    {"eval", builtin({.func = _eval, .minArgs = 1, .maxArgs = 1})},
+    {"exit", builtin({.func = _exit, .minArgs = 0, .maxArgs = 1})},
+    {"memoize", builtin({.func = _memoize, .minArgs = 1, .maxArgs = 3})},
+    {"newline", builtin({.func = _newline, .minArgs = 0, .maxArgs = 0})},
+    {"print", builtin({.func = _print, .minArgs = 1, .maxArgs = 1})},
 
     // TypeCheckers
-    {"atom?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    {"atom?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<AtomicValue>();
-    }))},
-    {"boolean?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"boolean?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<BooleanValue>();
-    }))},
-    {"integer?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"integer?", typeCheckerT<[](const ValuePtr& v) {
             return v->isNumericInteger();
-    }))},
-    {"list?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"list?", typeCheckerT<[](const ValuePtr& v) {
             return v->isList();
-    }))},
-    {"number?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
-            return v->is<NumericValue>();
-    }))},
-    {"pair?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"number?", typeCheckerT<[](const ValuePtr& v) {
+            return v->isNumber();
+    }>()},
+    {"pair?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<PairValue>();
-    }))},
-    {"null?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"null?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<NilValue>();
-    }))},
-    {"string?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"string?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<StringValue>();
-    }))},
-    {"symbol?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"symbol?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<SymbolValue>();
-    }))},
-    {"procedure?", std::make_shared<BuiltinProcValue>(typeCheckerT([](const ValuePtr& v) {
+    }>()},
+    {"procedure?", typeCheckerT<[](const ValuePtr& v) {
             return v->is<ProcedureValue>();
-    }))},
+    }>()},
+    {"vector?", typeCheckerT<[](const ValuePtr& v) {
+            return v->is<VectorValue>();
+    }>()},
+    {"f64vector?", typeCheckerT<[](const ValuePtr& v) {
+            return v->is<F64VectorValue>();
+    }>()},
+    {"ndarray?", typeCheckerT<[](const ValuePtr& v) {
+            return v->is<NDArrayValue>();
+    }>()},
+    {"hash-table?", typeCheckerT<[](const ValuePtr& v) {
+            return v->is<HashTableValue>();
+    }>()},
 
     // List functions
-    {"append", std::make_shared<BuiltinProcValue>(_append)},
-    {"car", std::make_shared<BuiltinProcValue>(_car)},
-    {"cdr", std::make_shared<BuiltinProcValue>(_cdr)},
-    {"cons", std::make_shared<BuiltinProcValue>(_cons)},
-    {"length", std::make_shared<BuiltinProcValue>(_length)},
-    {"list", std::make_shared<BuiltinProcValue>(_list)},
-    {"map", std::make_shared<BuiltinProcValue>(_map)},
-    {"filter", std::make_shared<BuiltinProcValue>(_filter)},
-    {"reduce", std::make_shared<BuiltinProcValue>(_reduce)},
-
-    {"+", std::make_shared<BuiltinProcValue>(_add)},
-    {"-", std::make_shared<BuiltinProcValue>(_sub)},
-    {"*", std::make_shared<BuiltinProcValue>(_mul)},
-    {"/", std::make_shared<BuiltinProcValue>(_div)},
-    {"abs", std::make_shared<BuiltinProcValue>(_abs)},
-    {"expt", std::make_shared<BuiltinProcValue>(_expt)},
-    {"quotient", std::make_shared<BuiltinProcValue>(_quotient)},
-    {"remainder", std::make_shared<BuiltinProcValue>(_remainder)},
-    {"modulo", std::make_shared<BuiltinProcValue>(_modulo)},
-
-    {"eq?", std::make_shared<BuiltinProcValue>(_eq)},
-    {"equal?", std::make_shared<BuiltinProcValue>(_equal)},
-    {"not", std::make_shared<BuiltinProcValue>(_not)},
-    {"=", std::make_shared<BuiltinProcValue>(_eq_num)},
-    {"<", std::make_shared<BuiltinProcValue>(_lt)},
-    {">", std::make_shared<BuiltinProcValue>(_gt)},
-    {"<=", std::make_shared<BuiltinProcValue>(_le)},
-    {">=", std::make_shared<BuiltinProcValue>(_ge)},
-    {"even?", std::make_shared<BuiltinProcValue>(_is_even)},
-    {"odd?", std::make_shared<BuiltinProcValue>(_is_odd)},
-    {"zero?", std::make_shared<BuiltinProcValue>(_is_zero)},
+    {"append", builtin({.func = _append})},
+    {"car", builtin({.func = _car, .minArgs = 1, .maxArgs = 1,
+        .unary = FastPath<_car, [](const PairValue& pair) { return pair.getCar(); }, Utils::isPair>::unary,
+        .pure = true})},
+    {"cdr", builtin({.func = _cdr, .minArgs = 1, .maxArgs = 1,
+        .unary = FastPath<_cdr, [](const PairValue& pair) { return pair.getCdr(); }, Utils::isPair>::unary,
+        .pure = true})},
+    {"cons", builtin({.func = _cons, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_cons, PairValue::create, Utils::isAny, Utils::isAny>::binary})},
+    {"length", builtin({.func = _length, .minArgs = 1, .maxArgs = 1, .pure = true})},
+    {"list", builtin({.func = _list})},
+    {"map", builtin({.func = _map, .minArgs = 2, .maxArgs = 2})},
+    {"filter", builtin({.func = _filter, .minArgs = 2, .maxArgs = 2})},
+    {"reduce", builtin({.func = _reduce, .minArgs = 2, .maxArgs = 2})},
+
+    // Vectors
+    {"vector", builtin({.func = _vector})},
+    {"make-vector", builtin({.func = _make_vector, .minArgs = 1, .maxArgs = 2})},
+    {"vector-ref", builtin({.func = _vector_ref, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_vector_ref, [](const VectorValue& vector, int64_t index) {
+            checkIndex("vector-ref", vector, index);
+            return vector[index];
+        }, Utils::isVector, Utils::isIndex>::binary})},
+    {"vector-set!", builtin({.func = _vector_set, .minArgs = 3, .maxArgs = 3})},
+    {"vector-length", builtin({.func = _vector_length, .minArgs = 1, .maxArgs = 1})},
+    {"vector->list", builtin({.func = _vector_to_list, .minArgs = 1, .maxArgs = 1})},
+    {"list->vector", builtin({.func = _list_to_vector, .minArgs = 1, .maxArgs = 1})},
+    {"vector-map", builtin({.func = _vector_map, .minArgs = 2, .maxArgs = 2})},
+
+    // F64vectors
+    {"f64vector", builtin({.func = _f64vector})},
+    {"make-f64vector", builtin({.func = _make_f64vector, .minArgs = 1, .maxArgs = 2})},
+    {"f64vector-ref", builtin({.func = _f64vector_ref, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_f64vector_ref, [](const F64VectorValue& vector, int64_t index) {
+            checkIndex("f64vector-ref", vector, index);
+            return Value::number(vector[index]);
+        }, Utils::isF64Vector, Utils::isIndex>::binary})},
+    {"f64vector-set!", builtin({.func = _f64vector_set, .minArgs = 3, .maxArgs = 3})},
+    {"f64vector-length", builtin({.func = _f64vector_length, .minArgs = 1, .maxArgs = 1})},
+    {"f64vector->list", builtin({.func = _f64vector_to_list, .minArgs = 1, .maxArgs = 1})},
+    {"list->f64vector", builtin({.func = _list_to_f64vector, .minArgs = 1, .maxArgs = 1})},
+    {"f64vector+", builtin({.func = _f64vector_add, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector-", builtin({.func = _f64vector_sub, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector*", builtin({.func = _f64vector_mul, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector/", builtin({.func = _f64vector_div, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector-scale", builtin({.func = _f64vector_scale, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector-axpy", builtin({.func = _f64vector_axpy, .minArgs = 3, .maxArgs = 3})},
+    {"f64vector-dot", builtin({.func = _f64vector_dot, .minArgs = 2, .maxArgs = 2})},
+    {"f64vector-sum", builtin({.func = _f64vector_sum, .minArgs = 1, .maxArgs = 1})},
+    {"f64vector-min", builtin({.func = _f64vector_min, .minArgs = 1, .maxArgs = 1})},
+    {"f64vector-max", builtin({.func = _f64vector_max, .minArgs = 1, .maxArgs = 1})},
+
+    // Ndarrays
+    {"make-ndarray", builtin({.func = _make_ndarray, .minArgs = 2, .maxArgs = 3})},
+    {"list->ndarray", builtin({.func = _list_to_ndarray, .minArgs = 1, .maxArgs = 1})},
+    {"ndarray->list", builtin({.func = _ndarray_to_list, .minArgs = 1, .maxArgs = 1})},
+    {"ndarray-ref", builtin({.func = _ndarray_ref, .minArgs = 3, .maxArgs = 3})},
+    {"ndarray-set!", builtin({.func = _ndarray_set, .minArgs = 4, .maxArgs = 4})},
+    {"ndarray-shape", builtin({.func = _ndarray_shape, .minArgs = 1, .maxArgs = 1})},
+    {"ndarray-transpose", builtin({.func = _ndarray_transpose, .minArgs = 1, .maxArgs = 1})},
+    {"ndarray-slice", builtin({.func = _ndarray_slice, .minArgs = 5, .maxArgs = 5})},
+    {"ndarray-copy", builtin({.func = _ndarray_copy, .minArgs = 1, .maxArgs = 1})},
+    {"ndarray+", builtin({.func = _ndarray_add, .minArgs = 2, .maxArgs = 2})},
+    {"ndarray-", builtin({.func = _ndarray_sub, .minArgs = 2, .maxArgs = 2})},
+    {"ndarray*", builtin({.func = _ndarray_mul, .minArgs = 2, .maxArgs = 2})},
+    {"ndarray/", builtin({.func = _ndarray_div, .minArgs = 2, .maxArgs = 2})},
+    {"ndarray-scale", builtin({.func = _ndarray_scale, .minArgs = 2, .maxArgs = 2})},
+    {"ndarray-matmul", builtin({.func = _ndarray_matmul, .minArgs = 2, .maxArgs = 2})},
+    {"array-map", builtin({.func = _array_map, .minArgs = 2, .maxArgs = 2})},
+
+    {"+", builtin({.func = _add,
+        .binary = FastPath<_add, [](const Value& x, const Value& y) { return Number::add(x, y); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_add,
+        .pure = true})},
+    {"-", builtin({.func = _sub, .minArgs = 1, .maxArgs = 2,
+        .unary = FastPath<_sub, [](const Value& x) { return Number::negate(x); }, Utils::isNumber>::unary,
+        .binary = FastPath<_sub, [](const Value& x, const Value& y) { return Number::sub(x, y); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_sub,
+        .pure = true})},
+    {"*", builtin({.func = _mul,
+        .binary = FastPath<_mul, [](const Value& x, const Value& y) { return Number::mul(x, y); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_mul,
+        .pure = true})},
+    {"/", builtin({.func = _div, .minArgs = 1, .maxArgs = 2, .word = Words::_div, .pure = true})},
+    {"abs", builtin({.func = _abs, .minArgs = 1, .maxArgs = 1, .word = Words::_abs, .pure = true})},
+    {"expt", builtin({.func = _expt, .minArgs = 2, .maxArgs = 2, .word = Words::_expt, .pure = true})},
+    {"quotient", builtin({.func = _quotient, .minArgs = 2, .maxArgs = 2, .word = Words::_quotient, .pure = true})},
+    {"remainder", builtin({.func = _remainder, .minArgs = 2, .maxArgs = 2, .word = Words::_remainder, .pure = true})},
+    {"modulo", builtin({.func = _modulo, .minArgs = 2, .maxArgs = 2, .word = Words::_modulo, .pure = true})},
+
+    {"eq?", builtin({.func = _eq, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_eq, [](const ValuePtr& x, const ValuePtr& y) { return Value::boolean(isEq(x, y)); }, Utils::isAny, Utils::isAny>::binary,
+        .pure = true})},
+    {"equal?", builtin({.func = _equal, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_equal, [](const ValuePtr& x, const ValuePtr& y) { return Value::boolean(x->isEqual(y)); }, Utils::isAny, Utils::isAny>::binary,
+        .pure = true})},
+    {"not", builtin({.func = _not, .minArgs = 1, .maxArgs = 1,
+        .unary = FastPath<_not, [](const ValuePtr& x) { return Value::boolean(Utils::isFalse(x)); }, Utils::isAny>::unary,
+        .word = Words::_not,
+        .pure = true})},
+    {"=", builtin({.func = _eq_num, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_eq_num, [](const Value& x, const Value& y) { return Value::boolean(Number::compare(x, y) == 0); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_eq_num,
+        .pure = true})},
+    {"<", builtin({.func = _lt, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_lt, [](const Value& x, const Value& y) { return Value::boolean(Number::compare(x, y) < 0); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_lt,
+        .pure = true})},
+    {">", builtin({.func = _gt, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_gt, [](const Value& x, const Value& y) { return Value::boolean(Number::compare(x, y) > 0); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_gt,
+        .pure = true})},
+    {"<=", builtin({.func = _le, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_le, [](const Value& x, const Value& y) { return Value::boolean(Number::compare(x, y) <= 0); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_le,
+        .pure = true})},
+    {">=", builtin({.func = _ge, .minArgs = 2, .maxArgs = 2,
+        .binary = FastPath<_ge, [](const Value& x, const Value& y) { return Value::boolean(Number::compare(x, y) >= 0); }, Utils::isNumber, Utils::isNumber>::binary,
+        .word = Words::_ge,
+        .pure = true})},
+    {"even?", builtin({.func = _is_even, .minArgs = 1, .maxArgs = 1, .word = Words::_is_even, .pure = true})},
+    {"odd?", builtin({.func = _is_odd, .minArgs = 1, .maxArgs = 1, .word = Words::_is_odd, .pure = true})},
+    {"zero?", builtin({.func = _is_zero, .minArgs = 1, .maxArgs = 1,
+        .unary = FastPath<_is_zero, [](const Value& x) { return Value::boolean(Number::isZero(x)); }, Utils::isNumber>::unary,
+        .word = Words::_is_zero,
+        .pure = true})},
+
+    // Hash tables
+    {"make-hash-table", builtin({.func = _make_hash_table, .minArgs = 0, .maxArgs = 0})},
+    {"hash-ref", builtin({.func = _hash_ref, .minArgs = 2, .maxArgs = 3,
+        .binary = FastPath<_hash_ref, [](HashTableValue& table, const ValuePtr& key) {
+            auto value = table.find(key);
+            return value ? *value : throw LispError("hash-ref: no value for key " + key->toString());
+        }, Utils::isHashTable, Utils::isAny>::binary})},
+    {"hash-set!", builtin({.func = _hash_set, .minArgs = 3, .maxArgs = 3})},
+    {"hash-remove!", builtin({.func = _hash_remove, .minArgs = 2, .maxArgs = 2})},
+    {"hash-count", builtin({.func = _hash_count, .minArgs = 1, .maxArgs = 1})},
+    {"hash-keys", builtin({.func = _hash_keys, .minArgs = 1, .maxArgs = 1})},
 };
 
-ValuePtr Builtins::_apply(const std::vector<ValuePtr> &params, EvalEnv &env) {
+ValuePtr Builtins::_apply(Arguments params, EvalEnv &env) {
     auto [proc, args] = Utils::resolveParams("apply", params, Utils::isProcedure, Utils::isList);
     return env.apply(proc, args);
 }
 
-ValuePtr Builtins::_display(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_display(Arguments params, EvalEnv& env) {
     Utils::checkParams("display", 1, params);
     if (auto str = params[0]->as<StringValue>()) {
         std::cout << *str;
     } else {
         std::cout << params[0]->toString();
     }
-    return std::make_shared<NilValue>();
+    return Value::nil();
 }
 
-ValuePtr Builtins::_displayln(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_displayln(Arguments params, EvalEnv& env) {
     Utils::checkParams("displayln", 1, params);
     if (auto str = params[0]->as<StringValue>()) {
         std::cout << *str << std::endl;
     } else {
         std::cout << params[0]->toString() << std::endl;
     }
-    return std::make_shared<NilValue>();
+    return Value::nil();
 }
 
-ValuePtr Builtins::_error(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_error(Arguments params, EvalEnv& env) {
     Utils::checkParams("error", 1, params);
     if (auto str = params[0]->as<StringValue>()) {
         throw LispError(*str);
@@ -120,30 +375,49 @@ ValuePtr Builtins::_error(const std::vector<ValuePtr>& params, EvalEnv& env) {
     }
 }
 
-ValuePtr Builtins::_eval(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_eval(Arguments params, EvalEnv& env) {
     Utils::checkParams("eval", 1, params);
     return env.eval(params[0]);
 }
 
-ValuePtr Builtins::_exit(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_exit(Arguments params, EvalEnv& env) {
     if (params.empty()) std::exit(0);
     auto [exitCode] = Utils::resolveParams("exit", params, Utils::isInteger);
     std::exit(exitCode);
 }
 
-ValuePtr Builtins::_newline(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_memoize(Arguments params, EvalEnv& env) {
+    // (memoize f [capacity [file]])
+    Utils::checkParams("memoize", 1, 3, params);
+    if (!Utils::isProcedure(params[0])) throw LispError("memoize: expected argument 1 to be of type \"procedure\"");
+    auto capacity = MemoProcValue::DEFAULT_CAPACITY;
+    if (params.size() > 1) {
+        if (!Utils::isInteger(params[1]) || Utils::isInteger.resolve(params[1]) <= 0) {
+            throw LispError("memoize: expected argument 2 to be a positive integer");
+        }
+        capacity = Utils::isInteger.resolve(params[1]);
+    }
+    std::optional<std::string> path;
+    if (params.size() > 2) {
+        if (!Utils::isString(params[2])) throw LispError("memoize: expected argument 3 to be of type \"string\"");
+        path = Utils::isString.resolve(params[2]);
+    }
+    return std::make_shared<MemoProcValue>(params[0], capacity, path);
+}
+
+ValuePtr Builtins::_newline(Arguments params, EvalEnv& env) {
     Utils::requireParams("newline", params);
     std::cout << std::endl;
-    return std::make_shared<NilValue>();
+    return Value::nil();
 }
 
-ValuePtr Builtins::_print(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_print(Arguments params, EvalEnv& env) {
     Utils::checkParams("print", 1, params);
     std::cout << params[0]->toString() << std::endl;
-    return std::make_shared<NilValue>();
+    return Value::nil();
 }
 
-ValuePtr Builtins::_append(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_append(Arguments params, EvalEnv& env) {
     auto lists = Utils::resolveAllParams("append", params, Utils::isList);
     std::vector<ValuePtr> result;
     for (const auto& list : lists) {
@@ -152,40 +426,54 @@ ValuePtr Builtins::_append(const std::vector<ValuePtr>& params, EvalEnv& env) {
     return Value::fromVector(result);
 }
 
-ValuePtr Builtins::_car(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_car(Arguments params, EvalEnv& env) {
     auto [pair] = Utils::resolveParams("car", params, Utils::isPair);
-    return pair->getCar();
+    return pair.getCar();
 }
 
-ValuePtr Builtins::_cdr(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_cdr(Arguments params, EvalEnv& env) {
     auto [pair] = Utils::resolveParams("cdr", params, Utils::isPair);
-    return pair->getCdr();
+    return pair.getCdr();
 }
 
-ValuePtr Builtins::_cons(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_cons(Arguments params, EvalEnv& env) {
     Utils::checkParams("cons", 2, params);
-    return std::make_shared<PairValue>(params[0], params[1]);
+    return PairValue::create(params[0], params[1]);
 }
 
-ValuePtr Builtins::_length(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_length(Arguments params, EvalEnv& env) {
     auto [list] = Utils::resolveParams("length", params, Utils::isList);
-    return std::make_shared<NumericValue>(list.size());
+    return Value::integer(list.size());
 }
 
-ValuePtr Builtins::_list(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_list(Arguments params, EvalEnv& env) {
     return Value::fromVector(params);
 }
 
-ValuePtr Builtins::_map(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_map(Arguments params, EvalEnv& env) {
+    if (params.size() == 2 && Utils::isF64Vector(params[1])) {
+        auto [proc, vector] = Utils::resolveParams("map", params, Utils::isProcedure, Utils::isF64Vector);
+        auto result = std::make_shared<F64VectorValue>(vector.size());
+        mapNumbers("map", proc, vector.data(), result->data(), vector.size(), env);
+        return result;
+    }
     auto [proc, list] = Utils::resolveParams("map", params, Utils::isProcedure, Utils::isList);
+    auto word = wordFunc(proc, 1);
     std::vector<ValuePtr> result;
     for (const auto& i : list) {
+        if (word) {
+            Word arg = Word::from(i);
+            if (auto value = word({&arg, 1}); !value.isUndefined()) {
+                result.push_back(value.toValue());
+                continue;
+            }
+        }
         result.push_back(env.apply(proc, {i}));
     }
     return Value::fromVector(result);
 }
 
-ValuePtr Builtins::_filter(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_filter(Arguments params, EvalEnv& env) {
     auto [proc, list] = Utils::resolveParams("filter", params, Utils::isProcedure, Utils::isList);
     std::vector<ValuePtr> result;
     for (const auto& i : list) {
@@ -197,167 +485,612 @@ ValuePtr Builtins::_filter(const std::vector<ValuePtr>& params, EvalEnv& env) {
     return Value::fromVector(result);
 }
 
-ValuePtr Builtins::_reduce(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_reduce(Arguments params, EvalEnv& env) {
+    if (params.size() == 2 && Utils::isF64Vector(params[1])) {
+        auto [proc, vector] = Utils::resolveParams("reduce", params, Utils::isProcedure, Utils::isF64Vector);
+        if (vector.size() == 0) throw LispError("reduce: expected a non-empty f64vector");
+        if (auto builtin = valueCast<BuiltinProcValue>(proc.get()); builtin && builtin->getSpec().func == _add) {
+            return Value::number(Simd::sum(vector.data(), vector.size()));
+        }
+        return fold(proc, Value::number(vector[0]), 1, vector.size(), [&](size_t i) { return Value::number(vector[i]); }, env);
+    }
     auto [proc, list] = Utils::resolveParams("reduce", params, Utils::isProcedure, Utils::isNonEmptyList);
-    auto length = list.size();
-    ValuePtr result = list[0];
-    for (size_t i = 1; i < length; ++i) {
-        result = env.apply(proc, {result, list[i]});
+    return fold(proc, list[0], 1, list.size(), [&](size_t i) { return list[i]; }, env);
+}
+
+// Vectors
+
+ValuePtr Builtins::_vector(Arguments params, EvalEnv& env) {
+    return std::make_shared<VectorValue>(std::vector<ValuePtr>(params.begin(), params.end()));
+}
+
+// (make-vector k [fill])
+ValuePtr Builtins::_make_vector(Arguments params, EvalEnv& env) {
+    Utils::checkParams("make-vector", 1, 2, params);
+    if (!Utils::isIndex(params[0]) || Utils::isIndex.resolve(params[0]) < 0) {
+        throw LispError("make-vector: expected argument 1 to be a non-negative integer");
+    }
+    auto length = Utils::isIndex.resolve(params[0]);
+    auto fill = params.size() == 2 ? params[1] : Value::integer(0);
+    return allocate("make-vector", length, [&] {
+        return std::make_shared<VectorValue>(std::vector<ValuePtr>(length, Value::promote(fill)));
+    });
+}
+
+ValuePtr Builtins::_vector_ref(Arguments params, EvalEnv& env) {
+    auto [vector, index] = Utils::resolveParams("vector-ref", params, Utils::isVector, Utils::isIndex);
+    checkIndex("vector-ref", vector, index);
+    return vector[index];
+}
+
+ValuePtr Builtins::_vector_set(Arguments params, EvalEnv& env) {
+    auto [vector, index, value] = Utils::resolveParams("vector-set!", params, Utils::isVector, Utils::isIndex, Utils::isAny);
+    checkIndex("vector-set!", vector, index);
+    vector.set(index, value);
+    return Value::nil();
+}
+
+ValuePtr Builtins::_vector_length(Arguments params, EvalEnv& env) {
+    auto [vector] = Utils::resolveParams("vector-length", params, Utils::isVector);
+    return Value::integer(vector.size());
+}
+
+ValuePtr Builtins::_vector_to_list(Arguments params, EvalEnv& env) {
+    auto [vector] = Utils::resolveParams("vector->list", params, Utils::isVector);
+    return Value::fromVector(vector.getElements());
+}
+
+ValuePtr Builtins::_list_to_vector(Arguments params, EvalEnv& env) {
+    auto [list] = Utils::resolveParams("list->vector", params, Utils::isList);
+    return std::make_shared<VectorValue>(std::move(list));
+}
+
+ValuePtr Builtins::_vector_map(Arguments params, EvalEnv& env) {
+    auto [proc, vector] = Utils::resolveParams("vector-map", params, Utils::isProcedure, Utils::isVector);
+    std::vector<ValuePtr> result;
+    result.reserve(vector.size());
+    // By index: `proc` may replace elements, though not change the length
+    for (size_t i = 0; i < vector.size(); i++) {
+        result.push_back(env.apply(proc, {vector[i]}));
+    }
+    return std::make_shared<VectorValue>(std::move(result));
+}
+
+// F64vectors
+
+ValuePtr Builtins::_f64vector(Arguments params, EvalEnv& env) {
+    return std::make_shared<F64VectorValue>(Utils::resolveAllParams("f64vector", params, Utils::isNumeric));
+}
+
+// (make-f64vector k [fill])
+ValuePtr Builtins::_make_f64vector(Arguments params, EvalEnv& env) {
+    Utils::checkParams("make-f64vector", 1, 2, params);
+    if (!Utils::isIndex(params[0]) || Utils::isIndex.resolve(params[0]) < 0) {
+        throw LispError("make-f64vector: expected argument 1 to be a non-negative integer");
+    }
+    auto length = Utils::isIndex.resolve(params[0]);
+    double fill = 0;
+    if (params.size() == 2) {
+        if (!Utils::isNumeric(params[1])) throw LispError("make-f64vector: expected argument 2 to be of type \"number\"");
+        fill = Utils::isNumeric.resolve(params[1]);
+    }
+    return allocate("make-f64vector", length, [&] {
+        return std::make_shared<F64VectorValue>(length, fill);
+    });
+}
+
+ValuePtr Builtins::_f64vector_ref(Arguments params, EvalEnv& env) {
+    auto [vector, index] = Utils::resolveParams("f64vector-ref", params, Utils::isF64Vector, Utils::isIndex);
+    checkIndex("f64vector-ref", vector, index);
+    return Value::number(vector[index]);
+}
+
+ValuePtr Builtins::_f64vector_set(Arguments params, EvalEnv& env) {
+    auto [vector, index, value] = Utils::resolveParams("f64vector-set!", params, Utils::isF64Vector, Utils::isIndex, Utils::isNumeric);
+    checkIndex("f64vector-set!", vector, index);
+    vector[index] = value;
+    return Value::nil();
+}
+
+ValuePtr Builtins::_f64vector_length(Arguments params, EvalEnv& env) {
+    auto [vector] = Utils::resolveParams("f64vector-length", params, Utils::isF64Vector);
+    return Value::integer(vector.size());
+}
+
+ValuePtr Builtins::_f64vector_to_list(Arguments params, EvalEnv& env) {
+    auto [vector] = Utils::resolveParams("f64vector->list", params, Utils::isF64Vector);
+    ValuePtr result = Value::nil();
+    for (size_t i = vector.size(); i > 0; i--) {
+        result = PairValue::create(Value::number(vector[i - 1]), result);
     }
     return result;
 }
 
+ValuePtr Builtins::_list_to_f64vector(Arguments params, EvalEnv& env) {
+    auto [list] = Utils::resolveParams("list->f64vector", params, Utils::isList);
+    return std::make_shared<F64VectorValue>(Utils::resolveAllParams("list->f64vector", list, Utils::isNumeric));
+}
+
+ValuePtr Builtins::_f64vector_add(Arguments params, EvalEnv& env) {
+    return elementwise("f64vector+", params, Simd::add);
+}
+
+ValuePtr Builtins::_f64vector_sub(Arguments params, EvalEnv& env) {
+    return elementwise("f64vector-", params, Simd::sub);
+}
+
+ValuePtr Builtins::_f64vector_mul(Arguments params, EvalEnv& env) {
+    return elementwise("f64vector*", params, Simd::mul);
+}
+
+ValuePtr Builtins::_f64vector_div(Arguments params, EvalEnv& env) {
+    return elementwise("f64vector/", params, Simd::div);
+}
+
+// (f64vector-scale a x) is a * x
+ValuePtr Builtins::_f64vector_scale(Arguments params, EvalEnv& env) {
+    auto [a, x] = Utils::resolveParams("f64vector-scale", params, Utils::isNumeric, Utils::isF64Vector);
+    auto result = std::make_shared<F64VectorValue>(x.size());
+    Simd::scale(a, x.data(), result->data(), x.size());
+    return result;
+}
+
+// (f64vector-axpy a x y) is a * x + y, in a new vector
+ValuePtr Builtins::_f64vector_axpy(Arguments params, EvalEnv& env) {
+    auto [a, x, y] = Utils::resolveParams("f64vector-axpy", params, Utils::isNumeric, Utils::isF64Vector, Utils::isF64Vector);
+    checkLengths("f64vector-axpy", x, y);
+    auto result = std::make_shared<F64VectorValue>(y);
+    Simd::axpy(a, x.data(), result->data(), x.size());
+    return result;
+}
+
+ValuePtr Builtins::_f64vector_dot(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("f64vector-dot", params, Utils::isF64Vector, Utils::isF64Vector);
+    checkLengths("f64vector-dot", x, y);
+    return Value::number(Simd::dot(x.data(), y.data(), x.size()));
+}
+
+ValuePtr Builtins::_f64vector_sum(Arguments params, EvalEnv& env) {
+    auto [x] = Utils::resolveParams("f64vector-sum", params, Utils::isF64Vector);
+    return Value::number(Simd::sum(x.data(), x.size()));
+}
+
+ValuePtr Builtins::_f64vector_min(Arguments params, EvalEnv& env) {
+    auto [x] = Utils::resolveParams("f64vector-min", params, Utils::isF64Vector);
+    if (x.size() == 0) throw LispError("f64vector-min: expected a non-empty f64vector");
+    return Value::number(Simd::min(x.data(), x.size()));
+}
+
+ValuePtr Builtins::_f64vector_max(Arguments params, EvalEnv& env) {
+    auto [x] = Utils::resolveParams("f64vector-max", params, Utils::isF64Vector);
+    if (x.size() == 0) throw LispError("f64vector-max: expected a non-empty f64vector");
+    return Value::number(Simd::max(x.data(), x.size()));
+}
+
+// Ndarrays
+
+// (make-ndarray rows cols [fill])
+ValuePtr Builtins::_make_ndarray(Arguments params, EvalEnv& env) {
+    Utils::checkParams("make-ndarray", 2, 3, params);
+    for (size_t i = 0; i < 2; i++) {
+        if (!Utils::isIndex(params[i]) || Utils::isIndex.resolve(params[i]) < 0) {
+            throw LispError(std::format("make-ndarray: expected argument {} to be a non-negative integer", i + 1));
+        }
+    }
+    auto rows = Utils::isIndex.resolve(params[0]), cols = Utils::isIndex.resolve(params[1]);
+    int64_t length;
+    if (!Number::checkedMul(rows, cols, length)) {
+        throw LispError(std::format("make-ndarray: cannot allocate {} by {} elements", rows, cols));
+    }
+    double fill = 0;
+    if (params.size() == 3) {
+        if (!Utils::isNumeric(params[2])) throw LispError("make-ndarray: expected argument 3 to be of type \"number\"");
+        fill = Utils::isNumeric.resolve(params[2]);
+    }
+    return allocate("make-ndarray", length, [&] {
+        return std::make_shared<NDArrayValue>(rows, cols, fill);
+    });
+}
+
+// (list->ndarray rows), from a list of rows of equal length
+ValuePtr Builtins::_list_to_ndarray(Arguments params, EvalEnv& env) {
+    auto [list] = Utils::resolveParams("list->ndarray", params, Utils::isList);
+    std::vector<std::vector<double>> rows;
+    for (const auto& row : list) {
+        if (!row->isList()) throw LispError("list->ndarray: expected a list of rows, but got " + row->toString());
+        rows.push_back(Utils::resolveAllParams("list->ndarray", row->toVector(), Utils::isNumeric));
+        if (rows.back().size() != rows.front().size()) throw LispError("list->ndarray: rows of different lengths");
+    }
+    auto result = std::make_shared<NDArrayValue>(rows.size(), rows.empty() ? 0 : rows.front().size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        std::ranges::copy(rows[i], result->row(i));
+    }
+    return result;
+}
+
+ValuePtr Builtins::_ndarray_to_list(Arguments params, EvalEnv& env) {
+    auto [array] = Utils::resolveParams("ndarray->list", params, Utils::isNDArray);
+    std::vector<ValuePtr> rows;
+    for (size_t i = 0; i < array.rows(); i++) {
+        std::vector<ValuePtr> row;
+        for (size_t j = 0; j < array.cols(); j++) row.push_back(Value::number(array(i, j)));
+        rows.push_back(Value::fromVector(row));
+    }
+    return Value::fromVector(rows);
+}
+
+ValuePtr Builtins::_ndarray_ref(Arguments params, EvalEnv& env) {
+    auto [array, row, col] = Utils::resolveParams("ndarray-ref", params, Utils::isNDArray, Utils::isIndex, Utils::isIndex);
+    checkIndex("ndarray-ref", array, row, col);
+    return Value::number(array(row, col));
+}
+
+ValuePtr Builtins::_ndarray_set(Arguments params, EvalEnv& env) {
+    auto [array, row, col, value] = Utils::resolveParams("ndarray-set!", params, Utils::isNDArray, Utils::isIndex, Utils::isIndex, Utils::isNumeric);
+    checkIndex("ndarray-set!", array, row, col);
+    array(row, col) = value;
+    return Value::nil();
+}
+
+// (ndarray-shape a) is (rows cols)
+ValuePtr Builtins::_ndarray_shape(Arguments params, EvalEnv& env) {
+    auto [array] = Utils::resolveParams("ndarray-shape", params, Utils::isNDArray);
+    return Value::fromVector({Value::integer(array.rows()), Value::integer(array.cols())});
+}
+
+ValuePtr Builtins::_ndarray_transpose(Arguments params, EvalEnv& env) {
+    auto [array] = Utils::resolveParams("ndarray-transpose", params, Utils::isNDArray);
+    return array.transpose();
+}
+
+// (ndarray-slice a row-start row-end col-start col-end), sharing the elements of a
+ValuePtr Builtins::_ndarray_slice(Arguments params, EvalEnv& env) {
+    auto [array, rowStart, rowEnd, colStart, colEnd] = Utils::resolveParams("ndarray-slice", params,
+        Utils::isNDArray, Utils::isIndex, Utils::isIndex, Utils::isIndex, Utils::isIndex);
+    if (rowStart < 0 || rowStart > rowEnd || static_cast<size_t>(rowEnd) > array.rows() ||
+        colStart < 0 || colStart > colEnd || static_cast<size_t>(colEnd) > array.cols()) {
+        throw LispError(std::format("ndarray-slice: rows [{}, {}) and columns [{}, {}) out of range for an ndarray of shape ({}, {})",
+                                    rowStart, rowEnd, colStart, colEnd, array.rows(), array.cols()));
+    }
+    return array.slice(rowStart, rowEnd, colStart, colEnd);
+}
+
+ValuePtr Builtins::_ndarray_copy(Arguments params, EvalEnv& env) {
+    auto [array] = Utils::resolveParams("ndarray-copy", params, Utils::isNDArray);
+    return array.copy();
+}
+
+ValuePtr Builtins::_ndarray_add(Arguments params, EvalEnv& env) {
+    return ndarrayElementwise("ndarray+", params, Simd::add);
+}
+
+ValuePtr Builtins::_ndarray_sub(Arguments params, EvalEnv& env) {
+    return ndarrayElementwise("ndarray-", params, Simd::sub);
+}
+
+ValuePtr Builtins::_ndarray_mul(Arguments params, EvalEnv& env) {
+    return ndarrayElementwise("ndarray*", params, Simd::mul);
+}
+
+ValuePtr Builtins::_ndarray_div(Arguments params, EvalEnv& env) {
+    return ndarrayElementwise("ndarray/", params, Simd::div);
+}
+
+// (ndarray-scale a x) is a * x
+ValuePtr Builtins::_ndarray_scale(Arguments params, EvalEnv& env) {
+    auto [a, x] = Utils::resolveParams("ndarray-scale", params, Utils::isNumeric, Utils::isNDArray);
+    return NDArrayValue::scale(a, x);
+}
+
+ValuePtr Builtins::_ndarray_matmul(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("ndarray-matmul", params, Utils::isNDArray, Utils::isNDArray);
+    if (x.cols() != y.rows()) {
+        throw LispError(std::format("ndarray-matmul: cannot multiply ndarrays of shapes ({}, {}) and ({}, {})",
+                                    x.rows(), x.cols(), y.rows(), y.cols()));
+    }
+    return NDArrayValue::matmul(x, y);
+}
+
+// (array-map f a) maps an f64vector or an ndarray to a new one of the same shape
+ValuePtr Builtins::_array_map(Arguments params, EvalEnv& env) {
+    Utils::checkParams("array-map", 2, params);
+    if (Utils::isNDArray(params[1])) {
+        auto [proc, array] = Utils::resolveParams("array-map", params, Utils::isProcedure, Utils::isNDArray);
+        auto source = array.isContiguous() ? nullptr : array.copy();
+        const auto& input = source ? *source : array;
+        auto result = std::make_shared<NDArrayValue>(input.rows(), input.cols());
+        mapNumbers("array-map", proc, input.row(0), result->row(0), input.rows() * input.cols(), env);
+        return result;
+    }
+    auto [proc, vector] = Utils::resolveParams("array-map", params, Utils::isProcedure, Utils::isF64Vector);
+    auto result = std::make_shared<F64VectorValue>(vector.size());
+    mapNumbers("array-map", proc, vector.data(), result->data(), vector.size(), env);
+    return result;
+}
+
 // (+ n1 n2 ... nk)
-ValuePtr Builtins::_add(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    double result = 0;
+ValuePtr Builtins::_add(Arguments params, EvalEnv& env) {
+    ValuePtr result = Value::integer(0);
     for (const auto& i : params) {
-        if (!i->is<NumericValue>()) {
+        if (!i->isNumber()) {
             throw LispError("Cannot add a non-numeric value.");
         }
-        result += *(i->as<NumericValue>());
+        result = Number::add(*result, *i);
     }
-    return std::make_shared<NumericValue>(result);
+    return result;
 }
 
-ValuePtr Builtins::_sub(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_sub(Arguments params, EvalEnv& env) {
     Utils::checkParams("-", 1, 2, params);
-    if (params.size() == 1) {
-        if (!params[0]->is<NumericValue>()) {
-            throw LispError("-: Invalid argument.");
-        }
-        return std::make_shared<NumericValue>(-*(params[0]->as<NumericValue>()));
-    } else {
-        if (!params[0]->is<NumericValue>() || !params[1]->is<NumericValue>()) {
+    for (const auto& i : params) {
+        if (!i->isNumber()) {
             throw LispError("-: Invalid argument.");
         }
-        return std::make_shared<NumericValue>(*params[0]->as<NumericValue>() - *params[1]->as<NumericValue>());
     }
+    return params.size() == 1 ? Number::negate(*params[0]) : Number::sub(*params[0], *params[1]);
 }
 
-ValuePtr Builtins::_mul(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    return std::accumulate(params.begin(), params.end(), std::make_shared<NumericValue>(1.0), [](const ValuePtr& a, const ValuePtr& b) {
-        if (!a->is<NumericValue>() || !b->is<NumericValue>()) {
+ValuePtr Builtins::_mul(Arguments params, EvalEnv& env) {
+    ValuePtr result = Value::integer(1);
+    for (const auto& i : params) {
+        if (!i->isNumber()) {
             throw LispError("*: Invalid argument.");
         }
-        return std::make_shared<NumericValue>(*a->as<NumericValue>() * *b->as<NumericValue>());
-    });
+        result = Number::mul(*result, *i);
+    }
+    return result;
 }
 
-ValuePtr Builtins::_div(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_div(Arguments params, EvalEnv& env) {
     if (params.size() == 1) {
-        auto [y] = Utils::resolveParams("/", params, Utils::isNumeric);
-        if (y == 0.0) throw LispError("/: Division by zero.");
-        return std::make_shared<NumericValue>(1 / y);
+        auto [y] = Utils::resolveParams("/", params, Utils::isNumber);
+        if (Number::isZero(y)) throw LispError("/: Division by zero.");
+        return Number::div(*Value::integer(1), y);
     } else {
-        auto [x, y] = Utils::resolveParams("/", params, Utils::isNumeric, Utils::isNumeric);
-        if (y == 0.0) throw LispError("/: Division by zero.");
-        return std::make_shared<NumericValue>(x / y);
+        auto [x, y] = Utils::resolveParams("/", params, Utils::isNumber, Utils::isNumber);
+        if (Number::isZero(y)) throw LispError("/: Division by zero.");
+        return Number::div(x, y);
     }
 }
 
-ValuePtr Builtins::_abs(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x] = Utils::resolveParams("abs", params, Utils::isNumeric);
-    return std::make_shared<NumericValue>(std::abs(x));
+ValuePtr Builtins::_abs(Arguments params, EvalEnv& env) {
+    auto [x] = Utils::resolveParams("abs", params, Utils::isNumber);
+    return Number::abs(x);
 }
 
-ValuePtr Builtins::_expt(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams("expt", params, Utils::isNumeric, Utils::isNumeric);
+ValuePtr Builtins::_expt(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("expt", params, Utils::isNumber, Utils::isNumber);
 
     std::feclearexcept(FE_ALL_EXCEPT);
-    auto result = std::make_shared<NumericValue>(std::pow(x, y));
+    auto result = Number::expt(x, y);
     if (std::fetestexcept(FE_INVALID)) throw LispError("expt: base is finite and negative and exp is finite and non-integer.");
     if (std::fetestexcept(FE_DIVBYZERO)) throw LispError("expt: base is zero and exp is negative.");
     return result;
 }
 
-ValuePtr Builtins::_quotient(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams("quotient", params, Utils::isNumeric, Utils::isNumeric);
-    if (y == 0.0) throw LispError("quotient: Division by zero.");
-    return std::make_shared<NumericValue>(std::trunc(x / y)); // TODO: Check
+ValuePtr Builtins::_quotient(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("quotient", params, Utils::isNumber, Utils::isNumber);
+    if (Number::isZero(y)) throw LispError("quotient: Division by zero.");
+    return Number::quotient(x, y);
+}
+
+ValuePtr Builtins::_modulo(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("modulo", params, Utils::isNumber, Utils::isNumber);
+    if (Number::isZero(y)) throw LispError("modulo: Division by zero.");
+    return Number::modulo(x, y);
 }
 
-ValuePtr Builtins::_modulo(const std::vector<ValuePtr> &params, EvalEnv &env) {
-    auto [x, y] = Utils::resolveParams("modulo", params, Utils::isNumeric, Utils::isNumeric);
-    if (y == 0.0) throw LispError("modulo: Division by zero.");
-    auto result = std::fmod(x, y);
-    if (x * y < 0) result += y;
-    return std::make_shared<NumericValue>(result);
+ValuePtr Builtins::_remainder(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("remainder", params, Utils::isNumber, Utils::isNumber);
+    if (Number::isZero(y)) throw LispError("remainder: Division by zero.");
+    return Number::remainder(x, y);
+}
+
+namespace {
+    bool areNumbers(std::span<const Word> params) {
+        return std::ranges::all_of(params, [](Word x) { return x.isNumber(); });
+    }
+}
+
+Word Builtins::Words::_add(std::span<const Word> params) {
+    if (!areNumbers(params)) return {};
+    auto result = Word::fixnum(0);
+    for (auto i : params) {
+        result = Number::add(result, i);
+        if (result.isUndefined()) break;
+    }
+    return result;
 }
 
-ValuePtr Builtins::_remainder(const std::vector<ValuePtr> &params, EvalEnv &env) {
-    auto [x, y] = Utils::resolveParams("remainder", params, Utils::isNumeric, Utils::isNumeric);
-    if (y == 0.0) throw LispError("remainder: Division by zero.");
-    return std::make_shared<NumericValue>(std::fmod(x, y));
+Word Builtins::Words::_sub(std::span<const Word> params) {
+    if (!areNumbers(params)) return {};
+    if (params.size() == 1) return Number::negate(params[0]);
+    if (params.size() == 2) return Number::sub(params[0], params[1]);
+    return {};
+}
+
+Word Builtins::Words::_mul(std::span<const Word> params) {
+    if (!areNumbers(params)) return {};
+    auto result = Word::fixnum(1);
+    for (auto i : params) {
+        result = Number::mul(result, i);
+        if (result.isUndefined()) break;
+    }
+    return result;
+}
+
+Word Builtins::Words::_div(std::span<const Word> params) {
+    if (!areNumbers(params) || params.empty() || params.size() > 2 || Number::isZero(params.back())) return {};
+    return Number::div(params.size() == 1 ? Word::fixnum(1) : params[0], params.back());
+}
+
+Word Builtins::Words::_abs(std::span<const Word> params) {
+    if (params.size() != 1 || !areNumbers(params)) return {};
+    return Number::abs(params[0]);
+}
+
+Word Builtins::Words::_expt(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+
+    std::feclearexcept(FE_ALL_EXCEPT);
+    auto result = Number::expt(params[0], params[1]);
+    if (std::fetestexcept(FE_INVALID | FE_DIVBYZERO)) return {};
+    return result;
+}
+
+Word Builtins::Words::_quotient(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params) || Number::isZero(params[1])) return {};
+    return Number::quotient(params[0], params[1]);
+}
+
+Word Builtins::Words::_modulo(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params) || Number::isZero(params[1])) return {};
+    return Number::modulo(params[0], params[1]);
+}
+
+Word Builtins::Words::_remainder(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params) || Number::isZero(params[1])) return {};
+    return Number::remainder(params[0], params[1]);
 }
 
 // Comparison functions
 
-ValuePtr Builtins::_equal(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_equal(Arguments params, EvalEnv& env) {
     Utils::checkParams("eq?", 2, params);
-    return std::make_shared<BooleanValue>(params[0]->isEqual(params[1]));
+    return Value::boolean(params[0]->isEqual(params[1]));
 }
 
-ValuePtr Builtins::_eq(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::_eq(Arguments params, EvalEnv& env) {
     Utils::checkParams("equal?", 2, params);
-    auto x = params[0];
-    auto y = params[1];
-    bool result;
-    if (x->is<BooleanValue>() || x->is<NumericValue>() || x->is<ProcedureValue>() || x->is<SymbolValue>() || x->is<NilValue>()) {
-        result = x->isEqual(y);
-    } else if (x->is<StringValue>() || x->is<PairValue>()) {
-        result = x == y;
-    } else {
-        result = false;
-    }
-
-    return std::make_shared<BooleanValue>(result);
+    return Value::boolean(isEq(params[0], params[1]));
 }
 
-ValuePtr Builtins::_not(const std::vector<ValuePtr> &params, EvalEnv &env) {
+ValuePtr Builtins::_not(Arguments params, EvalEnv& env) {
     Utils::checkParams("not", 1, params);
-    if (!params[0]->is<BooleanValue>() || *params[0]->as<BooleanValue>()) {
-        return std::make_shared<BooleanValue>(false);
-    } else {
-        return std::make_shared<BooleanValue>(true);
-    }
+    return Value::boolean(Utils::isFalse(params[0]));
+}
+
+ValuePtr Builtins::_eq_num(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("=", params, Utils::isNumber, Utils::isNumber);
+    return Value::boolean(Number::compare(x, y) == 0);
 }
 
-ValuePtr Builtins::_eq_num(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams("=", params, Utils::isNumeric, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x == y);
+ValuePtr Builtins::_lt(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("<", params, Utils::isNumber, Utils::isNumber);
+    return Value::boolean(Number::compare(x, y) < 0);
 }
 
-ValuePtr Builtins::_lt(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams("<", params, Utils::isNumeric, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x < y);
+ValuePtr Builtins::_gt(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams(">", params, Utils::isNumber, Utils::isNumber);
+    return Value::boolean(Number::compare(x, y) > 0);
 }
 
-ValuePtr Builtins::_gt(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams(">", params, Utils::isNumeric, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x > y);
+ValuePtr Builtins::_le(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams("<=", params, Utils::isNumber, Utils::isNumber);
+    return Value::boolean(Number::compare(x, y) <= 0);
 }
 
-ValuePtr Builtins::_le(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams("<=", params, Utils::isNumeric, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x <= y);
+ValuePtr Builtins::_ge(Arguments params, EvalEnv& env) {
+    auto [x, y] = Utils::resolveParams(">=", params, Utils::isNumber, Utils::isNumber);
+    return Value::boolean(Number::compare(x, y) >= 0);
 }
 
-ValuePtr Builtins::_ge(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x, y] = Utils::resolveParams(">=", params, Utils::isNumeric, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x >= y);
+ValuePtr Builtins::_is_even(Arguments params, EvalEnv& env) {
+    Utils::requireParams("even?", params, Utils::isInteger);
+    return Value::boolean(Number::isEven(*params[0]));
 }
 
-ValuePtr Builtins::_is_even(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x] = Utils::resolveParams("even?", params, Utils::isInteger);
-    return std::make_shared<BooleanValue>(std::fmod(x, 2) == 0);
+ValuePtr Builtins::_is_odd(Arguments params, EvalEnv& env) {
+    Utils::requireParams("odd?", params, Utils::isInteger);
+    return Value::boolean(!Number::isEven(*params[0]));
 }
 
-ValuePtr Builtins::_is_odd(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x] = Utils::resolveParams("odd?", params, Utils::isInteger);
-    return std::make_shared<BooleanValue>(std::fmod(x, 2) != 0);
+ValuePtr Builtins::_is_zero(Arguments params, EvalEnv& env) {
+    auto [x] = Utils::resolveParams("zero?", params, Utils::isNumber);
+    return Value::boolean(Number::isZero(x));
 }
 
-ValuePtr Builtins::_is_zero(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    auto [x] = Utils::resolveParams("zero?", params, Utils::isNumeric);
-    return std::make_shared<BooleanValue>(x == 0);
-}
\ No newline at end of file
+Word Builtins::Words::_not(std::span<const Word> params) {
+    if (params.size() != 1) return {};
+    return Word::boolean(params[0].isFalse());
+}
+
+Word Builtins::Words::_eq_num(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+    return Word::boolean(Number::equal(params[0], params[1]));
+}
+
+Word Builtins::Words::_lt(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+    return Word::boolean(Number::compare(params[0], params[1]) < 0);
+}
+
+Word Builtins::Words::_gt(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+    return Word::boolean(Number::compare(params[0], params[1]) > 0);
+}
+
+Word Builtins::Words::_le(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+    return Word::boolean(Number::compare(params[0], params[1]) <= 0);
+}
+
+Word Builtins::Words::_ge(std::span<const Word> params) {
+    if (params.size() != 2 || !areNumbers(params)) return {};
+    return Word::boolean(Number::compare(params[0], params[1]) >= 0);
+}
+
+Word Builtins::Words::_is_even(std::span<const Word> params) {
+    if (params.size() != 1 || !Utils::isInteger(params[0])) return {};
+    auto x = params[0];
+    return Word::boolean(x.isFixnum() ? x.asFixnum() % 2 == 0 : std::fmod(x.asFlonum(), 2) == 0);
+}
+
+Word Builtins::Words::_is_odd(std::span<const Word> params) {
+    if (params.size() != 1 || !Utils::isInteger(params[0])) return {};
+    auto x = params[0];
+    return Word::boolean(x.isFixnum() ? x.asFixnum() % 2 != 0 : std::fmod(x.asFlonum(), 2) != 0);
+}
+
+Word Builtins::Words::_is_zero(std::span<const Word> params) {
+    if (params.size() != 1 || !areNumbers(params)) return {};
+    return Word::boolean(Number::isZero(params[0]));
+}
+
+// Hash tables
+
+ValuePtr Builtins::_make_hash_table(Arguments params, EvalEnv& env) {
+    Utils::checkParams("make-hash-table", 0, params);
+    return std::make_shared<HashTableValue>();
+}
+
+ValuePtr Builtins::_hash_ref(Arguments params, EvalEnv& env) {
+    // (hash-ref table key [default])
+    Utils::checkParams("hash-ref", 2, 3, params);
+    if (!Utils::isHashTable(params[0])) throw LispError("hash-ref: expected argument 1 to be of type \"hash table\"");
+    if (auto value = Utils::isHashTable.resolve(params[0]).find(params[1])) return *value;
+    if (params.size() == 3) return params[2];
+    throw LispError("hash-ref: no value for key " + params[1]->toString());
+}
+
+ValuePtr Builtins::_hash_set(Arguments params, EvalEnv& env) {
+    auto [table, key, value] = Utils::resolveParams("hash-set!", params, Utils::isHashTable, Utils::isAny, Utils::isAny);
+    table.set(key, value);
+    return Value::nil();
+}
+
+ValuePtr Builtins::_hash_remove(Arguments params, EvalEnv& env) {
+    auto [table, key] = Utils::resolveParams("hash-remove!", params, Utils::isHashTable, Utils::isAny);
+    table.remove(key);
+    return Value::nil();
+}
+
+ValuePtr Builtins::_hash_count(Arguments params, EvalEnv& env) {
+    auto [table] = Utils::resolveParams("hash-count", params, Utils::isHashTable);
+    return Value::integer(table.size());
+}
+
+ValuePtr Builtins::_hash_keys(Arguments params, EvalEnv& env) {
+    auto [table] = Utils::resolveParams("hash-keys", params, Utils::isHashTable);
+    return Value::fromVector(table.keys());
+}
@@ -12,61 +12,154 @@
 #include "utils/utils.h"
 
 namespace Builtins {
-    extern const std::unordered_map<std::string, ValuePtr> builtinMap;
+    extern const std::unordered_map<Symbol, ValuePtr> builtinMap;
 
     // 7.1 Core Library
-    ValuePtr _apply(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _display(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _displayln(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _error(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _eval(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _exit(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _newline(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _print(const std::vector<ValuePtr>& params, EvalEnv& env);
+    ValuePtr _apply(Arguments params, EvalEnv& env);
+    ValuePtr _display(Arguments params, EvalEnv& env);
+    ValuePtr _displayln(Arguments params, EvalEnv& env);
+    ValuePtr _error(Arguments params, EvalEnv& env);
+    ValuePtr _eval(Arguments params, EvalEnv& env);
+    ValuePtr _exit(Arguments params, EvalEnv& env);
+    ValuePtr _memoize(Arguments params, EvalEnv& env);
+    ValuePtr _newline(Arguments params, EvalEnv& env);
+    ValuePtr _print(Arguments params, EvalEnv& env);
 
     // 7.2 Type Predicates
-    template<typename F>
-    BuiltinFuncType typeCheckerT(F f) {
-        return [f](const std::vector<ValuePtr>& params, EvalEnv& env) {
-            Utils::checkParams("builtin-type-checker", 1, 1, params);
-            return std::make_shared<BooleanValue>(f(params[0]));
-        };
+    template<auto pred>
+    ValuePtr typeChecker(Arguments params, EvalEnv& env) {
+        Utils::checkParams("builtin-type-checker", 1, 1, params);
+        return Value::boolean(pred(params[0]));
+    }
+
+    template<auto pred>
+    ValuePtr typeCheckerT() {
+        return std::make_shared<BuiltinProcValue>(BuiltinSpec{
+            .func = typeChecker<pred>,
+            .minArgs = 1,
+            .maxArgs = 1,
+            .unary = [](const ValuePtr& x, EvalEnv& env) { return Value::boolean(pred(x)); },
+            .pure = true,
+        });
     }
 
     // 7.3 List functions
-    ValuePtr _append(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _car(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _cdr(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _cons(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _length(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _list(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _map(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _filter(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _reduce(const std::vector<ValuePtr>& params, EvalEnv& env);
+    ValuePtr _append(Arguments params, EvalEnv& env);
+    ValuePtr _car(Arguments params, EvalEnv& env);
+    ValuePtr _cdr(Arguments params, EvalEnv& env);
+    ValuePtr _cons(Arguments params, EvalEnv& env);
+    ValuePtr _length(Arguments params, EvalEnv& env);
+    ValuePtr _list(Arguments params, EvalEnv& env);
+    ValuePtr _map(Arguments params, EvalEnv& env);
+    ValuePtr _filter(Arguments params, EvalEnv& env);
+    ValuePtr _reduce(Arguments params, EvalEnv& env);
+
+    // Vectors
+    ValuePtr _vector(Arguments params, EvalEnv& env);
+    ValuePtr _make_vector(Arguments params, EvalEnv& env);
+    ValuePtr _vector_ref(Arguments params, EvalEnv& env);
+    ValuePtr _vector_set(Arguments params, EvalEnv& env);
+    ValuePtr _vector_length(Arguments params, EvalEnv& env);
+    ValuePtr _vector_to_list(Arguments params, EvalEnv& env);
+    ValuePtr _list_to_vector(Arguments params, EvalEnv& env);
+    ValuePtr _vector_map(Arguments params, EvalEnv& env);
+
+    // F64vectors, unboxed vectors of doubles
+    ValuePtr _f64vector(Arguments params, EvalEnv& env);
+    ValuePtr _make_f64vector(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_ref(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_set(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_length(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_to_list(Arguments params, EvalEnv& env);
+    ValuePtr _list_to_f64vector(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_add(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_sub(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_mul(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_div(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_scale(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_axpy(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_dot(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_sum(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_min(Arguments params, EvalEnv& env);
+    ValuePtr _f64vector_max(Arguments params, EvalEnv& env);
+
+    // Ndarrays, two-dimensional arrays of doubles and views of them
+    ValuePtr _make_ndarray(Arguments params, EvalEnv& env);
+    ValuePtr _list_to_ndarray(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_to_list(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_ref(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_set(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_shape(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_transpose(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_slice(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_copy(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_add(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_sub(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_mul(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_div(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_scale(Arguments params, EvalEnv& env);
+    ValuePtr _ndarray_matmul(Arguments params, EvalEnv& env);
+    // Numeric lambdas run in batches over the elements, see batch.h
+    ValuePtr _array_map(Arguments params, EvalEnv& env);
+
+    // Builtins on numbers and booleans also come defined on words (see word.h),
+    // so the VM calls them without boxing. A word-level builtin computes on
+    // immediates only: it returns an undefined word for anything else (bignums,
+    // wrong arguments), and the VM calls the builtin on values instead.
 
     // 7.4 Arithmetic Functions
-    ValuePtr _add(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _sub(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _mul(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _div(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _abs(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _expt(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _quotient(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _remainder(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _modulo(const std::vector<ValuePtr>& params, EvalEnv& env);
+    ValuePtr _add(Arguments params, EvalEnv& env);
+    ValuePtr _sub(Arguments params, EvalEnv& env);
+    ValuePtr _mul(Arguments params, EvalEnv& env);
+    ValuePtr _div(Arguments params, EvalEnv& env);
+    ValuePtr _abs(Arguments params, EvalEnv& env);
+    ValuePtr _expt(Arguments params, EvalEnv& env);
+    ValuePtr _quotient(Arguments params, EvalEnv& env);
+    ValuePtr _remainder(Arguments params, EvalEnv& env);
+    ValuePtr _modulo(Arguments params, EvalEnv& env);
+    namespace Words {
+        Word _add(std::span<const Word> params);
+        Word _sub(std::span<const Word> params);
+        Word _mul(std::span<const Word> params);
+        Word _div(std::span<const Word> params);
+        Word _abs(std::span<const Word> params);
+        Word _expt(std::span<const Word> params);
+        Word _quotient(std::span<const Word> params);
+        Word _remainder(std::span<const Word> params);
+        Word _modulo(std::span<const Word> params);
+    }
 
     // 7.5 Comparison Library
-    ValuePtr _eq(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _equal(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _not(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _eq_num(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _lt(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _gt(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _le(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _ge(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _is_even(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _is_odd(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _is_zero(const std::vector<ValuePtr>& params, EvalEnv& env);
+    ValuePtr _eq(Arguments params, EvalEnv& env);
+    ValuePtr _equal(Arguments params, EvalEnv& env);
+    ValuePtr _not(Arguments params, EvalEnv& env);
+    ValuePtr _eq_num(Arguments params, EvalEnv& env);
+    ValuePtr _lt(Arguments params, EvalEnv& env);
+    ValuePtr _gt(Arguments params, EvalEnv& env);
+    ValuePtr _le(Arguments params, EvalEnv& env);
+    ValuePtr _ge(Arguments params, EvalEnv& env);
+    ValuePtr _is_even(Arguments params, EvalEnv& env);
+    ValuePtr _is_odd(Arguments params, EvalEnv& env);
+    ValuePtr _is_zero(Arguments params, EvalEnv& env);
+    namespace Words {
+        Word _not(std::span<const Word> params);
+        Word _eq_num(std::span<const Word> params);
+        Word _lt(std::span<const Word> params);
+        Word _gt(std::span<const Word> params);
+        Word _le(std::span<const Word> params);
+        Word _ge(std::span<const Word> params);
+        Word _is_even(std::span<const Word> params);
+        Word _is_odd(std::span<const Word> params);
+        Word _is_zero(std::span<const Word> params);
+    }
+
+    // Hash tables
+    ValuePtr _make_hash_table(Arguments params, EvalEnv& env);
+    ValuePtr _hash_ref(Arguments params, EvalEnv& env);
+    ValuePtr _hash_set(Arguments params, EvalEnv& env);
+    ValuePtr _hash_remove(Arguments params, EvalEnv& env);
+    ValuePtr _hash_count(Arguments params, EvalEnv& env);
+    ValuePtr _hash_keys(Arguments params, EvalEnv& env);
 
     bool _builtin_equal(const ValuePtr &x, const ValuePtr &y);
 }
@@ -0,0 +1,235 @@
+//
+// Created by timetraveler314 on 6/2/24.
+//
+
+#include "compiler.h"
+
+#include <array>
+
+#include "error.h"
+#include "eval_env.h"
+#include "folding.h"
+#include "forms.h"
+#include "inlining.h"
+
+namespace Compiler {
+    Closure constant(ValuePtr value) {
+        return [value = std::move(value)](EvalEnv&) {
+            return value;
+        };
+    }
+
+    Closure fail(std::string message) {
+        return [message = std::move(message)](EvalEnv&) -> ValuePtr {
+            throw LispError(message);
+        };
+    }
+
+    std::optional<size_t> Scope::find(Symbol name) const {
+        for (size_t i = names.size(); i-- > 0;) {
+            if (names[i] == name) return i;
+        }
+        return std::nullopt;
+    }
+
+    size_t Scope::declare(Symbol name) {
+        if (auto slot = find(name)) return *slot;
+        names.push_back(name);
+        return names.size() - 1;
+    }
+
+    void Scope::capture() {
+        for (auto scope = this; scope && !scope->captured; scope = scope->parent.get()) {
+            scope->captured = true;
+        }
+    }
+
+    // Declares the names defined by a body up front, so that internal
+    // definitions can refer to each other regardless of their order
+    static void declareDefines(const std::vector<ValuePtr>& body, Scope& scope) {
+        for (const auto& expr : body) {
+            auto pair = valueCast<PairValue>(expr);
+            if (!pair || !pair->isList()) continue;
+            auto head = pair->getCar()->asSymbol();
+            if (!head) continue;
+            auto operands = pair->getCdr()->toVector();
+            if (*head == Symbol::DEFINE && !operands.empty()) {
+                if (auto name = operands[0]->asSymbol()) {
+                    scope.declare(*name);
+                } else if (auto signature = valueCast<PairValue>(operands[0])) {
+                    if (auto name = signature->getCar()->asSymbol()) scope.declare(*name);
+                }
+            } else if (*head == Symbol::BEGIN || *head == Symbol::IF || *head == Symbol::AND || *head == Symbol::OR) {
+                declareDefines(operands, scope);
+            } else if (*head == Symbol::COND) {
+                for (const auto& clause : operands) {
+                    if (clause->isList()) declareDefines(clause->toVector(), scope);
+                }
+            }
+        }
+    }
+
+    static Closure compileSymbol(Symbol name, const ScopePtr& scope) {
+        size_t depth = 0;
+        for (auto current = scope.get(); current; current = current->parent.get(), depth++) {
+            if (auto slot = current->find(name)) {
+                return [name, depth, slot = *slot](EvalEnv& env) {
+                    auto& value = env.local(depth, slot);
+                    if (!value) {
+                        throw LispError("Variable " + name.name() + " not defined.");
+                    }
+                    return value;
+                };
+            }
+        }
+        // Global frames stay name-keyed; remember where the binding was found
+        // until a definition somewhere might have shadowed it
+        return [name, global = static_cast<const EvalEnv*>(nullptr), epoch = uint64_t{0}, binding = static_cast<const ValuePtr*>(nullptr)](EvalEnv& env) mutable {
+            auto& globalEnv = env.global();
+            if (global != &globalEnv || epoch != EvalEnv::bindingsEpoch()) {
+                global = &globalEnv;
+                epoch = EvalEnv::bindingsEpoch();
+                binding = globalEnv.lookupSlot(name);
+            }
+            if (!binding) {
+                throw LispError("Variable " + name.name() + " not defined.");
+            }
+            return *binding;
+        };
+    }
+
+    // Calls with up to this many arguments pass them in a buffer on the stack
+    constexpr size_t INLINE_ARGS = 8;
+
+    // Builtins take their arguments through the entry point for the argument
+    // count if there is one, otherwise as a span over a buffer on the stack
+    static ValuePtr callBuiltin(const BuiltinProcValue& builtin, const std::vector<Closure>& args, EvalEnv& env) {
+        auto& spec = builtin.getSpec();
+        if (args.size() == 1 && spec.unary) {
+            return spec.unary(args[0](env), env);
+        }
+        if (args.size() == 2 && spec.binary) {
+            auto x = args[0](env);
+            return spec.binary(x, args[1](env), env);
+        }
+        if (args.size() <= INLINE_ARGS) {
+            std::array<ValuePtr, INLINE_ARGS> values;
+            for (size_t i = 0; i < args.size(); i++) {
+                values[i] = args[i](env);
+            }
+            return spec.func(Arguments(values.data(), args.size()), env);
+        }
+        std::vector<ValuePtr> values;
+        values.reserve(args.size());
+        for (const auto& arg : args) {
+            values.push_back(arg(env));
+        }
+        return spec.func(values, env);
+    }
+
+    static Closure compileCall(const ValuePtr& expr, const std::shared_ptr<PairValue>& pair, const ScopePtr& scope, bool tail) {
+        auto proc = compile(pair->getCar(), scope);
+        std::vector<Closure> args;
+        for (const auto& arg : pair->getCdr()->toVector()) {
+            args.push_back(compile(arg, scope));
+        }
+
+        return [expr, proc = std::move(proc), args = std::move(args), tail](EvalEnv& env) {
+            return env.execute(expr, [&proc, &args, tail](EvalEnv& env) {
+                auto car = proc(env);
+                if (!car->is<ProcedureValue>()) {
+                    throw LispError("Not a procedure: " + car->toString());
+                }
+                if (auto builtin = valueCast<BuiltinProcValue>(car.get())) {
+                    return callBuiltin(*builtin, args, env);
+                }
+                auto lambda = tail ? valueCast<LambdaValue>(car) : nullptr;
+                if (!lambda && args.size() <= INLINE_ARGS) {
+                    // The frame gets its own copy of the arguments, the buffer can live on the stack
+                    std::array<ValuePtr, INLINE_ARGS> values;
+                    for (size_t i = 0; i < args.size(); i++) {
+                        values[i] = args[i](env);
+                    }
+                    return env.apply(car, Arguments(values.data(), args.size()));
+                }
+                std::vector<ValuePtr> values;
+                values.reserve(args.size());
+                for (const auto& arg : args) {
+                    values.push_back(arg(env));
+                }
+                if (lambda) {
+                    return LambdaValue::tailCall(std::move(lambda), std::move(values));
+                }
+                return env.apply(car, values);
+            });
+        };
+    }
+
+    Closure compile(const ValuePtr& expr, const ScopePtr& scope, bool tail) {
+        Folding::Session session; // The call below and its operands share their folds
+        if (expr->is<SelfEvaluatingValue>()) {
+            return constant(expr);
+        }
+        if (expr->is<NilValue>()) {
+            return fail("Evaluating nil is prohibited.");
+        }
+        if (auto symbol = expr->asSymbol()) {
+            return compileSymbol(*symbol, scope);
+        }
+        if (expr->is<PairValue>()) {
+            if (!expr->isList()) return fail("Malformed list " + expr->toString());
+            auto pair = valueCast<PairValue>(expr);
+            if (auto name = pair->getCar()->asSymbol()) {
+                auto form = SpecialForms::SPECIAL_FORMS.find(*name);
+                if (form != SpecialForms::SPECIAL_FORMS.end()) { // Special form
+                    Closure code;
+                    try {
+                        code = form->second(pair->getCdr()->toVector(), scope, tail);
+                    } catch (const LispError& e) {
+                        code = fail(e.what());
+                    }
+                    return [expr, code = std::move(code)](EvalEnv& env) {
+                        return env.execute(expr, code);
+                    };
+                }
+            }
+            // Not special form, treat as built-in procedure call or lambda call
+            if (auto folded = Folding::fold(expr, scope)) {
+                return Folding::guard(std::move(folded->assumptions), constant(std::move(folded->value)), compileCall(expr, pair, scope, tail));
+            }
+            auto call = compileCall(expr, pair, scope, tail);
+            if (auto inlined = Inlining::expand(pair, scope, tail, call)) {
+                return std::move(*inlined);
+            }
+            return call;
+        }
+        return fail("Unimplemented");
+    }
+
+    Closure compileBody(const std::vector<ValuePtr>& body, const ScopePtr& scope, bool tail) {
+        if (body.empty()) {
+            return constant(Value::nil());
+        }
+        if (body.size() == 1) {
+            return compile(body[0], scope, tail);
+        }
+        std::vector<Closure> codes;
+        for (size_t i = 0; i < body.size(); i++) {
+            codes.push_back(compile(body[i], scope, tail && i + 1 == body.size()));
+        }
+        return [codes = std::move(codes)](EvalEnv& env) {
+            for (size_t i = 0; i + 1 < codes.size(); i++) {
+                codes[i](env);
+            }
+            return codes.back()(env);
+        };
+    }
+
+    Function compileFunction(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const ScopePtr& parent, bool tail) {
+        auto scope = std::make_shared<Scope>(parent, params);
+        declareDefines(body, *scope);
+        auto code = compileBody(body, scope, tail);
+        // Definitions the pre-scan missed are declared while compiling, so read the size last
+        return {std::move(code), {scope->names.size(), scope->captured}};
+    }
+}
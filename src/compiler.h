@@ -0,0 +1,65 @@
+//
+// Created by timetraveler314 on 6/2/24.
+//
+
+#ifndef MINI_LISP_COMPILER_H
+#define MINI_LISP_COMPILER_H
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "value.h"
+
+// Turns parsed forms into closure trees. Syntax is checked, special forms are
+// dispatched and constants are materialized once; running a Closure only does
+// the actual evaluation work.
+namespace Compiler {
+    // Compile-time picture of a local frame: the names it binds, in slot order.
+    // Local variables are resolved against the chain of scopes to a (depth, slot)
+    // pair; names found in no scope live in the global frame.
+    //
+    // A scope is captured once a closure is created in it or in a scope nested in
+    // it: the closure keeps the frame alive. The frames of other scopes are never
+    // referenced after their call returns, see EvalEnv::StackFrame.
+    struct Scope {
+        std::shared_ptr<Scope> parent;
+        std::vector<Symbol> names;
+        bool captured = false;
+
+        explicit Scope(std::shared_ptr<Scope> parent, std::vector<Symbol> names = {}):
+            parent{std::move(parent)}, names{std::move(names)} {}
+
+        std::optional<size_t> find(Symbol name) const;
+        size_t declare(Symbol name);
+        // Called for a closure created in this scope
+        void capture();
+    };
+
+    using ScopePtr = std::shared_ptr<Scope>;
+
+    // A body compiled against a fresh frame whose first slots hold the parameters
+    struct Function {
+        Closure body;
+        FrameLayout frame;
+    };
+
+    // `scope` is null for forms evaluated directly in the global frame. A form in
+    // `tail` position of a procedure body may yield a pending tail call, see
+    // LambdaValue::tailCall, so only bodies run by LambdaValue::apply set it.
+    Closure compile(const ValuePtr& expr, const ScopePtr& scope = nullptr, bool tail = false);
+
+    // Evaluates each form in order and yields the value of the last one, () if empty
+    Closure compileBody(const std::vector<ValuePtr>& body, const ScopePtr& scope = nullptr, bool tail = false);
+
+    // Opens a scope for `params` and the internal defines of `body` below `parent`.
+    // Procedure bodies are in tail position, a let body only if the let is.
+    Function compileFunction(const std::vector<Symbol>& params, const std::vector<ValuePtr>& body, const ScopePtr& parent, bool tail = true);
+
+    Closure constant(ValuePtr value);
+
+    // Defers a compile-time error to the moment the offending form is evaluated
+    Closure fail(std::string message);
+}
+
+#endif //MINI_LISP_COMPILER_H
@@ -14,60 +14,22 @@
 
 #include "error.h"
 #include "builtins.h"
-#include "forms.h"
+#include "compiler.h"
+#include "vm/vm.h"
 
-EvalEnv::EvalEnv(std::shared_ptr<EvalEnv> parent): parent{std::move(parent)}, symbolTable() {
-    for (const auto& [name, value] : Builtins::builtinMap) {
-        defineBinding(name, value);
-    }
-}
+EvalEnv::EvalEnv(std::shared_ptr<EvalEnv> parent): parent{std::move(parent)}, symbolTable() {}
 
-ValuePtr EvalEnv::eval(ValuePtr expr) {
-    try {
-        evalStack.emplace(expr);
-        auto result = eval_impl(expr);
-        evalStack.pop();
-        return result;
-    } catch (LispErrorWithEnv&) {
-        throw; // Rethrow if already wrapped
-    } catch (LispError& e) {
-        throw LispErrorWithEnv(e.what(), shared_from_this()); // Wrap the error with the current environment
-    }
+const std::shared_ptr<EvalEnv>& EvalEnv::builtinFrame() {
+    // Its bindings are Builtins::builtinMap itself, see lookupBinding
+    static const std::shared_ptr<EvalEnv> frame(new EvalEnv(nullptr));
+    return frame;
 }
 
-ValuePtr EvalEnv::eval_impl(ValuePtr expr) {
-    if (expr->is<SelfEvaluatingValue>()) {
-        return expr;
-    }
-    if (expr->is<NilValue>()) {
-        throw LispError("Evaluating nil is prohibited.");
-    }
-    if (auto symbol = expr->asSymbol()) {
-        auto value = lookupBinding(*symbol);
-        if (!value) {
-            throw LispError("Variable " + *symbol + " not defined.");
-        }
-        return *value;
-    }
-    if (expr->is<PairValue>()) {
-        if (!expr->isList()) throw LispError("Malformed list " + expr->toString());
-        auto pair = std::dynamic_pointer_cast<PairValue>(expr);
-        if (auto name = pair->getCar()->asSymbol()) {
-            if (SpecialForms::SPECIAL_FORMS.find(*name) != SpecialForms::SPECIAL_FORMS.end()) { // Special form
-                return SpecialForms::SPECIAL_FORMS.at(*name)(pair->getCdr()->toVector(), *this);
-            }
-        }
-        // Not special form, treat as built-in procedure call or lambda call
-        auto car = eval(pair->getCar());
-        if (car->is<ProcedureValue>()) {
-            auto args = pair->getCdr()->toVector()
-                        | std::views::transform([this](ValuePtr v) { return this->eval(std::move(v)); });
-            return this->apply(car, std::vector<ValuePtr>(args.begin(), args.end()));
-        }
-        // Not a procedure
-        throw LispError("Not a procedure: " + car->toString());
+ValuePtr EvalEnv::eval(ValuePtr expr) {
+    if (engine == Engine::VM) {
+        return VM::eval(expr, global());
     }
-    throw LispError("Unimplemented");
+    return execute(expr, Compiler::compile(expr));
 }
 
 std::vector<ValuePtr> EvalEnv::evalList(ValuePtr expr) {
@@ -78,25 +40,42 @@ std::vector<ValuePtr> EvalEnv::evalList(ValuePtr expr) {
     return result;
 }
 
-ValuePtr EvalEnv::apply(const ValuePtr& proc, const std::vector<ValuePtr>& args) {
-    if (auto procValue = std::dynamic_pointer_cast<ProcedureValue>(proc)) {
+ValuePtr EvalEnv::apply(const ValuePtr& proc, Arguments args) {
+    if (auto procValue = valueCast<ProcedureValue>(proc)) {
         return procValue->apply(args, *this);
     }
     throw LispError("Not a procedure: " + proc->toString());
 }
 
-std::optional<ValuePtr> EvalEnv::lookupBinding(const std::string& symbol) const {
-    if (symbolTable.find(symbol) != symbolTable.end()) {
-        return symbolTable.at(symbol);
+std::optional<ValuePtr> EvalEnv::lookupBinding(Symbol symbol) const {
+    if (auto binding = symbolTable.find(symbol); binding != symbolTable.end()) {
+        return binding->second;
     }
     if (parent) {
         return parent->lookupBinding(symbol);
     }
+    if (auto builtin = Builtins::builtinMap.find(symbol); builtin != Builtins::builtinMap.end()) {
+        return builtin->second;
+    }
     return std::nullopt;
 }
 
-void EvalEnv::defineBinding(const std::string &symbol, ValuePtr value) {
-    symbolTable[symbol] = std::move(value);
+void EvalEnv::defineBinding(Symbol symbol, ValuePtr value) {
+    // Bindings are global and long-lived, keep them out of the arena
+    auto [binding, inserted] = symbolTable.insert_or_assign(symbol, Value::promote(std::move(value)));
+    if (inserted) epoch++;
+}
+
+const ValuePtr* EvalEnv::lookupSlot(Symbol symbol) const {
+    for (auto env = this; env; env = env->parent.get()) {
+        if (auto binding = env->symbolTable.find(symbol); binding != env->symbolTable.end()) {
+            return &binding->second;
+        }
+    }
+    if (auto builtin = Builtins::builtinMap.find(symbol); builtin != Builtins::builtinMap.end()) {
+        return &builtin->second;
+    }
+    return nullptr;
 }
 
 std::string EvalEnv::generateStackTrace(int depth) {
@@ -105,10 +84,10 @@ std::string EvalEnv::generateStackTrace(int depth) {
 
     std::shared_ptr<EvalEnv> env = shared_from_this();
     while (env && count < depth) {
-        auto top = env->evalStack.top();
-        env->evalStack.pop();
+        auto top = env->evalStack.back();
+        env->evalStack.pop_back();
 
-        if (auto pair = std::dynamic_pointer_cast<PairValue>(top)) {
+        if (auto pair = valueCast<PairValue>(top)) {
             if (pair->position) {
                 if (!env->isGlobal()) {
                     ss << std::format("In environment: {}\n", env->getName());
@@ -131,7 +110,7 @@ std::string EvalEnv::generateStackTrace(int depth) {
     //     auto top = evalStack.top();
     //     evalStack.pop();
     //
-    //     if (auto pair = std::dynamic_pointer_cast<PairValue>(top)) {
+    //     if (auto pair = valueCast<PairValue>(top)) {
     //         if (pair->position) {
     //             ss << std::format("At: Line {}, column {}\n", pair->position->line, pair->position->column);
     //             ss << "  " << pair->toString() << std::endl;
@@ -145,7 +124,7 @@ std::string EvalEnv::generateStackTrace(int depth) {
 }
 
 void EvalEnv::clearStack() {
-    while (!evalStack.empty()) evalStack.pop();
+    evalStack.clear();
 
     if (parent) {
         parent->clearStack();
@@ -153,29 +132,79 @@ void EvalEnv::clearStack() {
 }
 
 std::shared_ptr<EvalEnv>
-EvalEnv::createChild(const std::vector<std::string> &params, const std::vector<ValuePtr> &args, const std::shared_ptr<EvalEnv>& runtimeParent) {
-    if (params.size() != args.size()) {
-        throw LispError("Child EvalEnv parameter count mismatch.");
-    }
-    auto child = EvalEnv::createGlobal();
-    child->parent = shared_from_this();
+EvalEnv::createChild(std::vector<ValuePtr> args, size_t frameSize, const std::shared_ptr<EvalEnv>& runtimeParent) {
+    auto child = std::shared_ptr<EvalEnv>(new EvalEnv(shared_from_this()));
+    child->engine = engine;
     child->runtimeParent = runtimeParent;
-    for (size_t i = 0; i < params.size(); ++i) {
-        child->defineBinding(params[i], args[i]);
-    }
+    child->globalEnv = &global();
+    child->slots = std::move(args);
+    child->slots.resize(frameSize);
     return child;
 }
 
-std::shared_ptr<EvalEnv> EvalEnv::createChild(const std::vector<std::string> &params, const std::vector<ValuePtr> &args,
+std::shared_ptr<EvalEnv> EvalEnv::createChild(std::vector<ValuePtr> args, size_t frameSize,
                                               const std::string &name, const std::shared_ptr<EvalEnv> &runtimeParent) {
-    auto child = createChild(params, args, runtimeParent);
+    auto child = createChild(std::move(args), frameSize, runtimeParent);
     child->name = name;
     return child;
 }
 
+EvalEnv::StackFrame::StackFrame(EvalEnv& parent, Arguments args, size_t frameSize, const std::shared_ptr<EvalEnv>& runtimeParent,
+                                const std::optional<std::string>& name) {
+    if (frameStackTop == frameStack.size()) {
+        frameStack.emplace_back();
+    }
+    auto& slot = frameStack[frameStackTop++];
+    if (!slot) {
+        slot = std::shared_ptr<EvalEnv>(new EvalEnv(nullptr));
+    }
+    frame = slot.get();
+    frame->parent = parent.shared_from_this();
+    frame->runtimeParent = runtimeParent;
+    frame->engine = parent.engine;
+    frame->globalEnv = &parent.global();
+    frame->name = name;
+    // Keeps the capacity of the slots from the last use
+    frame->slots.assign(args.begin(), args.end());
+    frame->slots.resize(frameSize);
+}
+
+EvalEnv::StackFrame::~StackFrame() {
+    auto& slot = frameStack[--frameStackTop];
+    if (slot.use_count() > 1) {
+        slot = nullptr; // Still referenced, leave it to its other owners
+        return;
+    }
+    frame->parent = nullptr;
+    frame->runtimeParent = nullptr;
+    frame->slots.clear();
+    frame->evalStack.clear();
+}
+
 void EvalEnv::reset() {
-    symbolTable.clear();
-    for (const auto& [name, value] : Builtins::builtinMap) {
-        defineBinding(name, value);
+    symbolTable.clear(); // Builtins live in the shared root frame and stay visible
+    epoch++;
+}
+
+std::shared_ptr<GC::Traceable> EvalEnv::lock() {
+    return weak_from_this().lock();
+}
+
+void EvalEnv::trace(GC::Tracer &tracer) const {
+    tracer(parent);
+    tracer(runtimeParent);
+    for (const auto& [symbol, value] : symbolTable) tracer(value);
+    for (const auto& value : slots) tracer(value);
+    for (const auto& form : evalStack) tracer(form);
+}
+
+void EvalEnv::clear() {
+    parent.reset();
+    runtimeParent.reset();
+    if (!symbolTable.empty()) {
+        symbolTable.clear();
+        epoch++; // Cached lookups may point into the table
     }
+    slots.clear();
+    evalStack.clear();
 }
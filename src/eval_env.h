@@ -5,45 +5,127 @@
 #ifndef MINI_LISP_EVAL_ENV_H
 #define MINI_LISP_EVAL_ENV_H
 
-#include <stack>
-
 #include "value.h"
+#include "error.h"
+
+enum class Engine {
+    TREE, // Closure trees, see compiler.h
+    VM,   // Bytecode and stack machine, see vm/vm.h
+};
 
-class EvalEnv : public std::enable_shared_from_this<EvalEnv> {
+class EvalEnv : public std::enable_shared_from_this<EvalEnv>, public GC::Traceable {
     std::optional<std::string> name;
+    Engine engine = Engine::TREE;
 
     std::shared_ptr<EvalEnv> parent;
     std::shared_ptr<EvalEnv> runtimeParent;
-    std::unordered_map<std::string, ValuePtr> symbolTable;
+    // The name-keyed frame at the root of the lexical chain, null for global frames
+    EvalEnv* globalEnv = nullptr;
+    // Global frames bind by name, local frames by slot, see Compiler::Scope
+    std::unordered_map<Symbol, ValuePtr> symbolTable;
+    std::vector<ValuePtr> slots;
 
-    std::stack<ValuePtr> evalStack;
+    std::vector<ValuePtr> evalStack;
 
     explicit EvalEnv(std::shared_ptr<EvalEnv> parent);
-    ValuePtr eval_impl(ValuePtr expr);
+
+    // Bumped whenever a binding is added or removed anywhere
+    static inline uint64_t epoch = 0;
+
+    // The read-only root frame holding the builtins, shared by every global environment
+    static const std::shared_ptr<EvalEnv>& builtinFrame();
+
+    // Frames handed out by StackFrame, the ones below `frameStackTop` in use
+    static inline std::vector<std::shared_ptr<EvalEnv>> frameStack;
+    static inline size_t frameStackTop = 0;
 
 public:
     static std::shared_ptr<EvalEnv> createGlobal() {
-        return std::shared_ptr<EvalEnv>(new EvalEnv(nullptr));
+        return std::shared_ptr<EvalEnv>(new EvalEnv(builtinFrame()));
     }
 
-    std::shared_ptr<EvalEnv> createChild(const std::vector<std::string>& params, const std::vector<ValuePtr>& args, const std::shared_ptr<EvalEnv>& runtimeParent = nullptr);
-    std::shared_ptr<EvalEnv> createChild(const std::vector<std::string>& params, const std::vector<ValuePtr>& args, const std::string& name, const std::
+    // A local frame of `frameSize` slots, the first ones holding `args`
+    std::shared_ptr<EvalEnv> createChild(std::vector<ValuePtr> args, size_t frameSize, const std::shared_ptr<EvalEnv>& runtimeParent = nullptr);
+    std::shared_ptr<EvalEnv> createChild(std::vector<ValuePtr> args, size_t frameSize, const std::string& name, const std::
                                          shared_ptr<EvalEnv> &runtimeParent = nullptr);
 
+    // A local frame like createChild's for a call whose frame no closure
+    // captures (see Compiler::Scope). It is taken from a stack of frames
+    // reused from call to call instead of the heap, and returns there when
+    // the StackFrame goes out of scope, unless something (an error being
+    // reported, a callee's frame) still holds on to it.
+    class StackFrame {
+        EvalEnv* frame;
+
+    public:
+        StackFrame(EvalEnv& parent, Arguments args, size_t frameSize, const std::shared_ptr<EvalEnv>& runtimeParent,
+                   const std::optional<std::string>& name = std::nullopt);
+        ~StackFrame();
+
+        StackFrame(const StackFrame&) = delete;
+        StackFrame& operator=(const StackFrame&) = delete;
+
+        EvalEnv& operator*() const {
+            return *frame;
+        }
+    };
+
     bool isGlobal() const {
-        return parent == nullptr;
+        return parent == nullptr || parent == builtinFrame();
     }
 
     void reset();
 
+    Engine getEngine() const {
+        return engine;
+    }
+
+    void setEngine(Engine newEngine) {
+        engine = newEngine;
+    }
+
+    // Compiles and runs a form
     ValuePtr eval(ValuePtr expr);
 
+    // Runs compiled code for `form`, recording the form for stack traces
+    template<typename F>
+    ValuePtr execute(const ValuePtr& form, const F& code) {
+        try {
+            evalStack.push_back(form);
+            auto result = code(*this);
+            evalStack.pop_back();
+            return result;
+        } catch (LispErrorWithEnv&) {
+            throw; // Rethrow if already wrapped
+        } catch (LispError& e) {
+            throw LispErrorWithEnv(e.what(), shared_from_this()); // Wrap the error with the current environment
+        }
+    }
+
     std::vector<ValuePtr> evalList(ValuePtr expr);
 
-    ValuePtr apply(const ValuePtr& proc, const std::vector<ValuePtr>& args);
+    ValuePtr apply(const ValuePtr& proc, Arguments args);
 
-    std::optional<ValuePtr> lookupBinding(const std::string& symbol) const;
-    void defineBinding(const std::string& symbol, ValuePtr value);
+    // Slot `index` of the local frame `depth` levels up the lexical chain
+    ValuePtr& local(size_t depth, size_t index) {
+        auto env = this;
+        while (depth--) env = env->parent.get();
+        return env->slots[index];
+    }
+
+    EvalEnv& global() {
+        return globalEnv ? *globalEnv : *this;
+    }
+
+    std::optional<ValuePtr> lookupBinding(Symbol symbol) const;
+    void defineBinding(Symbol symbol, ValuePtr value);
+
+    // Storage of the visible binding of `symbol`. It stays valid as long as
+    // bindingsEpoch() is unchanged, which lets callers cache lookups.
+    const ValuePtr* lookupSlot(Symbol symbol) const;
+    static uint64_t bindingsEpoch() {
+        return epoch;
+    }
 
     bool isStackEmpty() const {
         return evalStack.empty();
@@ -54,6 +136,10 @@ public:
     std::string getName() const {
         return name.value_or("<anonymous>");
     }
+
+    std::shared_ptr<GC::Traceable> lock() override;
+    void trace(GC::Tracer& tracer) const override;
+    void clear() override;
 };
 
 #endif //MINI_LISP_EVAL_ENV_H
@@ -0,0 +1,25 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+#include "f64vector.h"
+
+std::string F64VectorValue::toString() const {
+    std::string result = "#f64(";
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (i > 0) result += ' ';
+        result += NumericValue(elements[i]).toString();
+    }
+    return result + ")";
+}
+
+bool F64VectorValue::isEqual(const ValuePtr& other) const {
+    auto vector = valueCast<F64VectorValue>(other.get());
+    return vector && elements == vector->elements;
+}
+
+size_t F64VectorValue::hash() const {
+    size_t result = elements.size();
+    for (auto element : elements) result = result * 31 + std::hash<double>()(element);
+    return result;
+}
@@ -0,0 +1,51 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+#ifndef MINI_LISP_F64VECTOR_H
+#define MINI_LISP_F64VECTOR_H
+
+#include <vector>
+
+#include "value.h"
+
+// A vector of unboxed doubles for numeric code. Elements are read out as
+// flonums; the builtins on whole vectors run on the kernels in simd.h.
+class F64VectorValue final : public Value {
+    std::vector<double> elements;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::F64VECTOR_VALUE);
+
+    explicit F64VectorValue(std::vector<double> elements):
+        Value(ValueType::F64VECTOR_VALUE), elements{std::move(elements)} {}
+
+    explicit F64VectorValue(size_t size, double fill = 0): F64VectorValue(std::vector<double>(size, fill)) {}
+
+    size_t size() const {
+        return elements.size();
+    }
+
+    double* data() {
+        return elements.data();
+    }
+
+    const double* data() const {
+        return elements.data();
+    }
+
+    double& operator[](size_t index) {
+        return elements[index];
+    }
+
+    double operator[](size_t index) const {
+        return elements[index];
+    }
+
+    std::string toString() const override;
+
+    bool isEqual(const ValuePtr& other) const override;
+    size_t hash() const override;
+};
+
+#endif //MINI_LISP_F64VECTOR_H
@@ -0,0 +1,181 @@
+//
+// Created by timetraveler314 on 6/12/24.
+//
+
+#include "folding.h"
+
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+#include "bigint.h"
+#include "builtins.h"
+#include "error.h"
+#include "eval_env.h"
+#include "forms.h"
+#include "utils/utils.h"
+
+namespace Folding {
+    static bool isLocal(Symbol name, const Compiler::ScopePtr& scope) {
+        for (auto current = scope.get(); current; current = current->parent.get()) {
+            if (current->find(name)) return true;
+        }
+        return false;
+    }
+
+    static void assume(std::vector<Assumption>& assumptions, const std::vector<Assumption>& more) {
+        for (const auto& assumption : more) {
+            if (std::ranges::none_of(assumptions, [&](const Assumption& a) { return a.name == assumption.name; })) {
+                assumptions.push_back(assumption);
+            }
+        }
+    }
+
+    // Pure builtins never look at the environment, but their signature wants one
+    static EvalEnv& foldingEnv() {
+        static auto env = EvalEnv::createGlobal();
+        return *env;
+    }
+
+    // The folds of the open sessions. The entries hold on to their expressions,
+    // so that no other expression gets the address of one while they are kept.
+    static size_t sessions = 0;
+    static size_t suppressed = 0;
+    static std::unordered_map<const Value*, std::pair<ValuePtr, std::optional<Constant>>> folds;
+
+    Session::Session() {
+        sessions++;
+    }
+
+    Session::~Session() {
+        if (--sessions == 0) folds.clear();
+    }
+
+    Suppress::Suppress() {
+        suppressed++;
+    }
+
+    Suppress::~Suppress() {
+        suppressed--;
+    }
+
+    // Bits in the magnitude of an exact integer, nothing for other values
+    static std::optional<size_t> integerBits(const Value& value) {
+        if (auto fixnum = valueCast<FixnumValue>(&value)) {
+            auto x = fixnum->getValue();
+            return std::bit_width(x < 0 ? 0 - static_cast<uint64_t>(x) : static_cast<uint64_t>(x));
+        }
+        if (auto bignum = valueCast<BignumValue>(&value)) return bignum->getValue().size() * 32;
+        return std::nullopt;
+    }
+
+    // Whether calling builtin `name` on `args` may build an integer beyond MAX_FOLDED_LIMBS
+    static bool tooLarge(Symbol name, const std::vector<ValuePtr>& args) {
+        static const Symbol MUL{"*"}, EXPT{"expt"};
+        constexpr size_t MAX_BITS = MAX_FOLDED_LIMBS * 32;
+        if (name == MUL) {
+            size_t bits = 0;
+            for (const auto& arg : args) {
+                auto size = integerBits(*arg);
+                if (!size) return false; // Inexact, so is the product
+                bits += *size;
+            }
+            return bits > MAX_BITS;
+        }
+        if (name == EXPT && args.size() == 2) {
+            auto base = integerBits(*args[0]);
+            if (!base || !integerBits(*args[1])) return false; // Inexact
+            auto exponent = valueCast<FixnumValue>(args[1].get());
+            if (!exponent) return true; // A bignum exponent
+            if (exponent->getValue() < 0 || *base <= 1) return false; // Inexact, or 0 or ±1 to some power
+            return static_cast<uint64_t>(exponent->getValue()) > MAX_BITS / *base;
+        }
+        return false;
+    }
+
+    static std::optional<Constant> foldNew(const ValuePtr& expr, const Compiler::ScopePtr& scope);
+
+    std::optional<Constant> fold(const ValuePtr& expr, const Compiler::ScopePtr& scope) {
+        if (suppressed > 0) return std::nullopt;
+        Session session;
+        if (auto cached = folds.find(expr.get()); cached != folds.end()) return cached->second.second;
+        auto result = foldNew(expr, scope);
+        folds.emplace(expr.get(), std::pair(expr, result));
+        return result;
+    }
+
+    static std::optional<Constant> foldNew(const ValuePtr& expr, const Compiler::ScopePtr& scope) {
+        if (expr->is<SelfEvaluatingValue>()) {
+            return Constant{expr, {}};
+        }
+        auto pair = valueCast<PairValue>(expr);
+        if (!pair || !pair->isList()) return std::nullopt;
+        auto head = pair->getCar()->asSymbol();
+        if (!head) return std::nullopt;
+        auto operands = pair->getCdr()->toVector();
+
+        if (*head == Symbol::QUOTE) {
+            if (operands.size() != 1) return std::nullopt;
+            return Constant{operands[0], {}};
+        }
+        if (*head == Symbol::IF) {
+            if (operands.size() != 2 && operands.size() != 3) return std::nullopt;
+            auto test = fold(operands[0], scope);
+            if (!test) return std::nullopt;
+            auto branch = !Utils::isFalse(test->value) ? fold(operands[1], scope)
+                        : operands.size() == 3 ? fold(operands[2], scope)
+                        : std::optional(Constant{Value::nil(), {}});
+            if (!branch) return std::nullopt;
+            assume(branch->assumptions, test->assumptions);
+            return branch;
+        }
+        if (SpecialForms::SPECIAL_FORMS.contains(*head) || isLocal(*head, scope)) {
+            return std::nullopt;
+        }
+
+        auto entry = Builtins::builtinMap.find(*head);
+        if (entry == Builtins::builtinMap.end()) return std::nullopt;
+        auto builtin = valueCast<BuiltinProcValue>(entry->second.get());
+        if (!builtin->getSpec().pure || !builtin->accepts(operands.size())) return std::nullopt;
+
+        Constant result{nullptr, {{*head, entry->second}}};
+        std::vector<ValuePtr> args;
+        for (const auto& operand : operands) {
+            auto arg = fold(operand, scope);
+            if (!arg) return std::nullopt;
+            args.push_back(std::move(arg->value));
+            assume(result.assumptions, arg->assumptions);
+        }
+        if (tooLarge(*head, args)) return std::nullopt;
+        try {
+            // Folded values live as long as the code, keep them out of the arena
+            result.value = Value::promote(builtin->getSpec().func(args, foldingEnv()));
+        } catch (const LispError&) {
+            return std::nullopt; // Let the call fail when it runs
+        }
+        return result;
+    }
+
+    Closure guard(std::vector<Assumption> assumptions, Closure folded, Closure fallback) {
+        if (assumptions.empty()) return folded;
+        // Where the names are bound is looked up again only when a definition
+        // may have moved them, like Compiler::compileSymbol does
+        return [assumptions = std::move(assumptions), folded = std::move(folded), fallback = std::move(fallback),
+                global = static_cast<const EvalEnv*>(nullptr), epoch = uint64_t{0}, bindings = std::vector<const ValuePtr*>()](EvalEnv& env) mutable {
+            auto& globalEnv = env.global();
+            if (global != &globalEnv || epoch != EvalEnv::bindingsEpoch()) {
+                global = &globalEnv;
+                epoch = EvalEnv::bindingsEpoch();
+                bindings.clear();
+                for (const auto& assumption : assumptions) {
+                    bindings.push_back(globalEnv.lookupSlot(assumption.name));
+                }
+            }
+            // Redefining a name keeps its binding but changes the value
+            for (size_t i = 0; i < assumptions.size(); i++) {
+                if (!bindings[i] || *bindings[i] != assumptions[i].builtin) return fallback(env);
+            }
+            return folded(env);
+        };
+    }
+}
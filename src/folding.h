@@ -0,0 +1,66 @@
+//
+// Created by timetraveler314 on 6/12/24.
+//
+
+#ifndef MINI_LISP_FOLDING_H
+#define MINI_LISP_FOLDING_H
+
+#include <optional>
+#include <vector>
+
+#include "compiler.h"
+
+// Constant folding over parsed forms, run by the compiler before it emits code.
+// Literals and quotes are constants, and so are calls of pure builtins (see
+// BuiltinSpec::pure) and `if`s whose operands are constants.
+//
+// Folding a call assumes its global name still means the builtin when the code
+// runs, which a later definition may change. The compiler therefore emits folded
+// code behind a guard that checks the assumptions and falls back to the code as
+// written once they break.
+//
+// Compiling a call folds it and then compiles its operands, which fold them
+// again. Within a Session each expression is folded once and the result reused,
+// so the work stays linear in the size of the form. Exact products and powers
+// are not folded beyond MAX_FOLDED_LIMBS limbs; they are left to run, if ever.
+namespace Folding {
+    constexpr size_t MAX_FOLDED_LIMBS = 64;
+
+    struct Assumption {
+        Symbol name;
+        ValuePtr builtin;
+    };
+
+    struct Constant {
+        ValuePtr value;
+        std::vector<Assumption> assumptions;
+    };
+
+    // The value of `expr` if it is a constant. Names bound in `scope` are never builtins.
+    std::optional<Constant> fold(const ValuePtr& expr, const Compiler::ScopePtr& scope);
+
+    // Keeps the folds of every expression met while one is alive, the outermost
+    // one forgets them. Compiler::compile opens one around each form.
+    class Session {
+    public:
+        Session();
+        ~Session();
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+    };
+
+    // Nothing folds while one is alive: for code that runs only once the
+    // assumptions of a fold break, such as the branch a constant test skips
+    class Suppress {
+    public:
+        Suppress();
+        ~Suppress();
+        Suppress(const Suppress&) = delete;
+        Suppress& operator=(const Suppress&) = delete;
+    };
+
+    // Runs `folded` while all `assumptions` hold in the global frame and `fallback` otherwise
+    Closure guard(std::vector<Assumption> assumptions, Closure folded, Closure fallback);
+}
+
+#endif //MINI_LISP_FOLDING_H
@@ -3,11 +3,15 @@
 //
 #include <ranges>
 #include "forms.h"
+#include "batch.h"
+#include "compiler.h"
 #include "error.h"
+#include "folding.h"
+#include "inlining.h"
 #include "utils/utils.h"
 
 namespace SpecialForms {
-    const std::unordered_map<std::string, SpecialFormType> SPECIAL_FORMS {
+    const std::unordered_map<Symbol, SpecialFormType> SPECIAL_FORMS {
         {"define", _define},
         {"quote", _quote},
         {"if", _if},
@@ -22,196 +26,322 @@ namespace SpecialForms {
         {"λ", _lambda},
     };
 
-    ValuePtr _define(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    static std::vector<Symbol> lambdaParameters(const ValuePtr& list) {
+        auto viewLambdaParams = list->toVector()
+                                | std::views::transform([](const ValuePtr& v) { return v->asSymbol(); })
+                                | std::views::transform([](const std::optional<Symbol>& s) {
+            if (!s) {
+                throw LispError("lambda: Arguments must be symbols.");
+            }
+            return *s;
+        });
+        return {viewLambdaParams.begin(), viewLambdaParams.end()};
+    }
+
+    // Only the last of the forms inherits the tail position
+    static std::vector<Closure> compileAll(const std::vector<ValuePtr>& exprs, const Compiler::ScopePtr& scope, bool tail) {
+        std::vector<Closure> result;
+        for (size_t i = 0; i < exprs.size(); i++) {
+            result.push_back(Compiler::compile(exprs[i], scope, tail && i + 1 == exprs.size()));
+        }
+        return result;
+    }
+
+    // Binds `name` in the innermost frame: a slot of the enclosing scope, or the global frame
+    static Closure defineIn(const Compiler::ScopePtr& scope, Symbol name, Closure value) {
+        if (scope) {
+            return [slot = scope->declare(name), value = std::move(value)](EvalEnv& env) {
+                env.local(0, slot) = value(env);
+                return Value::nil();
+            };
+        }
+        return [name, value = std::move(value)](EvalEnv& env) {
+            env.global().defineBinding(name, value(env));
+            return Value::nil();
+        };
+    }
+
+    Closure _define(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         if (params.size() == 0) throw LispError("define: expected at least 2 arguments.");
-        if (auto symbol = std::dynamic_pointer_cast<SymbolValue>(params[0])) {
+        if (auto symbol = params[0]->asSymbol()) {
             Utils::checkParams("define", 2, params);
-            env.defineBinding(symbol->getValue(), env.eval(params[1]));
-        } else if (auto pair = std::dynamic_pointer_cast<PairValue>(params[0])) {
+            if (scope) scope->declare(*symbol); // Visible to its own value
+            return defineIn(scope, *symbol, Compiler::compile(params[1], scope));
+        } else if (auto pair = valueCast<PairValue>(params[0])) {
             if (pair->getCar()->is<SymbolValue>()) {
                 if (params.size() < 2) {
                     throw LispError("define: expected at least 2 arguments.");
                 }
-                auto symbol = pair->getCar()->asSymbol();
-
-                auto viewLambdaParams = pair->getCdr()->toVector()
-                                        | std::views::transform([](const ValuePtr& v) { return v->asSymbol(); })
-                                        | std::views::transform([](const std::optional<std::string>& s) {
-                    if (!s) {
-                        throw LispError("lambda: Arguments must be symbols.");
-                    }
-                    return *s;
+                auto symbol = *pair->getCar()->asSymbol();
+                auto lambdaParams = lambdaParameters(pair->getCdr());
+                if (scope) {
+                    scope->declare(symbol);
+                    scope->capture();
+                }
+                std::vector body(params.begin() + 1, params.end());
+                // Later call sites may expand small procedures defined globally
+                auto definition = scope ? nullptr : Inlining::define(symbol, lambdaParams, body);
+                auto program = Batch::compile(lambdaParams, body, scope);
+                auto [lambdaBody, frame] = Compiler::compileFunction(lambdaParams, body, scope);
+                return defineIn(scope, symbol, [symbol, lambdaParams = std::move(lambdaParams), lambdaBody = std::move(lambdaBody), frame,
+                                                definition = std::move(definition), program = std::move(program)](EvalEnv& env) -> ValuePtr {
+                    return std::make_shared<LambdaValue>(env.shared_from_this(), lambdaParams, lambdaBody, frame, symbol.name(), definition, program);
                 });
-                std::vector lambdaParams(viewLambdaParams.begin(), viewLambdaParams.end());
-
-                auto lambdaBody = std::vector(params.begin() + 1, params.end());
-                env.defineBinding(*symbol, std::make_shared<LambdaValue>(env.shared_from_this(), std::move(lambdaParams), std::move(lambdaBody), *symbol));
-                return std::make_shared<NilValue>();
             } else {
                 throw LispError("define: Invalid expression.");
             }
-        } else{
+        } else {
             throw LispError("define: Invalid expression.");
         }
-
-        return std::make_shared<NilValue>();
     }
 
-    ValuePtr _quote(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _quote(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         Utils::checkParams("quote", 1, params);
-        return params[0];
+        return Compiler::constant(params[0]);
     }
 
-    ValuePtr _quasiquote_impl(const ValuePtr& value, EvalEnv& env) {
-        if (auto pair = std::dynamic_pointer_cast<PairValue>(value)) {
-            if (pair->getCar()->is<SymbolValue>() && *pair->getCar()->asSymbol() == "unquote") {
-                Utils::checkParams("unquote", 1, pair->getCdr()->toVector());
-                return env.eval(pair->getCdr()->toVector()[0]);
-            } else {
-                return std::make_shared<PairValue>(_quasiquote_impl(pair->getCar(), env),
-                                                   _quasiquote_impl(pair->getCdr(), env));
+    // Whether `value` has an unquote to fill in at quasiquote depth `depth`.
+    // A nested quasiquote goes one level deeper, an unquote one level back out,
+    // and only the unquotes at depth 0 are evaluated.
+    static bool containsUnquote(const ValuePtr& value, size_t depth) {
+        if (auto pair = valueCast<PairValue>(value)) {
+            auto head = pair->getCar()->asSymbol();
+            if (head == Symbol::UNQUOTE) {
+                return depth == 0 || containsUnquote(pair->getCdr(), depth - 1);
             }
+            if (head == Symbol::QUASIQUOTE) return containsUnquote(pair->getCdr(), depth + 1);
+            return containsUnquote(pair->getCar(), depth) || containsUnquote(pair->getCdr(), depth);
+        }
+        return false;
+    }
+
+    // The depth the operands of a form headed by `head` are at
+    static size_t operandDepth(const std::optional<Symbol>& head, size_t depth) {
+        if (head == Symbol::QUASIQUOTE) return depth + 1;
+        if (head == Symbol::UNQUOTE) return depth - 1;
+        return depth;
+    }
+
+    Closure _quasiquote_impl(const ValuePtr& value, const Compiler::ScopePtr& scope, size_t depth) {
+        if (!containsUnquote(value, depth)) {
+            return Compiler::constant(value); // Nothing to splice in, the template is a constant
+        }
+        auto pair = valueCast<PairValue>(value);
+        auto head = pair->getCar()->asSymbol();
+        if (head == Symbol::UNQUOTE && depth == 0) {
+            auto operands = pair->getCdr()->toVector();
+            Utils::checkParams("unquote", 1, operands);
+            return Compiler::compile(operands[0], scope);
         } else {
-            return value;
+            return [car = _quasiquote_impl(pair->getCar(), scope, depth),
+                    cdr = _quasiquote_impl(pair->getCdr(), scope, operandDepth(head, depth))](EvalEnv& env) -> ValuePtr {
+                return PairValue::create(car(env), cdr(env));
+            };
         }
     }
 
-    ValuePtr _quasiquote(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _quasiquote(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         Utils::checkParams("quasiquote", 1, params);
-        return _quasiquote_impl(params[0], env);
+        return _quasiquote_impl(params[0], scope, 0);
     }
 
-    ValuePtr _unquote(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _unquote(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         throw LispError("unquote: Invalid context.");
     }
 
-    ValuePtr _if(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _if(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         Utils::checkParams("if", 2, 3, params);
-        auto condition = env.eval(params[0]);
-        if (Utils::isFalse(condition)) {
-            if (params.size() == 3) return env.eval(params[2]);
-            else return std::make_shared<NilValue>(); // Undefined behavior, return ()
-        } else {
-            return env.eval(params[1]);
+        // A constant test leaves one branch to run. The other one is needed only
+        // once the assumptions of the test break, so nothing in it is folded, and
+        // without assumptions it is not compiled at all.
+        auto test = Folding::fold(params[0], scope);
+        auto compileBranch = [&](size_t index) {
+            // Undefined behavior when the alternative is missing, return ()
+            if (index == params.size()) return Compiler::constant(Value::nil());
+            if (!test || Utils::isFalse(test->value) == (index == 2)) return Compiler::compile(params[index], scope, tail);
+            Folding::Suppress suppress;
+            return Compiler::compile(params[index], scope, tail);
+        };
+        if (test && test->assumptions.empty()) {
+            return compileBranch(Utils::isFalse(test->value) ? 2 : 1);
         }
+        auto condition = Compiler::compile(params[0], scope);
+        auto consequent = compileBranch(1);
+        auto alternative = compileBranch(2);
+        auto branch = test ? (Utils::isFalse(test->value) ? alternative : consequent) : nullptr;
+        Closure code = [condition = std::move(condition), consequent = std::move(consequent), alternative = std::move(alternative)](EvalEnv& env) {
+            if (Utils::isFalse(condition(env))) {
+                return alternative(env);
+            } else {
+                return consequent(env);
+            }
+        };
+        return test ? Folding::guard(std::move(test->assumptions), std::move(branch), std::move(code)) : code;
     }
 
-    ValuePtr _and(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _and(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         if (params.empty()) {
-            return std::make_shared<BooleanValue>(true);
+            return Compiler::constant(Value::boolean(true));
         }
-        ValuePtr evalResult;
-        for (const auto& param : params) {
-            evalResult = env.eval(param);
-            if (Utils::isFalse(evalResult)) {
-                return std::make_shared<BooleanValue>(false);
+        return [operands = compileAll(params, scope, tail)](EvalEnv& env) {
+            ValuePtr evalResult;
+            for (const auto& operand : operands) {
+                evalResult = operand(env);
+                if (Utils::isFalse(evalResult)) {
+                    return evalResult;
+                }
             }
-        }
-        return evalResult;
+            return evalResult;
+        };
     }
 
-    ValuePtr _or(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _or(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         if (params.empty()) {
-            return std::make_shared<BooleanValue>(false);
+            return Compiler::constant(Value::boolean(false));
         }
-
-        ValuePtr evalResult;
-        for (const auto& param : params) {
-            evalResult = env.eval(param);
-            if (!Utils::isFalse(evalResult)) {
-                break;
+        return [operands = compileAll(params, scope, tail)](EvalEnv& env) {
+            ValuePtr evalResult;
+            for (const auto& operand : operands) {
+                evalResult = operand(env);
+                if (!Utils::isFalse(evalResult)) {
+                    break;
+                }
             }
-        }
-        return evalResult;
+            return evalResult;
+        };
     }
 
-    ValuePtr _cond(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _cond(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
+        struct Clause {
+            Closure test;                 // Empty for `else`
+            std::optional<Closure> body;  // Empty when the clause yields its test value
+        };
+        std::vector<Clause> clauses;
+        // The same with clauses behind a constant test dropped, and the first
+        // clause with a true one made the last
+        std::vector<Clause> pruned;
+        std::vector<Folding::Assumption> assumptions;
+        bool reachable = true;
         for (auto it = params.begin(); it != params.end(); it++) {
             const auto& param = *it;
-            if (auto pair = std::dynamic_pointer_cast<PairValue>(param)) {
-                if (pair->getCar()->is<SymbolValue>() && *pair->getCar()->asSymbol() == "else") {
-                    if (pair->getCdr()->is<NilValue>()) {
+            if (auto pair = valueCast<PairValue>(param)) {
+                auto rest = pair->getCdr()->toVector();
+                if (pair->getCar()->asSymbol() == Symbol::ELSE) {
+                    if (rest.empty()) {
                         throw LispError("cond: `else` must be followed by an expression.");
                     }
                     if (it + 1 != params.end()) throw LispError("cond: `else` must be the last clause.");
-                    return env.evalList(pair->getCdr()).back();
-                }
-                ValuePtr result = env.eval(pair->getCar());
-                if (!Utils::isFalse(result)) {
-                    if (pair->getCdr()->is<NilValue>()) {
-                        return result;
+                    std::optional<Folding::Suppress> suppress;
+                    if (!reachable) suppress.emplace();
+                    clauses.push_back({nullptr, Compiler::compileBody(rest, scope, tail)});
+                    suppress.reset();
+                    if (reachable) pruned.push_back(clauses.back());
+                } else {
+                    // Clauses behind a constant test, and bodies behind a false
+                    // one, run only once the assumptions break: nothing there folds
+                    auto test = reachable ? Folding::fold(pair->getCar(), scope) : std::nullopt;
+                    std::optional<Folding::Suppress> suppress;
+                    if (!reachable) suppress.emplace();
+                    auto condition = Compiler::compile(pair->getCar(), scope);
+                    if (test && Utils::isFalse(test->value)) suppress.emplace();
+                    clauses.push_back({std::move(condition),
+                                       rest.empty() ? std::nullopt : std::optional(Compiler::compileBody(rest, scope, tail))});
+                    suppress.reset();
+                    if (!test) {
+                        if (reachable) pruned.push_back(clauses.back());
+                        continue;
+                    }
+                    assumptions.insert(assumptions.end(), test->assumptions.begin(), test->assumptions.end());
+                    if (!Utils::isFalse(test->value)) {
+                        pruned.push_back({nullptr, clauses.back().body.value_or(Compiler::constant(test->value))});
+                        reachable = false;
                     }
-                    return env.evalList(pair->getCdr()).back();
                 }
             } else {
                 throw LispError("cond: Invalid expression.");
             }
         }
-        return std::make_shared<NilValue>();
+        auto code = [](std::vector<Clause> clauses) -> Closure {
+            return [clauses = std::move(clauses)](EvalEnv& env) -> ValuePtr {
+                for (const auto& clause : clauses) {
+                    if (!clause.test) {
+                        return (*clause.body)(env);
+                    }
+                    ValuePtr result = clause.test(env);
+                    if (!Utils::isFalse(result)) {
+                        if (!clause.body) {
+                            return result;
+                        }
+                        return (*clause.body)(env);
+                    }
+                }
+                return Value::nil();
+            };
+        };
+        if (pruned.size() == clauses.size() && reachable) return code(std::move(clauses));
+        return Folding::guard(std::move(assumptions), code(std::move(pruned)), code(std::move(clauses)));
     }
 
-    ValuePtr _begin(const std::vector<ValuePtr> &params, EvalEnv &env) {
-        if (params.empty()) {
-            return std::make_shared<NilValue>();
-        }
-        ValuePtr result;
-        for (const auto& expr : params) {
-            result = env.eval(expr);
-        }
-        return result;
+    Closure _begin(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
+        return Compiler::compileBody(params, scope, tail);
     }
 
-    ValuePtr _let(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _let(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         if (params.size() < 2) throw LispError("let: expected at least 2 arguments.");
         if (!params[0]->isList()) throw LispError("let: Invalid expression.");
-        auto list = params[0]->toVector();
-        std::vector<std::string> letParams;
-        std::vector<ValuePtr> letValues;
-        for (const auto& bind : list) {
+        std::vector<Symbol> letParams;
+        std::vector<Closure> letValues;
+        for (const auto& bind : params[0]->toVector()) {
             if (!bind->is<PairValue>()) throw LispError("let: Invalid expression.");
-            auto bindPair = std::dynamic_pointer_cast<PairValue>(bind);
+            auto bindPair = valueCast<PairValue>(bind);
             if (auto symbol = bindPair->getCar()->asSymbol()) {
-                try {
-                    auto cdrVector = bindPair->getCdr()->toVector();
-                    if (cdrVector.size() != 1) throw LispError("let: Invalid expression.");
-                    auto value = env.eval(cdrVector[0]);
-                    letParams.push_back(*symbol);
-                    letValues.push_back(value);
-                } catch (const LispError& e) {
-                    throw LispError("let: Invalid expression.");
-                }
+                if (!bindPair->getCdr()->isList()) throw LispError("let: Invalid expression.");
+                auto cdrVector = bindPair->getCdr()->toVector();
+                if (cdrVector.size() != 1) throw LispError("let: Invalid expression.");
+                letParams.push_back(*symbol);
+                letValues.push_back(Compiler::compile(cdrVector[0], scope));
             } else throw LispError("let: Expected symbol in the binding list.");
         }
-        auto childEnv = env.createChild(letParams, letValues, env.shared_from_this());
+        auto [body, frame] = Compiler::compileFunction(letParams, std::vector(params.begin() + 1, params.end()), scope, tail);
 
-        ValuePtr result;
-        for (size_t i = 1; i < params.size(); i++) {
-            result = childEnv->eval(params[i]);
-        }
-        return result;
+        return [letValues = std::move(letValues), body = std::move(body), frame](EvalEnv& env) {
+            std::vector<ValuePtr> values;
+            values.reserve(frame.size);
+            for (const auto& value : letValues) {
+                values.push_back(value(env));
+            }
+            if (!frame.captured) {
+                EvalEnv::StackFrame childEnv(env, values, frame.size, env.shared_from_this());
+                return body(*childEnv);
+            }
+            auto childEnv = env.createChild(std::move(values), frame.size, env.shared_from_this());
+            return body(*childEnv);
+        };
     }
 
-    ValuePtr _lambda(const std::vector<ValuePtr> &params, EvalEnv &env) {
-        std::vector<std::string> lambdaParams;
+    Closure _lambda(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
+        if (params.empty()) throw LispError("lambda: expected at least 1 argument.");
+        std::vector<Symbol> lambdaParams;
         if (params[0]->is<SymbolValue>()) {
             lambdaParams.push_back(*params[0]->asSymbol());
         } else {
-            auto viewLambdaParams = params[0]->toVector()
-                                    | std::views::transform([](const ValuePtr& v) { return v->asSymbol(); })
-                                    | std::views::transform([](const std::optional<std::string>& s) {
-                if (!s) {
-                    throw LispError("lambda: Arguments must be symbols.");
-                }
-                return *s;
-            });
-            lambdaParams = {viewLambdaParams.begin(), viewLambdaParams.end()};
+            lambdaParams = lambdaParameters(params[0]);
         }
-        auto lambdaBody = std::vector(params.begin() + 1, params.end());
-        return std::make_shared<LambdaValue>(env.shared_from_this(), std::move(lambdaParams), std::move(lambdaBody));
+        if (scope) scope->capture();
+        std::vector body(params.begin() + 1, params.end());
+        auto program = Batch::compile(lambdaParams, body, scope);
+        auto [lambdaBody, frame] = Compiler::compileFunction(lambdaParams, body, scope);
+        return [lambdaParams = std::move(lambdaParams), lambdaBody = std::move(lambdaBody), frame, program = std::move(program)](EvalEnv& env) -> ValuePtr {
+            return std::make_shared<LambdaValue>(env.shared_from_this(), lambdaParams, lambdaBody, frame, program);
+        };
     }
 
-    ValuePtr _delay(const std::vector<ValuePtr> &params, EvalEnv &env) {
+    Closure _delay(const std::vector<ValuePtr> &params, const Compiler::ScopePtr& scope, bool tail) {
         Utils::checkParams("delay", 1, params);
-        return std::make_shared<LambdaValue>(env.shared_from_this(), std::vector<std::string>(), params);
+        if (scope) scope->capture();
+        auto [body, frame] = Compiler::compileFunction({}, params, scope);
+        return [body = std::move(body), frame](EvalEnv& env) -> ValuePtr {
+            return std::make_shared<LambdaValue>(env.shared_from_this(), std::vector<Symbol>(), body, frame);
+        };
     }
-}
\ No newline at end of file
+}
@@ -10,27 +10,32 @@
 #include "value.h"
 #include "eval_env.h"
 
-using SpecialFormType = std::function<ValuePtr(const std::vector<ValuePtr>&, EvalEnv&)>;
+#include "compiler.h"
+
+// A special form compiles its (unevaluated) operands into a closure once,
+// resolving variables against the enclosing lexical scope. `tail` tells
+// whether the form is in tail position, see Compiler::compile.
+using SpecialFormType = std::function<Closure(const std::vector<ValuePtr>&, const Compiler::ScopePtr&, bool)>;
 
 namespace SpecialForms {
-    extern const std::unordered_map<std::string, SpecialFormType> SPECIAL_FORMS;
+    extern const std::unordered_map<Symbol, SpecialFormType> SPECIAL_FORMS;
 
-    ValuePtr _define(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _quote(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _if(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _cond(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _let(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _begin(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _quasiquote(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _unquote(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _and(const std::vector<ValuePtr>& params, EvalEnv& env);
-    ValuePtr _or(const std::vector<ValuePtr>& params, EvalEnv& env);
+    Closure _define(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _quote(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _if(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _cond(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _let(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _begin(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _quasiquote(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _unquote(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _and(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
+    Closure _or(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
 
-    ValuePtr _lambda(const std::vector<ValuePtr>& params, EvalEnv& env);
+    Closure _lambda(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
 
-    ValuePtr _delay(const std::vector<ValuePtr>& params, EvalEnv& env);
+    Closure _delay(const std::vector<ValuePtr>& params, const Compiler::ScopePtr& scope, bool tail);
 
-    ValuePtr _quasiquote_impl(const ValuePtr& value, EvalEnv& env);
+    Closure _quasiquote_impl(const ValuePtr& value, const Compiler::ScopePtr& scope, size_t depth);
 }
 
 #endif //MINI_LISP_FORMS_H
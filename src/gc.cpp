@@ -0,0 +1,157 @@
+//
+// Created by timetraveler314 on 6/7/24.
+//
+
+#include "gc.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "value.h"
+
+namespace GC {
+    namespace {
+        Stats statistics;
+        size_t trackedAfterCollection = 0;
+
+        constexpr size_t MIN_THRESHOLD = 1024;
+
+        struct Node {
+            long useCount;
+            long references = 0;    // Found while tracing
+            bool marked = false;
+            Traceable* object = nullptr;
+            const Value* value = nullptr;
+        };
+
+        // Traces from a set of nodes, adding the nodes reached to `nodes`
+        class Walker final : public Tracer {
+            std::unordered_map<const void*, Node>& nodes;
+            std::vector<Node*> pending;
+            bool marking;
+
+            void reach(const void* key, Node node) {
+                auto [it, inserted] = nodes.try_emplace(key, node);
+                if (marking) {
+                    if (!it->second.marked) {
+                        it->second.marked = true;
+                        pending.push_back(&it->second);
+                    }
+                } else {
+                    it->second.references++;
+                    if (inserted) pending.push_back(&it->second);
+                }
+            }
+
+        protected:
+            void visit(const Traceable* object, long useCount) override {
+                reach(object, {useCount});
+            }
+
+            void visit(const Value* value, long useCount) override {
+                // A Traceable held as a value is the same node as in the registry
+                if (auto object = value->traceable()) reach(object, {useCount});
+                else reach(value, {.useCount = useCount, .value = value});
+            }
+
+        public:
+            Walker(std::unordered_map<const void*, Node>& nodes, bool marking): nodes{nodes}, marking{marking} {}
+
+            void push(Node& node) {
+                pending.push_back(&node);
+            }
+
+            void run() {
+                while (!pending.empty()) {
+                    auto node = pending.back();
+                    pending.pop_back();
+                    if (node->object) node->object->trace(*this);
+                    else node->value->trace(*this);
+                }
+            }
+        };
+    }
+
+    Traceable::Traceable() {
+        link();
+    }
+
+    Traceable::Traceable(const Traceable&) {
+        link();
+    }
+
+    void Traceable::link() {
+        prev = nullptr;
+        next = head;
+        if (head) head->prev = this;
+        head = this;
+        count++;
+    }
+
+    Traceable::~Traceable() {
+        if (prev) prev->next = next;
+        else head = next;
+        if (next) next->prev = prev;
+        count--;
+    }
+
+    size_t collect() {
+        auto start = std::chrono::steady_clock::now();
+
+        // Census: every object reachable from a Traceable, with the number of
+        // references to it from within that set
+        std::unordered_map<const void*, Node> nodes;
+        Walker census(nodes, false);
+        for (auto object = Traceable::head; object; object = object->next) {
+            auto owner = object->lock();
+            auto& node = nodes[object];
+            node.object = object;
+            node.useCount = owner ? owner.use_count() - 1 : 0;
+            census.push(node);
+        }
+        census.run();
+
+        // Objects referenced from elsewhere are roots; objects not owned by a
+        // shared_ptr are treated as roots too, their owner is unknown
+        Walker marker(nodes, true);
+        for (auto& [key, node] : nodes) {
+            if (node.useCount > node.references || (node.object && node.useCount == 0)) {
+                node.marked = true;
+                marker.push(node);
+            }
+        }
+        marker.run();
+
+        // Keep the garbage alive until every cycle is broken, then release it all at once
+        std::vector<std::shared_ptr<Traceable>> garbage;
+        for (auto& [key, node] : nodes) {
+            if (node.object && !node.marked) garbage.push_back(node.object->lock());
+        }
+        for (auto& object : garbage) object->clear();
+        auto freed = garbage.size();
+        auto traced = nodes.size();
+        nodes.clear();
+        garbage.clear();
+
+        auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        statistics.heapObjects = traced;
+        statistics.collections++;
+        statistics.freed += freed;
+        statistics.lastPause = pause;
+        statistics.totalPause += pause;
+        trackedAfterCollection = Traceable::tracked();
+        return freed;
+    }
+
+    void collectIfNeeded() {
+        if (Traceable::tracked() >= std::max(MIN_THRESHOLD, 2 * trackedAfterCollection)) {
+            collect();
+        }
+    }
+
+    const Stats& stats() {
+        statistics.tracked = Traceable::tracked();
+        return statistics;
+    }
+}
@@ -0,0 +1,104 @@
+//
+// Created by timetraveler314 on 6/7/24.
+//
+
+#ifndef MINI_LISP_GC_H
+#define MINI_LISP_GC_H
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+class Value;
+
+// Cycle collector. Values and environments are owned by shared_ptr, which
+// frees everything except reference cycles: a closure defined inside a
+// procedure holds its environment, which holds the closure, and a mutable
+// container may be stored into itself or into what it holds. The collector
+// traces the objects that can close such a cycle (environments, VM frames,
+// hash tables and vectors, the Traceables) together with everything they
+// reach, and breaks the cycles that nothing else refers to.
+//
+// Roots need no registration. An object whose use count exceeds the number
+// of references found while tracing is held from outside the traced heap (a
+// C++ handle, the evaluation stack, the global environment owned by main),
+// and everything reachable from it is live. Unreachable Traceables are
+// cleared, which drops the cycles and lets shared_ptr free them.
+//
+// Collection must only run where no environment is referenced by a raw
+// pointer alone, i.e. between top level forms.
+namespace GC {
+    class Traceable;
+
+    // Receives the strong references held by a traced object
+    class Tracer {
+    public:
+        virtual ~Tracer() = default;
+
+        template<class T>
+        void operator()(const std::shared_ptr<T>& ref) {
+            if (!ref) return;
+            if constexpr (std::is_base_of_v<Traceable, T>) {
+                visit(static_cast<const Traceable*>(ref.get()), ref.use_count());
+            } else {
+                visit(static_cast<const Value*>(ref.get()), ref.use_count());
+            }
+        }
+
+    protected:
+        virtual void visit(const Traceable* object, long useCount) = 0;
+        virtual void visit(const Value* value, long useCount) = 0;
+    };
+
+    // A container that may be part of a reference cycle. Every live instance
+    // is linked into a registry the collector starts from.
+    class Traceable {
+        static inline Traceable* head = nullptr;
+        static inline size_t count = 0;
+        Traceable* prev;
+        Traceable* next;
+
+        void link();
+
+    protected:
+        Traceable();
+        Traceable(const Traceable&);
+        Traceable& operator=(const Traceable&) {
+            return *this;
+        }
+        ~Traceable();
+
+    public:
+        // Null if the object is not owned by a shared_ptr
+        virtual std::shared_ptr<Traceable> lock() = 0;
+        virtual void trace(Tracer& tracer) const = 0;
+        // Drops every reference held, to break a garbage cycle
+        virtual void clear() = 0;
+
+        static size_t tracked() {
+            return count;
+        }
+
+        friend size_t collect();
+    };
+
+    struct Stats {
+        size_t tracked = 0;         // Live Traceables
+        size_t heapObjects = 0;     // Objects traced by the last collection
+        size_t collections = 0;
+        size_t freed = 0;           // Traceables cleared in all collections
+        std::chrono::nanoseconds lastPause {0};
+        std::chrono::nanoseconds totalPause {0};
+    };
+
+    // Collects unconditionally, returns the number of Traceables cleared
+    size_t collect();
+
+    // Collects when the number of Traceables has grown enough since the last collection
+    void collectIfNeeded();
+
+    const Stats& stats();
+}
+
+#endif //MINI_LISP_GC_H
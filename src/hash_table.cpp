@@ -0,0 +1,105 @@
+//
+// Created by timetraveler314 on 6/15/24.
+//
+
+#include "hash_table.h"
+
+#include <bit>
+
+size_t HashTableValue::hashKey(const ValuePtr& key) {
+    if (auto symbol = valueCast<SymbolValue>(key.get())) return std::hash<Symbol>()(symbol->getSymbol());
+    // Consistent with flonums of the same value, as equal? requires
+    if (auto fixnum = valueCast<FixnumValue>(key.get())) return std::hash<double>()(static_cast<double>(fixnum->getValue()));
+    return key->hash();
+}
+
+bool HashTableValue::equalKeys(const ValuePtr& x, const ValuePtr& y) {
+    if (x == y) return true;
+    if (auto symbol = valueCast<SymbolValue>(x.get())) {
+        // Symbols are interned
+        auto other = valueCast<SymbolValue>(y.get());
+        return other && symbol->getSymbol() == other->getSymbol();
+    }
+    if (x->is<FixnumValue>() && y->is<FixnumValue>()) {
+        return static_cast<const FixnumValue&>(*x).getValue() == static_cast<const FixnumValue&>(*y).getValue();
+    }
+    return x->isEqual(y);
+}
+
+HashTableValue::Slot& HashTableValue::probe(const ValuePtr& key, size_t hash) {
+    auto mask = slots.size() - 1;
+    Slot* removed = nullptr;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+        auto& slot = slots[i];
+        if (slot.state == State::EMPTY) return removed ? *removed : slot;
+        if (slot.state == State::REMOVED) {
+            if (!removed) removed = &slot;
+        } else if (slot.hash == hash && equalKeys(slot.key, key)) {
+            return slot;
+        }
+    }
+}
+
+void HashTableValue::rehash(size_t capacity) {
+    auto old = std::exchange(slots, std::vector<Slot>(capacity));
+    used = count;
+    auto mask = capacity - 1;
+    for (auto& slot : old) {
+        if (slot.state != State::FULL) continue;
+        auto i = slot.hash & mask;
+        while (slots[i].state != State::EMPTY) i = (i + 1) & mask;
+        slots[i] = std::move(slot);
+    }
+}
+
+const ValuePtr* HashTableValue::find(const ValuePtr& key) const {
+    if (count == 0) return nullptr;
+    auto& slot = const_cast<HashTableValue*>(this)->probe(key, hashKey(key));
+    return slot.state == State::FULL ? &slot.value : nullptr;
+}
+
+void HashTableValue::set(const ValuePtr& key, ValuePtr value) {
+    // Keep at most 3/4 of the slots in use, growing unless tombstones take the room
+    if ((used + 1) * 4 > slots.size() * 3) {
+        rehash(std::max(MIN_CAPACITY, std::bit_ceil((count + 1) * 2)));
+    }
+    auto hash = hashKey(key);
+    auto& slot = probe(key, hash);
+    if (slot.state != State::FULL) {
+        if (slot.state == State::EMPTY) used++;
+        count++;
+        slot = {Value::promote(key), nullptr, hash, State::FULL};
+    }
+    slot.value = Value::promote(std::move(value));
+}
+
+bool HashTableValue::remove(const ValuePtr& key) {
+    if (count == 0) return false;
+    auto& slot = probe(key, hashKey(key));
+    if (slot.state != State::FULL) return false;
+    slot = {nullptr, nullptr, 0, State::REMOVED};
+    count--;
+    return true;
+}
+
+std::vector<ValuePtr> HashTableValue::keys() const {
+    std::vector<ValuePtr> result;
+    result.reserve(count);
+    for (auto& slot : slots) {
+        if (slot.state == State::FULL) result.push_back(slot.key);
+    }
+    return result;
+}
+
+void HashTableValue::trace(GC::Tracer& tracer) const {
+    for (auto& slot : slots) {
+        tracer(slot.key);
+        tracer(slot.value);
+    }
+}
+
+void HashTableValue::clear() {
+    slots.clear();
+    count = 0;
+    used = 0;
+}
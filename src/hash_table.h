@@ -0,0 +1,80 @@
+//
+// Created by timetraveler314 on 6/15/24.
+//
+
+#ifndef MINI_LISP_HASH_TABLE_H
+#define MINI_LISP_HASH_TABLE_H
+
+#include <vector>
+
+#include "value.h"
+
+// A mutable table from keys to values, keys compared by equal? (see
+// Value::isEqual and Value::hash). Open addressing with linear probing over
+// a power-of-two number of slots; removed entries leave tombstones, which are
+// dropped when the table is rebuilt.
+class HashTableValue final : public Value, public std::enable_shared_from_this<HashTableValue>, public GC::Traceable {
+    enum class State : uint8_t {
+        EMPTY,
+        FULL,
+        REMOVED,
+    };
+
+    struct Slot {
+        ValuePtr key;
+        ValuePtr value;
+        size_t hash = 0;
+        State state = State::EMPTY;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    // Full and removed slots, bounded by the load factor so probes always end
+    size_t used = 0;
+
+    // The slot holding `key`, or the one to insert it into
+    Slot& probe(const ValuePtr& key, size_t hash);
+    void rehash(size_t capacity);
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::HASH_TABLE_VALUE);
+    static constexpr size_t MIN_CAPACITY = 8;
+
+    HashTableValue(): Value(ValueType::HASH_TABLE_VALUE) {}
+
+    // Symbols and immediate numbers skip the virtual calls
+    static size_t hashKey(const ValuePtr& key);
+    static bool equalKeys(const ValuePtr& x, const ValuePtr& y);
+
+    const ValuePtr* find(const ValuePtr& key) const;
+    void set(const ValuePtr& key, ValuePtr value);
+    bool remove(const ValuePtr& key);
+
+    size_t size() const {
+        return count;
+    }
+
+    std::vector<ValuePtr> keys() const;
+
+    std::string toString() const override {
+        return "#<hash-table>";
+    }
+
+    bool isEqual(const ValuePtr& other) const override {
+        return this == other.get();
+    }
+
+    void trace(GC::Tracer& tracer) const override;
+
+    const GC::Traceable* traceable() const override {
+        return this;
+    }
+
+    std::shared_ptr<GC::Traceable> lock() override {
+        return weak_from_this().lock();
+    }
+
+    void clear() override;
+};
+
+#endif //MINI_LISP_HASH_TABLE_H
@@ -0,0 +1,173 @@
+//
+// Created by timetraveler314 on 6/13/24.
+//
+
+#include "inlining.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <unordered_map>
+
+#include "eval_env.h"
+#include "forms.h"
+
+namespace Inlining {
+    namespace {
+        std::unordered_map<Symbol, DefinitionPtr> definitions;
+
+        // Definitions being expanded while compiling, innermost last
+        std::vector<const Definition*> expanding;
+        constexpr size_t MAX_DEPTH = 4;
+
+        bool isLocal(Symbol name, const Compiler::ScopePtr& scope) {
+            for (auto current = scope.get(); current; current = current->parent.get()) {
+                if (current->find(name)) return true;
+            }
+            return false;
+        }
+
+        // The special forms a body may use: none of them binds names
+        bool isTransparent(Symbol form) {
+            return form == Symbol::QUOTE || form == Symbol::IF || form == Symbol::COND || form == Symbol::AND
+                || form == Symbol::OR || form == Symbol::BEGIN;
+        }
+
+        // Counts the forms of `expr` into `size` and collects the symbols it refers to
+        bool scan(const ValuePtr& expr, size_t& size, std::vector<Symbol>& symbols) {
+            if (++size > Definition::MAX_SIZE) return false;
+            if (auto symbol = expr->asSymbol()) {
+                symbols.push_back(*symbol);
+                return true;
+            }
+            auto pair = valueCast<PairValue>(expr);
+            if (!pair) return true;
+            if (!pair->isList()) return false;
+            if (auto head = pair->getCar()->asSymbol(); head && SpecialForms::SPECIAL_FORMS.contains(*head)) {
+                if (!isTransparent(*head)) return false;
+                if (*head == Symbol::QUOTE) return true;
+            }
+            return std::ranges::all_of(pair->toVector(), [&](const ValuePtr& item) {
+                return scan(item, size, symbols);
+            });
+        }
+
+        // `expr` with the symbols in `from` replaced by those in `to`, quoted data left alone
+        ValuePtr rename(const ValuePtr& expr, const std::vector<Symbol>& from, const std::vector<Symbol>& to) {
+            if (auto symbol = expr->asSymbol()) {
+                auto it = std::ranges::find(from, *symbol);
+                return it == from.end() ? expr : std::make_shared<SymbolValue>(to[it - from.begin()]);
+            }
+            auto pair = valueCast<PairValue>(expr);
+            if (!pair || pair->getCar()->asSymbol() == Symbol::QUOTE) return expr;
+            std::vector<ValuePtr> items;
+            for (const auto& item : pair->toVector()) {
+                items.push_back(rename(item, from, to));
+            }
+            return Value::fromVector(items);
+        }
+
+        // The hidden slot names for parameter `index` at expansion depth `depth`.
+        // The reader cannot produce names with spaces, so they never clash with
+        // the caller's.
+        Symbol hiddenName(size_t depth, size_t index) {
+            return Symbol(" inline " + std::to_string(depth) + " " + std::to_string(index));
+        }
+    }
+
+    DefinitionPtr define(Symbol name, const std::vector<Symbol>& params, const std::vector<ValuePtr>& body) {
+        definitions.erase(name);
+        if (body.empty() || params.size() > Definition::MAX_PARAMS) return nullptr;
+        size_t size = 0;
+        std::vector<Symbol> symbols;
+        for (const auto& expr : body) {
+            if (!scan(expr, size, symbols)) return nullptr;
+        }
+        if (std::ranges::find(symbols, name) != symbols.end()) return nullptr; // Recursive
+        for (size_t i = 0; i < params.size(); i++) {
+            if (std::ranges::find(params.begin() + i + 1, params.end(), params[i]) != params.end()) return nullptr;
+        }
+        auto definition = std::make_shared<const Definition>(name, params, body);
+        definitions.emplace(name, definition);
+        return definition;
+    }
+
+    std::optional<Closure> expand(const std::shared_ptr<PairValue>& pair, const Compiler::ScopePtr& scope, bool tail, Closure call) {
+        // Calls from the global frame have no frame to expand into, and run once anyway
+        if (!scope) return std::nullopt;
+        auto name = pair->getCar()->asSymbol();
+        if (!name || isLocal(*name, scope)) return std::nullopt;
+        auto it = definitions.find(*name);
+        if (it == definitions.end()) return std::nullopt;
+        auto definition = it->second;
+        auto operands = pair->getCdr()->toVector();
+        if (operands.size() != definition->params.size() || expanding.size() >= MAX_DEPTH
+            || std::ranges::find(expanding, definition.get()) != expanding.end()) {
+            return std::nullopt;
+        }
+        // Free variables of the body are globals, which the caller must not shadow
+        size_t size = 0;
+        std::vector<Symbol> symbols;
+        for (const auto& expr : definition->body) scan(expr, size, symbols);
+        for (auto symbol : symbols) {
+            if (std::ranges::find(definition->params, symbol) == definition->params.end() && isLocal(symbol, scope)) {
+                return std::nullopt;
+            }
+        }
+
+        std::vector<Closure> args;
+        for (const auto& operand : operands) {
+            args.push_back(Compiler::compile(operand, scope));
+        }
+        // Arguments may expand calls themselves, at the same depth: they are
+        // all evaluated before the slots are written, and the body's own
+        // expansions use the slots one level deeper
+        std::vector<Symbol> hidden;
+        std::vector<size_t> slots;
+        for (size_t i = 0; i < definition->params.size(); i++) {
+            hidden.push_back(hiddenName(expanding.size(), i));
+            slots.push_back(scope->declare(hidden.back()));
+        }
+        std::vector<ValuePtr> body;
+        for (const auto& expr : definition->body) {
+            body.push_back(rename(expr, definition->params, hidden));
+        }
+        expanding.push_back(definition.get());
+        Closure code;
+        try {
+            code = Compiler::compileBody(body, scope, tail);
+        } catch (...) {
+            expanding.pop_back();
+            throw;
+        }
+        expanding.pop_back();
+
+        return [definition, name = *name, args = std::move(args), slots = std::move(slots), code = std::move(code), call = std::move(call),
+                global = static_cast<const EvalEnv*>(nullptr), epoch = uint64_t{0}, binding = static_cast<const ValuePtr*>(nullptr)](EvalEnv& env) mutable {
+            auto& globalEnv = env.global();
+            if (global != &globalEnv || epoch != EvalEnv::bindingsEpoch()) {
+                global = &globalEnv;
+                epoch = EvalEnv::bindingsEpoch();
+                binding = globalEnv.lookupSlot(name);
+            }
+            auto lambda = binding ? valueCast<LambdaValue>(binding->get()) : nullptr;
+            if (!lambda || !lambda->isInstanceOf(definition.get(), globalEnv)) {
+                return call(env);
+            }
+            std::array<ValuePtr, Definition::MAX_PARAMS> values;
+            for (size_t i = 0; i < args.size(); i++) {
+                values[i] = args[i](env);
+            }
+            for (size_t i = 0; i < args.size(); i++) {
+                env.local(0, slots[i]) = std::move(values[i]);
+            }
+            auto result = code(env);
+            // Release the arguments as a real call would. A pending tail call
+            // holds its own arguments already.
+            for (size_t i = 0; i < args.size(); i++) {
+                env.local(0, slots[i]) = nullptr;
+            }
+            return result;
+        };
+    }
+}
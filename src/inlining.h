@@ -0,0 +1,45 @@
+//
+// Created by timetraveler314 on 6/13/24.
+//
+
+#ifndef MINI_LISP_INLINING_H
+#define MINI_LISP_INLINING_H
+
+#include <optional>
+#include <vector>
+
+#include "compiler.h"
+
+// Inline expansion of small procedures defined at the top level. A call of such
+// a procedure from a compiled body evaluates the arguments into hidden slots of
+// the caller's frame and runs the callee's body there, with the parameters
+// renamed to those slots, instead of creating a frame for the call.
+//
+// Expanded code assumes the global name still holds the procedure of that very
+// definition, so it checks the binding each time and makes the call as usual
+// once the name is redefined.
+namespace Inlining {
+    // A definition whose body may be expanded: it has no nested binding forms,
+    // does not mention its own name and is no bigger than MAX_SIZE forms
+    struct Definition {
+        static constexpr size_t MAX_SIZE = 32;
+        static constexpr size_t MAX_PARAMS = 8;
+
+        Symbol name;
+        std::vector<Symbol> params;
+        std::vector<ValuePtr> body;
+    };
+
+    using DefinitionPtr = std::shared_ptr<const Definition>;
+
+    // Records `(define (name params...) body...)` in the global frame as the
+    // definition of `name` call sites compiled from now on expand. Null if the
+    // body cannot be expanded.
+    DefinitionPtr define(Symbol name, const std::vector<Symbol>& params, const std::vector<ValuePtr>& body);
+
+    // Code for the call `pair` expanding the callee's body in `scope`, if the
+    // callee has a definition to expand. `call` makes the call as usual.
+    std::optional<Closure> expand(const std::shared_ptr<PairValue>& pair, const Compiler::ScopePtr& scope, bool tail, Closure call);
+}
+
+#endif //MINI_LISP_INLINING_H
@@ -6,6 +6,7 @@
 #include "modes/repl.h"
 #include "utils/nullstream.h"
 #include "eval_env.h"
+#include "vm/vm.h"
 
 int main(int argc, char* argv[]) {
     cxxopts::Options options("MiniLisp", "A simple lisp interpreter of the course"
@@ -14,12 +15,16 @@ int main(int argc, char* argv[]) {
             ("i,input", "Input file", cxxopts::value<std::string>())
             ("s,save", "Save file", cxxopts::value<std::string>())
             ("r,repl", "Start repl mode (after file mode)")
+            ("e,engine", "Execution engine: tree or vm", cxxopts::value<std::string>()->default_value("tree"))
+            ("stack-limit", "Memory for the vm call stack, in MiB", cxxopts::value<size_t>()->default_value(std::to_string(VM::DEFAULT_STACK_LIMIT >> 20)))
             ;
 
     try {
         auto result = options.parse(argc, argv);
 
         std::shared_ptr<EvalEnv> env = EvalEnv::createGlobal();
+        env->setEngine(parseEngine(result["engine"].as<std::string>()));
+        VM::setStackLimit(result["stack-limit"].as<size_t>() << 20);
         std::shared_ptr<std::ofstream> save = std::make_shared<NullFileStream>();
 
         if (result.count("save")) {
@@ -0,0 +1,270 @@
+//
+// Created by timetraveler314 on 6/14/24.
+//
+
+#include "memo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+#include "error.h"
+#include "eval_env.h"
+#include "f64vector.h"
+#include "hash_table.h"
+#include "ndarray.h"
+#include "number.h"
+#include "parser.h"
+
+namespace {
+    // The pairs of vectors being compared further up, see VectorValue::isEqual
+    using Comparing = std::vector<std::pair<const Value*, const Value*>>;
+
+    // Like isEqual, except that numbers of different types never match
+    bool same(const ValuePtr& x, const ValuePtr& y, Comparing& comparing) {
+        if (x->getType() != y->getType()) return false;
+        if (x->isNumber()) return Number::compare(*x, *y) == 0;
+        if (auto pair = valueCast<PairValue>(x.get())) {
+            auto other = static_cast<const PairValue*>(y.get());
+            return same(pair->getCar(), other->getCar(), comparing) && same(pair->getCdr(), other->getCdr(), comparing);
+        }
+        if (auto vector = valueCast<VectorValue>(x.get())) {
+            std::pair<const Value*, const Value*> operands{x.get(), y.get()};
+            if (std::ranges::find(comparing, operands) != comparing.end()) return true;
+            comparing.push_back(operands);
+            bool result = std::ranges::equal(vector->getElements(), static_cast<const VectorValue&>(*y).getElements(),
+                                             [&](const ValuePtr& a, const ValuePtr& b) { return same(a, b, comparing); });
+            comparing.pop_back();
+            return result;
+        }
+        return x->isEqual(y);
+    }
+
+    bool same(const ValuePtr& x, const ValuePtr& y) {
+        Comparing comparing;
+        return same(x, y, comparing);
+    }
+
+    // The copies made of the vectors and hash tables met so far, so that one
+    // met again inside itself refers to its own copy
+    using Copies = std::unordered_map<const Value*, ValuePtr>;
+
+    // A copy of `value` that later mutation of the value cannot reach. The
+    // entries are hashed by their arguments' content, so a cached argument must
+    // never change; and a cached result is handed out on every hit, so a caller
+    // mutating it must not change what the next caller gets. Hash tables match
+    // only themselves as arguments, so they are copied in results alone.
+    ValuePtr freeze(const ValuePtr& value, Copies& copies, bool copyTables) {
+        if (auto vector = valueCast<VectorValue>(value.get())) {
+            if (auto copy = copies.find(vector); copy != copies.end()) return copy->second;
+            auto copy = std::make_shared<VectorValue>(std::vector<ValuePtr>(vector->size(), Value::nil()));
+            copies.emplace(vector, copy);
+            for (size_t i = 0; i < vector->size(); i++) copy->set(i, freeze((*vector)[i], copies, copyTables));
+            return copy;
+        }
+        if (auto table = valueCast<HashTableValue>(value.get()); table && copyTables) {
+            if (auto copy = copies.find(table); copy != copies.end()) return copy->second;
+            auto copy = std::make_shared<HashTableValue>();
+            copies.emplace(table, copy);
+            for (auto& key : table->keys()) {
+                copy->set(freeze(key, copies, copyTables), freeze(*table->find(key), copies, copyTables));
+            }
+            return copy;
+        }
+        if (auto vector = valueCast<F64VectorValue>(value.get())) {
+            return std::make_shared<F64VectorValue>(std::vector<double>(vector->data(), vector->data() + vector->size()));
+        }
+        if (auto array = valueCast<NDArrayValue>(value.get())) {
+            return array->copy();
+        }
+        if (auto pair = valueCast<PairValue>(value.get())) {
+            // Pairs themselves are immutable, only their elements need copying
+            std::vector<ValuePtr> cars;
+            const Value* current = pair;
+            ValuePtr tail = value;
+            bool copied = false;
+            while (auto next = valueCast<PairValue>(current)) {
+                cars.push_back(freeze(next->getCar(), copies, copyTables));
+                copied = copied || cars.back() != next->getCar();
+                tail = next->getCdr();
+                current = tail.get();
+            }
+            ValuePtr result = freeze(tail, copies, copyTables);
+            if (!copied && result == tail) return value;
+            for (auto car = cars.rbegin(); car != cars.rend(); ++car) result = PairValue::create(*car, result);
+            return result;
+        }
+        return Value::promote(value);
+    }
+
+    ValuePtr freeze(const ValuePtr& value, bool copyTables = false) {
+        Copies copies;
+        return freeze(value, copies, copyTables);
+    }
+
+    bool isDelimiter(char c) {
+        return std::isspace(static_cast<unsigned char>(c)) || std::string_view("()'`,\";").find(c) != std::string_view::npos;
+    }
+
+    // Writes `value` so that the parser reads it back as the same datum. Fails
+    // on values without such a representation, among them vectors containing
+    // themselves: `writing` holds the vectors being written further up.
+    bool write(std::string& out, const Value& value, std::vector<const Value*>& writing) {
+        if (auto boolean = valueCast<BooleanValue>(&value)) {
+            out += boolean->getValue() ? "#t" : "#f";
+        } else if (value.is<FixnumValue>() || value.is<BignumValue>() || value.is<NilValue>()) {
+            out += value.toString();
+        } else if (auto flonum = valueCast<NumericValue>(&value)) {
+            if (!std::isfinite(flonum->getValue())) return false;
+            auto text = std::format("{}", flonum->getValue());
+            // Integral flonums need a point to stay inexact
+            if (text.find_first_of(".e") == std::string::npos) text += ".0";
+            out += text;
+        } else if (auto string = valueCast<StringValue>(&value)) {
+            out += '"';
+            for (char c : string->getValue()) {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c == '\n' ? std::string("\\n") : std::string(1, c);
+            }
+            out += '"';
+        } else if (auto symbol = valueCast<SymbolValue>(&value)) {
+            auto name = symbol->toString();
+            // Names that could read as something else
+            bool numeric = std::isdigit(name[0]) || (name.size() > 1 && std::string_view("+-.").find(name[0]) != std::string_view::npos);
+            if (numeric || name == "." || std::ranges::any_of(name, isDelimiter)) return false;
+            out += name;
+        } else if (auto pair = valueCast<PairValue>(&value)) {
+            out += '(';
+            const Value* current = pair;
+            while (auto next = valueCast<PairValue>(current)) {
+                if (next != pair) out += ' ';
+                if (!write(out, *next->getCar(), writing)) return false;
+                current = next->getCdr().get();
+            }
+            if (!current->is<NilValue>()) {
+                out += " . ";
+                if (!write(out, *current, writing)) return false;
+            }
+            out += ')';
+        } else if (auto vector = valueCast<VectorValue>(&value)) {
+            if (std::ranges::find(writing, vector) != writing.end()) return false;
+            writing.push_back(vector);
+            out += "#(";
+            for (size_t i = 0; i < vector->size(); i++) {
+                if (i > 0) out += ' ';
+                if (!write(out, *(*vector)[i], writing)) return false;
+            }
+            out += ')';
+            writing.pop_back();
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool write(std::string& out, const Value& value) {
+        std::vector<const Value*> writing;
+        return write(out, value, writing);
+    }
+
+    std::optional<ValuePtr> read(const std::string& line) {
+        try {
+            Tokenizer tokenizer;
+            Parser parser(tokenizer);
+            auto valueTask = parser.parse();
+            tokenizer.feed(line);
+            return valueTask.get_result();
+        } catch (SyntaxError&) {
+            return std::nullopt;
+        } catch (LispError&) {
+            return std::nullopt;
+        }
+    }
+}
+
+size_t MemoProcValue::ArgsHash::operator()(Arguments args) const {
+    size_t result = args.size();
+    for (auto& arg : args) result = result * 31 + arg->hash();
+    return result;
+}
+
+bool MemoProcValue::ArgsEqual::operator()(Arguments x, Arguments y) const {
+    return std::ranges::equal(x, y, [](const ValuePtr& a, const ValuePtr& b) { return same(a, b); });
+}
+
+MemoProcValue::MemoProcValue(ValuePtr proc, size_t capacity, const std::optional<std::string>& path):
+    ProcedureValue(ValueType::MEMO_PROC_VALUE), proc{std::move(proc)}, capacity{capacity} {
+    if (path) load(*path);
+}
+
+void MemoProcValue::insert(Arguments args, ValuePtr result) {
+    if (auto cached = index.find(args); cached != index.end()) {
+        // Cached meanwhile, by a call with the same arguments from within `proc`
+        cached->second->result = freeze(result, true);
+        entries.splice(entries.begin(), entries, cached->second);
+        return;
+    }
+    std::vector<ValuePtr> stored;
+    stored.reserve(args.size());
+    for (auto& arg : args) stored.push_back(freeze(arg));
+    entries.push_front({std::move(stored), freeze(result, true)});
+    index.emplace(Arguments(entries.front().args), entries.begin());
+    if (entries.size() > capacity) {
+        index.erase(Arguments(entries.back().args));
+        entries.pop_back();
+    }
+}
+
+void MemoProcValue::load(const std::string& path) {
+    size_t lines = 0;
+    if (std::ifstream in(path); in) {
+        std::string line;
+        while (std::getline(in, line)) {
+            lines++;
+            // (result arg ...)
+            auto datum = read(line);
+            if (!datum || !(*datum)->isNonEmptyList()) continue;
+            auto values = (*datum)->toVector();
+            insert(Arguments(values).subspan(1), Value::promote(values[0]));
+        }
+    }
+    if (lines > entries.size()) {
+        // Drop what was evicted or unreadable, the least recently used first
+        std::ofstream out(path, std::ios::trunc);
+        for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry) {
+            std::string line;
+            std::vector<ValuePtr> values{entry->result};
+            values.insert(values.end(), entry->args.begin(), entry->args.end());
+            if (write(line, *Value::fromVector(values))) out << line << '\n';
+        }
+    }
+    file.emplace(path, std::ios::app);
+    if (!*file) throw LispError("Cannot open memo file: " + path);
+}
+
+ValuePtr MemoProcValue::apply(Arguments args, EvalEnv& env) {
+    if (auto cached = index.find(args); cached != index.end()) {
+        entries.splice(entries.begin(), entries, cached->second);
+        return freeze(cached->second->result, true);
+    }
+    auto result = Value::promote(env.apply(proc, args));
+    insert(args, result);
+    if (file) {
+        std::string line = "(";
+        bool written = write(line, *result);
+        for (auto& arg : args) {
+            line += ' ';
+            written = written && write(line, *arg);
+        }
+        if (written) *file << line << ")" << std::endl;
+    }
+    return result;
+}
+
+void MemoProcValue::trace(GC::Tracer& tracer) const {
+    tracer(proc);
+    for (auto& entry : entries) {
+        for (auto& arg : entry.args) tracer(arg);
+        tracer(entry.result);
+    }
+}
@@ -0,0 +1,75 @@
+//
+// Created by timetraveler314 on 6/14/24.
+//
+
+#ifndef MINI_LISP_MEMO_H
+#define MINI_LISP_MEMO_H
+
+#include <fstream>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "value.h"
+
+// A procedure with its results cached by argument, made by (memoize f). A call
+// whose arguments are equal to those of a cached call returns the cached result
+// without calling `f`, so `f` should be pure. Arguments match when they are
+// equal? and of the same number types, so that exactness is kept. Mutable
+// arguments and results are copied into the cache, and each hit returns a fresh
+// copy of the cached result.
+//
+// The cache keeps the `capacity` most recently used results. Given a file, it
+// also appends each new result there and starts out with the results already
+// in it, so they survive the process. Only results whose arguments and value
+// can be written as data are saved (numbers, strings, symbols, booleans and
+// lists and vectors of those); the file should belong to one procedure.
+class MemoProcValue final : public ProcedureValue {
+    struct Entry {
+        std::vector<ValuePtr> args;
+        ValuePtr result;
+    };
+
+    struct ArgsHash {
+        size_t operator()(Arguments args) const;
+    };
+
+    struct ArgsEqual {
+        bool operator()(Arguments x, Arguments y) const;
+    };
+
+    ValuePtr proc;
+    size_t capacity;
+    // Most recently used first. The index refers to the arguments stored in the entries.
+    std::list<Entry> entries;
+    std::unordered_map<Arguments, std::list<Entry>::iterator, ArgsHash, ArgsEqual> index;
+    std::optional<std::ofstream> file;
+
+    void insert(Arguments args, ValuePtr result);
+    void load(const std::string& path);
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::MEMO_PROC_VALUE);
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+    MemoProcValue(ValuePtr proc, size_t capacity, const std::optional<std::string>& path = std::nullopt);
+
+    ValuePtr apply(Arguments args, EvalEnv& env) override;
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    std::string toString() const override {
+        return "#<procedure>";
+    }
+
+    bool isEqual(const ValuePtr& other) const override {
+        return this == other.get();
+    }
+
+    void trace(GC::Tracer& tracer) const override;
+};
+
+#endif //MINI_LISP_MEMO_H
@@ -8,6 +8,8 @@
 #include "../tokenizer.h"
 #include "../parser.h"
 #include "../version.h"
+#include "../gc.h"
+#include "../arena.h"
 
 void getInput(std::istream &in, std::ostream &out, std::string &program, std::string &line) {
     std::getline(in, line);
@@ -15,6 +17,12 @@ void getInput(std::istream &in, std::ostream &out, std::string &program, std::st
     program += line;
 }
 
+Engine parseEngine(const std::string& name) {
+    if (name == "tree") return Engine::TREE;
+    if (name == "vm") return Engine::VM;
+    throw std::runtime_error("Unknown engine: " + name + " (expected tree or vm)");
+}
+
 void startRepl(std::istream& in, std::ostream& out, const std::shared_ptr<std::ostream>& save, const std::shared_ptr<EvalEnv>& env, bool interactive) {
     // Show banner
     out << "MINI-LISP : Minilisp Is Not Implemented Like In Standard Practice" << std::endl;
@@ -51,7 +59,9 @@ void startRepl(std::istream& in, std::ostream& out, const std::shared_ptr<std::o
                         << "  exit: Exit the REPL\n"
                         << "  help: Show this help message\n"
                         << "  clear: Clear the screen\n"
-                        << "  reset: Reset the environment\n";
+                        << "  reset: Reset the environment\n"
+                        << "  engine tree|vm: Switch the execution engine\n"
+                        << "  gc: Collect garbage and show heap statistics\n";
                     continue;
                 }
                 if (line == "clear") {
@@ -63,6 +73,20 @@ void startRepl(std::istream& in, std::ostream& out, const std::shared_ptr<std::o
                     out << "Environment reset.\n";
                     continue;
                 }
+                if (line.starts_with("engine ")) {
+                    env->setEngine(parseEngine(line.substr(7, line.size() - 8)));
+                    out << "Engine switched.\n";
+                    continue;
+                }
+                if (line == "gc\n") {
+                    auto freed = GC::collect();
+                    const auto& stats = GC::stats();
+                    out << std::format("Freed {} objects in {} us. Heap: {} tracked objects, {} objects traced. "
+                                       "{} collections, {} us in total.\n",
+                                       freed, stats.lastPause.count() / 1000, stats.tracked, stats.heapObjects,
+                                       stats.collections, stats.totalPause.count() / 1000);
+                    continue;
+                }
                 if (line == "save") {
                     std::cout << "Saving to file...\n";
                     while (!buffer.empty()) {
@@ -84,8 +108,10 @@ void startRepl(std::istream& in, std::ostream& out, const std::shared_ptr<std::o
                 }
                 tokenizer.feed(line);
             }
+            Arena::instance().beginRegion(); // Temporaries of this form are recycled together
             auto result = env->eval(std::move(valueTask.get_result().value()));
             out << result->toString() << std::endl;
+            GC::collectIfNeeded(); // Between forms nothing but shared_ptr refers to environments
 
             lineCount = tokenizer.getLineCount();
 
@@ -0,0 +1,152 @@
+//
+// Created by timetraveler314 on 6/17/24.
+//
+
+#include "ndarray.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "simd.h"
+
+namespace {
+    // The product is computed a panel of y at a time, BLOCK_DEPTH rows by
+    // BLOCK_COLS columns, against BLOCK_ROWS rows of x, so that both stay in
+    // cache while they are reused. Threads take whole blocks of rows.
+    constexpr size_t BLOCK_ROWS = 64;
+    constexpr size_t BLOCK_DEPTH = 128;
+    constexpr size_t BLOCK_COLS = 256;
+
+    // Row i of `array`, gathered into `buffer` if its elements are apart
+    const double* rowOf(const NDArrayValue& array, size_t i, std::vector<double>& buffer) {
+        if (array.hasContiguousRows()) return array.row(i);
+        buffer.resize(array.cols());
+        for (size_t j = 0; j < array.cols(); j++) buffer[j] = array(i, j);
+        return buffer.data();
+    }
+
+    // `array` if its rows are contiguous, else a copy in `storage`
+    const NDArrayValue& withContiguousRows(const NDArrayValue& array, std::shared_ptr<NDArrayValue>& storage) {
+        if (array.hasContiguousRows()) return array;
+        storage = array.copy();
+        return *storage;
+    }
+
+    // Rows [rowStart, rowEnd) of out += x * y
+    void multiplyRows(const NDArrayValue& x, const NDArrayValue& y, NDArrayValue& out, size_t rowStart, size_t rowEnd) {
+        size_t depth = x.cols(), width = y.cols();
+        for (size_t colStart = 0; colStart < width; colStart += BLOCK_COLS) {
+            size_t cols = std::min(BLOCK_COLS, width - colStart);
+            for (size_t depthStart = 0; depthStart < depth; depthStart += BLOCK_DEPTH) {
+                size_t depthEnd = std::min(depthStart + BLOCK_DEPTH, depth);
+                for (size_t blockStart = rowStart; blockStart < rowEnd; blockStart += BLOCK_ROWS) {
+                    size_t blockEnd = std::min(blockStart + BLOCK_ROWS, rowEnd);
+                    for (size_t i = blockStart; i < blockEnd; i++) {
+                        const double* xRow = x.row(i);
+                        double* outRow = out.row(i) + colStart;
+                        for (size_t p = depthStart; p < depthEnd; p++) {
+                            Simd::axpy(xRow[p], y.row(p) + colStart, outRow, cols);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+NDArrayValue::NDArrayValue(size_t rows, size_t cols, double fill):
+    NDArrayValue(std::make_shared<std::vector<double>>(rows * cols, fill), 0, {rows, cols}, {cols, 1}) {}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::transpose() const {
+    return std::make_shared<NDArrayValue>(storage, offset, Shape{shape[1], shape[0]}, Shape{strides[1], strides[0]});
+}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::slice(size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd) const {
+    return std::make_shared<NDArrayValue>(storage, offset + rowStart * strides[0] + colStart * strides[1],
+                                          Shape{rowEnd - rowStart, colEnd - colStart}, strides);
+}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::copy() const {
+    auto result = std::make_shared<NDArrayValue>(rows(), cols());
+    std::vector<double> buffer;
+    for (size_t i = 0; i < rows(); i++) {
+        std::copy_n(rowOf(*this, i, buffer), cols(), result->row(i));
+    }
+    return result;
+}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::elementwise(const NDArrayValue& x, const NDArrayValue& y, Kernel kernel) {
+    auto result = std::make_shared<NDArrayValue>(x.rows(), x.cols());
+    std::vector<double> xBuffer, yBuffer;
+    for (size_t i = 0; i < x.rows(); i++) {
+        kernel(rowOf(x, i, xBuffer), rowOf(y, i, yBuffer), result->row(i), x.cols());
+    }
+    return result;
+}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::scale(double a, const NDArrayValue& x) {
+    auto result = std::make_shared<NDArrayValue>(x.rows(), x.cols());
+    std::vector<double> buffer;
+    for (size_t i = 0; i < x.rows(); i++) {
+        Simd::scale(a, rowOf(x, i, buffer), result->row(i), x.cols());
+    }
+    return result;
+}
+
+std::shared_ptr<NDArrayValue> NDArrayValue::matmul(const NDArrayValue& x, const NDArrayValue& y) {
+    // The kernel runs along rows, so strided operands are copied first
+    std::shared_ptr<NDArrayValue> xCopy, yCopy;
+    const auto& a = withContiguousRows(x, xCopy);
+    const auto& b = withContiguousRows(y, yCopy);
+    auto result = std::make_shared<NDArrayValue>(a.rows(), b.cols());
+
+    size_t blocks = (a.rows() + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    size_t threads = 1;
+    if (a.rows() * a.cols() * b.cols() >= PARALLEL_THRESHOLD) {
+        threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, std::max<size_t>(blocks, 1));
+    }
+    size_t rowsPerThread = (blocks + threads - 1) / threads * BLOCK_ROWS;
+    {
+        // Each thread writes its own rows of the result; the threads are joined on leaving the scope
+        std::vector<std::jthread> workers;
+        for (size_t t = 1; t < threads; t++) {
+            size_t start = std::min(t * rowsPerThread, a.rows()), end = std::min(start + rowsPerThread, a.rows());
+            workers.emplace_back([&a, &b, &result, start, end] { multiplyRows(a, b, *result, start, end); });
+        }
+        multiplyRows(a, b, *result, 0, std::min(rowsPerThread, a.rows()));
+    }
+    return result;
+}
+
+std::string NDArrayValue::toString() const {
+    std::string result = "#2a(";
+    for (size_t i = 0; i < rows(); i++) {
+        if (i > 0) result += ' ';
+        result += '(';
+        for (size_t j = 0; j < cols(); j++) {
+            if (j > 0) result += ' ';
+            result += NumericValue((*this)(i, j)).toString();
+        }
+        result += ')';
+    }
+    return result + ")";
+}
+
+bool NDArrayValue::isEqual(const ValuePtr& other) const {
+    auto array = valueCast<NDArrayValue>(other.get());
+    if (!array || shape != array->shape) return false;
+    for (size_t i = 0; i < rows(); i++) {
+        for (size_t j = 0; j < cols(); j++) {
+            if ((*this)(i, j) != (*array)(i, j)) return false;
+        }
+    }
+    return true;
+}
+
+size_t NDArrayValue::hash() const {
+    size_t result = rows() * 31 + cols();
+    for (size_t i = 0; i < rows(); i++) {
+        for (size_t j = 0; j < cols(); j++) result = result * 31 + std::hash<double>()((*this)(i, j));
+    }
+    return result;
+}
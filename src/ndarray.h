@@ -0,0 +1,98 @@
+//
+// Created by timetraveler314 on 6/17/24.
+//
+
+#ifndef MINI_LISP_NDARRAY_H
+#define MINI_LISP_NDARRAY_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "value.h"
+
+// A two-dimensional array of doubles. Element (i, j) lives at
+// offset + i * strides[0] + j * strides[1] of a storage shared between views,
+// so transposing and slicing make new views without copying, and writes
+// through a view show in every array sharing its storage.
+class NDArrayValue final : public Value {
+public:
+    using Shape = std::array<size_t, 2>;
+
+private:
+    std::shared_ptr<std::vector<double>> storage;
+    size_t offset;
+    Shape shape;
+    Shape strides;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::NDARRAY_VALUE);
+
+    // Products with fewer multiply-adds than this stay on the calling thread
+    static constexpr size_t PARALLEL_THRESHOLD = size_t{1} << 21;
+
+    // A new array, laid out by rows
+    NDArrayValue(size_t rows, size_t cols, double fill = 0);
+    // A view of `storage`
+    NDArrayValue(std::shared_ptr<std::vector<double>> storage, size_t offset, Shape shape, Shape strides):
+        Value(ValueType::NDARRAY_VALUE), storage{std::move(storage)}, offset{offset}, shape{shape}, strides{strides} {}
+
+    size_t rows() const {
+        return shape[0];
+    }
+
+    size_t cols() const {
+        return shape[1];
+    }
+
+    double& operator()(size_t i, size_t j) {
+        return (*storage)[offset + i * strides[0] + j * strides[1]];
+    }
+
+    double operator()(size_t i, size_t j) const {
+        return (*storage)[offset + i * strides[0] + j * strides[1]];
+    }
+
+    // Whether the elements of each row are adjacent, so that row() may be used
+    bool hasContiguousRows() const {
+        return strides[1] == 1 || shape[1] <= 1;
+    }
+
+    // Whether moreover the rows follow each other, so that row(0) starts all the elements
+    bool isContiguous() const {
+        return hasContiguousRows() && (shape[0] <= 1 || strides[0] == shape[1]);
+    }
+
+    const double* row(size_t i) const {
+        return storage->data() + offset + i * strides[0];
+    }
+
+    double* row(size_t i) {
+        return storage->data() + offset + i * strides[0];
+    }
+
+    // Views sharing the storage: rows and columns swapped, and the elements
+    // in rows [rowStart, rowEnd) and columns [colStart, colEnd)
+    std::shared_ptr<NDArrayValue> transpose() const;
+    std::shared_ptr<NDArrayValue> slice(size_t rowStart, size_t rowEnd, size_t colStart, size_t colEnd) const;
+    // A copy with storage of its own, laid out by rows
+    std::shared_ptr<NDArrayValue> copy() const;
+
+    // out[i] = x[i] op y[i] on rows, as in simd.h
+    using Kernel = void (*)(const double* x, const double* y, double* out, size_t n);
+    // The arrays must have the same shape
+    static std::shared_ptr<NDArrayValue> elementwise(const NDArrayValue& x, const NDArrayValue& y, Kernel kernel);
+    static std::shared_ptr<NDArrayValue> scale(double a, const NDArrayValue& x);
+
+    // The matrix product; x must have as many columns as y has rows.
+    // Blocked so that the panel of y being worked on stays in cache, with
+    // the rows of the product split between threads when it is large.
+    static std::shared_ptr<NDArrayValue> matmul(const NDArrayValue& x, const NDArrayValue& y);
+
+    std::string toString() const override;
+
+    bool isEqual(const ValuePtr& other) const override;
+    size_t hash() const override;
+};
+
+#endif //MINI_LISP_NDARRAY_H
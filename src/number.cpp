@@ -0,0 +1,198 @@
+//
+// Created by timetraveler314 on 6/10/24.
+//
+
+#include "number.h"
+
+#include <cmath>
+
+#include "bigint.h"
+#include "value.h"
+
+namespace Number {
+    Word div(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum() && x.asFixnum() % y.asFixnum() == 0) {
+            return Word::integer(x.asFixnum() / y.asFixnum());
+        }
+        return Word::number(x.asNumber() / y.asNumber());
+    }
+
+    Word quotient(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) return Word::integer(x.asFixnum() / y.asFixnum());
+        return Word::number(std::trunc(x.asNumber() / y.asNumber()));
+    }
+
+    Word remainder(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) return Word::fixnum(x.asFixnum() % y.asFixnum());
+        return Word::number(std::fmod(x.asNumber(), y.asNumber()));
+    }
+
+    Word modulo(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) {
+            // Takes the sign of the divisor
+            auto result = x.asFixnum() % y.asFixnum();
+            if (result != 0 && (result < 0) != (y.asFixnum() < 0)) result += y.asFixnum();
+            return Word::fixnum(result);
+        }
+        auto a = x.asNumber(), b = y.asNumber();
+        auto result = std::fmod(a, b);
+        if (a * b < 0) result += b;
+        return Word::number(result);
+    }
+
+    Word abs(Word x) {
+        if (x.isFixnum()) return Word::integer(std::abs(x.asFixnum()));
+        return Word::number(std::abs(x.asFlonum()));
+    }
+
+    Word expt(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum() && y.asFixnum() >= 0) {
+            // Square-and-multiply, leaving results beyond int64_t to bignums
+            int64_t base = x.asFixnum(), exponent = y.asFixnum(), result = 1;
+            while (exponent > 0) {
+                if ((exponent & 1) && !checkedMul(result, base, result)) return {};
+                exponent >>= 1;
+                if (exponent > 0 && !checkedMul(base, base, base)) return {};
+            }
+            return Word::integer(result);
+        }
+        return Word::number(std::pow(x.asNumber(), y.asNumber()));
+    }
+
+    namespace {
+        bool isExact(const Value& x) {
+            return x.is<FixnumValue>() || x.is<BignumValue>();
+        }
+
+        // The integer `x` as a BigInt, converting fixnums into `storage`
+        const BigInt& toBigInt(const Value& x, BigInt& storage) {
+            if (auto bignum = valueCast<BignumValue>(&x)) return bignum->getValue();
+            storage = BigInt(static_cast<const FixnumValue&>(x).getValue());
+            return storage;
+        }
+
+        // Tries `onWords` unless an operand is a bignum. Otherwise a flonum
+        // operand takes `onFlonums`, and integers take `onIntegers`.
+        template<typename OnWords, typename OnFlonums, typename OnIntegers>
+        ValuePtr arithmetic(const Value& x, const Value& y, OnWords onWords, OnFlonums onFlonums, OnIntegers onIntegers) {
+            if (!x.is<BignumValue>() && !y.is<BignumValue>()) {
+                auto result = onWords(Word::from(x), Word::from(y));
+                if (!result.isUndefined()) return result.toValue();
+            }
+            if (!isExact(x) || !isExact(y)) {
+                return Value::number(onFlonums(*x.asNumber(), *y.asNumber()));
+            }
+            BigInt a, b;
+            return onIntegers(toBigInt(x, a), toBigInt(y, b));
+        }
+    }
+
+    ValuePtr integer(BigInt value) {
+        if (auto fixnum = value.toInt64(); fixnum && Word::fitsFixnum(*fixnum)) {
+            return Value::integer(*fixnum);
+        }
+        return std::make_shared<BignumValue>(std::move(value));
+    }
+
+    ValuePtr add(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return add(a, b); },
+            [](double a, double b) { return a + b; },
+            [](const BigInt& a, const BigInt& b) { return integer(a + b); });
+    }
+
+    ValuePtr sub(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return sub(a, b); },
+            [](double a, double b) { return a - b; },
+            [](const BigInt& a, const BigInt& b) { return integer(a - b); });
+    }
+
+    ValuePtr mul(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return mul(a, b); },
+            [](double a, double b) { return a * b; },
+            [](const BigInt& a, const BigInt& b) { return integer(a * b); });
+    }
+
+    ValuePtr negate(const Value& x) {
+        if (auto bignum = valueCast<BignumValue>(&x)) return integer(-bignum->getValue());
+        auto result = negate(Word::from(x));
+        return result.isUndefined() ? integer(-BigInt(static_cast<const FixnumValue&>(x).getValue())) : result.toValue();
+    }
+
+    int compare(const Value& x, const Value& y) {
+        if (!x.is<BignumValue>() && !y.is<BignumValue>()) {
+            return compare(Word::from(x), Word::from(y));
+        }
+        if (!isExact(x) || !isExact(y)) {
+            double a = *x.asNumber(), b = *y.asNumber();
+            return (a > b) - (a < b);
+        }
+        BigInt a, b;
+        return BigInt::compare(toBigInt(x, a), toBigInt(y, b));
+    }
+
+    bool isZero(const Value& x) {
+        // Bignums are never zero
+        return !x.is<BignumValue>() && isZero(Word::from(x));
+    }
+
+    ValuePtr div(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return div(a, b); },
+            [](double a, double b) { return a / b; },
+            [](const BigInt& a, const BigInt& b) {
+                auto [quotient, remainder] = BigInt::divide(a, b);
+                return remainder.isZero() ? integer(std::move(quotient)) : Value::number(a.toDouble() / b.toDouble());
+            });
+    }
+
+    ValuePtr quotient(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return quotient(a, b); },
+            [](double a, double b) { return std::trunc(a / b); },
+            [](const BigInt& a, const BigInt& b) { return integer(BigInt::divide(a, b).first); });
+    }
+
+    ValuePtr remainder(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return remainder(a, b); },
+            [](double a, double b) { return std::fmod(a, b); },
+            [](const BigInt& a, const BigInt& b) { return integer(BigInt::divide(a, b).second); });
+    }
+
+    ValuePtr modulo(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return modulo(a, b); },
+            [](double a, double b) { return modulo(Word::number(a), Word::number(b)).asFlonum(); },
+            [](const BigInt& a, const BigInt& b) {
+                auto remainder = BigInt::divide(a, b).second;
+                if (!remainder.isZero() && remainder.isNegative() != b.isNegative()) remainder = remainder + b;
+                return integer(std::move(remainder));
+            });
+    }
+
+    ValuePtr abs(const Value& x) {
+        if (auto bignum = valueCast<BignumValue>(&x)) return integer(bignum->getValue().abs());
+        auto result = abs(Word::from(x));
+        return result.isUndefined() ? integer(BigInt(static_cast<const FixnumValue&>(x).getValue()).abs()) : result.toValue();
+    }
+
+    ValuePtr expt(const Value& x, const Value& y) {
+        return arithmetic(x, y,
+            [](Word a, Word b) { return expt(a, b); },
+            [](double a, double b) { return std::pow(a, b); },
+            [](const BigInt& a, const BigInt& b) {
+                auto exponent = b.toInt64();
+                if (!exponent || *exponent < 0) return Value::number(std::pow(a.toDouble(), b.toDouble()));
+                return integer(BigInt::pow(a, *exponent));
+            });
+    }
+
+    bool isEven(const Value& x) {
+        if (auto bignum = valueCast<BignumValue>(&x)) return bignum->getValue().isEven();
+        auto word = Word::from(x);
+        return word.isFixnum() ? word.asFixnum() % 2 == 0 : std::fmod(word.asFlonum(), 2) == 0;
+    }
+}
@@ -0,0 +1,111 @@
+//
+// Created by timetraveler314 on 6/10/24.
+//
+
+#ifndef MINI_LISP_NUMBER_H
+#define MINI_LISP_NUMBER_H
+
+// Arithmetic on numbers: flonums, which are inexact, and exact integers
+
+#include <cstdint>
+#include <limits>
+
+#include "word.h"
+
+class BigInt;
+
+// Exact operands give exact results, fixnums while they fit and bignums beyond.
+// A flonum operand makes the result a flonum.
+//
+// The operations on words only see flonums and fixnums. When the exact result
+// needs a bignum they return an undefined word and the caller has to redo the
+// operation on values.
+namespace Number {
+    // x * y into `result`, false if it overflows int64_t
+    inline bool checkedMul(int64_t x, int64_t y, int64_t& result) {
+#if defined(__GNUC__) || defined(__clang__)
+        return !__builtin_mul_overflow(x, y, &result);
+#else
+        using Limits = std::numeric_limits<int64_t>;
+        if (x > 0 ? (y > 0 ? x > Limits::max() / y : y < Limits::min() / x)
+                  : (y > 0 ? x < Limits::min() / y : x != 0 && y < Limits::max() / x)) {
+            return false;
+        }
+        result = x * y;
+        return true;
+#endif
+    }
+
+    inline Word add(Word x, Word y) {
+        // Sums of 48-bit payloads cannot overflow int64_t
+        if (x.isFixnum() && y.isFixnum()) return Word::integer(x.asFixnum() + y.asFixnum());
+        return Word::number(x.asNumber() + y.asNumber());
+    }
+
+    inline Word sub(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) return Word::integer(x.asFixnum() - y.asFixnum());
+        return Word::number(x.asNumber() - y.asNumber());
+    }
+
+    inline Word mul(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) {
+            int64_t result;
+            if (!checkedMul(x.asFixnum(), y.asFixnum(), result)) return {};
+            return Word::integer(result);
+        }
+        return Word::number(x.asNumber() * y.asNumber());
+    }
+
+    inline Word negate(Word x) {
+        if (x.isFixnum()) return Word::integer(-x.asFixnum());
+        return Word::number(-x.asFlonum());
+    }
+
+    // Negative, zero or positive as x is less than, equal to or greater than y.
+    // Doubles hold every fixnum exactly, so mixed operands compare exactly too.
+    inline int compare(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) {
+            return (x.asFixnum() > y.asFixnum()) - (x.asFixnum() < y.asFixnum());
+        }
+        double a = x.asNumber(), b = y.asNumber();
+        return (a > b) - (a < b);
+    }
+
+    inline bool equal(Word x, Word y) {
+        if (x.isFixnum() && y.isFixnum()) return x == y;
+        return x.asNumber() == y.asNumber();
+    }
+
+    inline bool isZero(Word x) {
+        return x.isFixnum() ? x.asFixnum() == 0 : x.asFlonum() == 0;
+    }
+
+    // The divisions take a non-zero divisor. div is exact when integers divide evenly.
+    Word div(Word x, Word y);
+    Word quotient(Word x, Word y);
+    Word remainder(Word x, Word y);
+    Word modulo(Word x, Word y);
+    Word abs(Word x);
+    // Exact for an exact base and a non-negative fixnum exponent
+    Word expt(Word x, Word y);
+
+    // The same on number values, bignums included
+    ValuePtr add(const Value& x, const Value& y);
+    ValuePtr sub(const Value& x, const Value& y);
+    ValuePtr mul(const Value& x, const Value& y);
+    ValuePtr negate(const Value& x);
+    int compare(const Value& x, const Value& y);
+    bool isZero(const Value& x);
+    ValuePtr div(const Value& x, const Value& y);
+    ValuePtr quotient(const Value& x, const Value& y);
+    ValuePtr remainder(const Value& x, const Value& y);
+    ValuePtr modulo(const Value& x, const Value& y);
+    ValuePtr abs(const Value& x);
+    ValuePtr expt(const Value& x, const Value& y);
+    bool isEven(const Value& x); // `x` must be an integer
+
+    // A fixnum if `value` fits one, otherwise a bignum
+    ValuePtr integer(BigInt value);
+}
+
+#endif //MINI_LISP_NUMBER_H
@@ -4,33 +4,50 @@
 
 #include "parser.h"
 #include "error.h"
+#include "number.h"
 #include "tokenizer.h"
 
 Utils::Task<ValuePtr> Parser::parse() {
     auto token = co_await tokenizer.awaitNextToken();
 
     switch (token->getType()) {
-        case TokenType::NUMERIC_LITERAL:
-            co_return std::make_shared<NumericValue>(static_cast<NumericLiteralToken&>(*token).getValue());
+        case TokenType::NUMERIC_LITERAL: {
+            auto& literal = static_cast<NumericLiteralToken&>(*token);
+            if (auto integer = literal.getInteger()) {
+                co_return Value::integer(*integer);
+            }
+            if (!literal.getDigits().empty()) {
+                co_return Number::integer(*BigInt::parse(literal.getDigits()));
+            }
+            co_return Value::number(literal.getValue());
+        }
         case TokenType::BOOLEAN_LITERAL:
-            co_return std::make_shared<BooleanValue>(static_cast<BooleanLiteralToken&>(*token).getValue());
+            co_return Value::boolean(static_cast<BooleanLiteralToken&>(*token).getValue());
         case TokenType::STRING_LITERAL:
             co_return std::make_shared<StringValue>(static_cast<StringLiteralToken&>(*token).getValue());
         case TokenType::IDENTIFIER:
-            co_return std::make_shared<SymbolValue>(static_cast<IdentifierToken&>(*token).getName());
+            co_return std::make_shared<SymbolValue>(static_cast<IdentifierToken&>(*token).getSymbol());
         case TokenType::LEFT_PAREN: {
             auto result = co_await parseTails();
             if (result->is<PairValue>()) {
-                std::dynamic_pointer_cast<PairValue>(result)->position = token->position;
+                valueCast<PairValue>(result)->position = token->position;
             }
             co_return result;
         }
+        case TokenType::VECTOR_START: {
+            std::vector<ValuePtr> elements;
+            while (co_await tokenizer.awaitPeekNextToken() != TokenType::RIGHT_PAREN) {
+                elements.push_back(co_await parse());
+            }
+            co_await tokenizer.awaitNextToken(); // consume the right paren
+            co_return std::make_shared<VectorValue>(std::move(elements));
+        }
         case TokenType::QUOTE:
-            co_return Value::fromVector({std::make_shared<SymbolValue>("quote"), co_await parse()});
+            co_return Value::fromVector({std::make_shared<SymbolValue>(Symbol::QUOTE), co_await parse()});
         case TokenType::UNQUOTE:
-            co_return Value::fromVector({std::make_shared<SymbolValue>("unquote"), co_await parse()});
+            co_return Value::fromVector({std::make_shared<SymbolValue>(Symbol::UNQUOTE), co_await parse()});
         case TokenType::QUASIQUOTE:
-            co_return Value::fromVector({std::make_shared<SymbolValue>("quasiquote"), co_await parse()});
+            co_return Value::fromVector({std::make_shared<SymbolValue>(Symbol::QUASIQUOTE), co_await parse()});
         case TokenType::RIGHT_PAREN:
             throw SyntaxError("Unexpected ')'.");
         case TokenType::DOT:
@@ -43,7 +60,7 @@ Utils::Task<ValuePtr> Parser::parse() {
 Utils::Task<ValuePtr> Parser::parseTails() {
     if (co_await tokenizer.awaitPeekNextToken() == TokenType::RIGHT_PAREN) {
         co_await tokenizer.awaitNextToken(); // consume the right paren
-        co_return std::make_shared<NilValue>();
+        co_return Value::nil();
     }
 
     auto car = co_await this->parse();
@@ -54,9 +71,9 @@ Utils::Task<ValuePtr> Parser::parseTails() {
             throw SyntaxError("Expected ')' after cdr.");
         }
         co_await tokenizer.awaitNextToken(); // consume the right paren
-        co_return std::make_shared<PairValue>(car, cdr);
+        co_return PairValue::create(car, cdr);
     } else {
         auto cdr = co_await this->parseTails();
-        co_return std::make_shared<PairValue>(car, cdr);
+        co_return PairValue::create(car, cdr);
     }
 } 
\ No newline at end of file
@@ -0,0 +1,86 @@
+//
+// Created by timetraveler314 on 6/8/24.
+//
+
+#ifndef MINI_LISP_POOL_H
+#define MINI_LISP_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Free-list allocator for objects of one size. Blocks are carved from slabs
+// holding many of them, so objects allocated together sit next to each other,
+// and freed blocks are reused before new slabs are taken. Slabs are never
+// returned to the system. Not thread-safe, like the rest of the interpreter.
+template<size_t Size, size_t Align>
+class Pool {
+    union Block {
+        Block* next;
+        alignas(Align) std::byte storage[Size];
+    };
+
+    static constexpr size_t SLAB_BLOCKS = 4096 / sizeof(Block);
+
+    Block* freeList = nullptr;
+    std::vector<std::unique_ptr<Block[]>> slabs;
+
+    void grow() {
+        auto& slab = slabs.emplace_back(new Block[SLAB_BLOCKS]);
+        // Thread the blocks in address order, so consecutive allocations are adjacent
+        for (size_t i = SLAB_BLOCKS; i-- > 0;) {
+            slab[i].next = freeList;
+            freeList = &slab[i];
+        }
+    }
+
+public:
+    // Never destroyed: pooled objects may outlive static destructors
+    static Pool& instance() {
+        static auto pool = new Pool;
+        return *pool;
+    }
+
+    void* allocate() {
+        if (!freeList) grow();
+        auto block = freeList;
+        freeList = block->next;
+        return block;
+    }
+
+    void deallocate(void* pointer) {
+        auto block = static_cast<Block*>(pointer);
+        block->next = freeList;
+        freeList = block;
+    }
+};
+
+// Standard allocator drawing single objects from the Pool of their size, for
+// use with std::allocate_shared: the control block and the object share a block
+template<class T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template<class U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) return std::allocator<T>().allocate(n);
+        return static_cast<T*>(Pool<sizeof(T), alignof(T)>::instance().allocate());
+    }
+
+    void deallocate(T* pointer, size_t n) {
+        if (n != 1) return std::allocator<T>().deallocate(pointer, n);
+        Pool<sizeof(T), alignof(T)>::instance().deallocate(pointer);
+    }
+
+    template<class U>
+    bool operator==(const PoolAllocator<U>&) const {
+        return true;
+    }
+};
+
+#endif //MINI_LISP_POOL_H
@@ -0,0 +1,403 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+#include "simd.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MINI_LISP_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define SIMD_INLINE __forceinline
+#define SIMD_TARGET(isa)
+#else
+#define SIMD_INLINE inline __attribute__((always_inline))
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+// Vectors only pass between inlined functions here, never through the ABI
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace {
+    // An instruction set: a vector V of WIDTH doubles and its operations. The
+    // kernels are written once against this interface, and instantiated for
+    // each set in functions compiled for it (see KERNELS).
+    struct Scalar {
+        using V = double;
+        static constexpr size_t WIDTH = 1;
+        static V load(const double* p) { return *p; }
+        static void store(double* p, V v) { *p = v; }
+        static V splat(double a) { return a; }
+        static V add(V a, V b) { return a + b; }
+        static V sub(V a, V b) { return a - b; }
+        static V mul(V a, V b) { return a * b; }
+        static V div(V a, V b) { return a / b; }
+        // NaN propagates through min and max: a + b is NaN when either is
+        static V min(V a, V b) { return std::isnan(a) || std::isnan(b) ? a + b : std::min(a, b); }
+        static V max(V a, V b) { return std::isnan(a) || std::isnan(b) ? a + b : std::max(a, b); }
+        static V abs(V a) { return std::abs(a); }
+        static V mask(bool holds) { return std::bit_cast<double>(holds ? ~uint64_t{0} : uint64_t{0}); }
+        static V less(V a, V b) { return mask(a < b); }
+        static V lessEqual(V a, V b) { return mask(a <= b); }
+        static V equal(V a, V b) { return mask(a == b); }
+        static V select(V mask, V a, V b) { return std::bit_cast<uint64_t>(mask) ? a : b; }
+        // Across the lanes
+        static double sum(V v) { return v; }
+        static double min(V v) { return v; }
+        static double max(V v) { return v; }
+    };
+
+#ifdef MINI_LISP_SIMD_X86
+    struct Sse2 {
+        using V = __m128d;
+        static constexpr size_t WIDTH = 2;
+        static SIMD_INLINE V load(const double* p) { return _mm_loadu_pd(p); }
+        static SIMD_INLINE void store(double* p, V v) { _mm_storeu_pd(p, v); }
+        static SIMD_INLINE V splat(double a) { return _mm_set1_pd(a); }
+        static SIMD_INLINE V add(V a, V b) { return _mm_add_pd(a, b); }
+        static SIMD_INLINE V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static SIMD_INLINE V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static SIMD_INLINE V div(V a, V b) { return _mm_div_pd(a, b); }
+        // minpd and maxpd return b when either is NaN, so NaN lanes are patched to a + b as in Scalar
+        static SIMD_INLINE V min(V a, V b) { return select(_mm_cmpunord_pd(a, b), _mm_add_pd(a, b), _mm_min_pd(a, b)); }
+        static SIMD_INLINE V max(V a, V b) { return select(_mm_cmpunord_pd(a, b), _mm_add_pd(a, b), _mm_max_pd(a, b)); }
+        static SIMD_INLINE V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        static SIMD_INLINE V less(V a, V b) { return _mm_cmplt_pd(a, b); }
+        static SIMD_INLINE V lessEqual(V a, V b) { return _mm_cmple_pd(a, b); }
+        static SIMD_INLINE V equal(V a, V b) { return _mm_cmpeq_pd(a, b); }
+        static SIMD_INLINE V select(V mask, V a, V b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+        static SIMD_INLINE double sum(V v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+        static SIMD_INLINE double min(V v) { return _mm_cvtsd_f64(min(v, _mm_unpackhi_pd(v, v))); }
+        static SIMD_INLINE double max(V v) { return _mm_cvtsd_f64(max(v, _mm_unpackhi_pd(v, v))); }
+    };
+
+    struct Avx2 {
+        using V = __m256d;
+        static constexpr size_t WIDTH = 4;
+        SIMD_TARGET("avx2") static V load(const double* p) { return _mm256_loadu_pd(p); }
+        SIMD_TARGET("avx2") static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+        SIMD_TARGET("avx2") static V splat(double a) { return _mm256_set1_pd(a); }
+        SIMD_TARGET("avx2") static V add(V a, V b) { return _mm256_add_pd(a, b); }
+        SIMD_TARGET("avx2") static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        SIMD_TARGET("avx2") static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        SIMD_TARGET("avx2") static V div(V a, V b) { return _mm256_div_pd(a, b); }
+        SIMD_TARGET("avx2") static V min(V a, V b) {
+            return select(_mm256_cmp_pd(a, b, _CMP_UNORD_Q), _mm256_add_pd(a, b), _mm256_min_pd(a, b));
+        }
+        SIMD_TARGET("avx2") static V max(V a, V b) {
+            return select(_mm256_cmp_pd(a, b, _CMP_UNORD_Q), _mm256_add_pd(a, b), _mm256_max_pd(a, b));
+        }
+        SIMD_TARGET("avx2") static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        SIMD_TARGET("avx2") static V less(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        SIMD_TARGET("avx2") static V lessEqual(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        SIMD_TARGET("avx2") static V equal(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        SIMD_TARGET("avx2") static V select(V mask, V a, V b) { return _mm256_blendv_pd(b, a, mask); }
+        SIMD_TARGET("avx2") static double sum(V v) {
+            return Sse2::sum(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+        }
+        SIMD_TARGET("avx2") static double min(V v) {
+            return Sse2::min(Sse2::min(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+        }
+        SIMD_TARGET("avx2") static double max(V v) {
+            return Sse2::max(Sse2::max(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+        }
+    };
+#endif
+
+    // Binary operations, with their reduction across lanes where they have one
+    template<typename ISA>
+    struct Add {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::add(a, b); }
+        static SIMD_INLINE double across(const typename ISA::V& v) { return ISA::sum(v); }
+    };
+
+    template<typename ISA>
+    struct Sub {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::sub(a, b); }
+    };
+
+    template<typename ISA>
+    struct Mul {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::mul(a, b); }
+    };
+
+    template<typename ISA>
+    struct Div {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::div(a, b); }
+    };
+
+    template<typename ISA>
+    struct Min {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::min(a, b); }
+        static SIMD_INLINE double across(const typename ISA::V& v) { return ISA::min(v); }
+    };
+
+    template<typename ISA>
+    struct Max {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::max(a, b); }
+        static SIMD_INLINE double across(const typename ISA::V& v) { return ISA::max(v); }
+    };
+
+    template<typename ISA>
+    struct Less {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::less(a, b); }
+    };
+
+    template<typename ISA>
+    struct LessEqual {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::lessEqual(a, b); }
+    };
+
+    template<typename ISA>
+    struct Equal {
+        static SIMD_INLINE auto apply(const typename ISA::V& a, const typename ISA::V& b) { return ISA::equal(a, b); }
+    };
+
+    template<typename ISA, template<typename> typename Op>
+    SIMD_INLINE void elementwise(const double* x, const double* y, double* out, size_t n) {
+        size_t i = 0;
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            ISA::store(out + i, Op<ISA>::apply(ISA::load(x + i), ISA::load(y + i)));
+        }
+        for (; i < n; i++) out[i] = Op<Scalar>::apply(x[i], y[i]);
+    }
+
+    template<typename ISA>
+    SIMD_INLINE void scale(double a, const double* x, double* out, size_t n) {
+        auto factor = ISA::splat(a);
+        size_t i = 0;
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            ISA::store(out + i, ISA::mul(factor, ISA::load(x + i)));
+        }
+        for (; i < n; i++) out[i] = a * x[i];
+    }
+
+    template<typename ISA>
+    SIMD_INLINE void axpy(double a, const double* x, double* y, size_t n) {
+        auto factor = ISA::splat(a);
+        size_t i = 0;
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            ISA::store(y + i, ISA::add(ISA::load(y + i), ISA::mul(factor, ISA::load(x + i))));
+        }
+        for (; i < n; i++) y[i] += a * x[i];
+    }
+
+    template<typename ISA>
+    SIMD_INLINE void abs(const double* x, double* out, size_t n) {
+        size_t i = 0;
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            ISA::store(out + i, ISA::abs(ISA::load(x + i)));
+        }
+        for (; i < n; i++) out[i] = Scalar::abs(x[i]);
+    }
+
+    template<typename ISA>
+    SIMD_INLINE void select(const double* mask, const double* x, const double* y, double* out, size_t n) {
+        size_t i = 0;
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            ISA::store(out + i, ISA::select(ISA::load(mask + i), ISA::load(x + i), ISA::load(y + i)));
+        }
+        for (; i < n; i++) out[i] = Scalar::select(mask[i], x[i], y[i]);
+    }
+
+    // The i-th vector of terms folded by reduce: x, or x * y for dot products
+    template<typename ISA, bool product>
+    SIMD_INLINE auto term(const double* x, const double* y, size_t i) {
+        if constexpr (product) {
+            return ISA::mul(ISA::load(x + i), ISA::load(y + i));
+        } else {
+            return ISA::load(x + i);
+        }
+    }
+
+    // Folds the terms with Op starting from `init`. Two accumulators let
+    // consecutive steps overlap instead of waiting on each other.
+    template<typename ISA, template<typename> typename Op, bool product>
+    SIMD_INLINE double reduce(const double* x, const double* y, size_t n, double init) {
+        auto first = ISA::splat(init), second = first;
+        size_t i = 0;
+        for (; i + 2 * ISA::WIDTH <= n; i += 2 * ISA::WIDTH) {
+            first = Op<ISA>::apply(first, term<ISA, product>(x, y, i));
+            second = Op<ISA>::apply(second, term<ISA, product>(x, y, i + ISA::WIDTH));
+        }
+        for (; i + ISA::WIDTH <= n; i += ISA::WIDTH) {
+            first = Op<ISA>::apply(first, term<ISA, product>(x, y, i));
+        }
+        double result = Op<ISA>::across(Op<ISA>::apply(first, second));
+        for (; i < n; i++) result = Op<Scalar>::apply(result, term<Scalar, product>(x, y, i));
+        return result;
+    }
+
+    struct Kernels {
+        void (*add)(const double* x, const double* y, double* out, size_t n);
+        void (*sub)(const double* x, const double* y, double* out, size_t n);
+        void (*mul)(const double* x, const double* y, double* out, size_t n);
+        void (*div)(const double* x, const double* y, double* out, size_t n);
+        void (*scale)(double a, const double* x, double* out, size_t n);
+        void (*axpy)(double a, const double* x, double* y, size_t n);
+        void (*abs)(const double* x, double* out, size_t n);
+        void (*less)(const double* x, const double* y, double* out, size_t n);
+        void (*lessEqual)(const double* x, const double* y, double* out, size_t n);
+        void (*equal)(const double* x, const double* y, double* out, size_t n);
+        void (*select)(const double* mask, const double* x, const double* y, double* out, size_t n);
+        double (*dot)(const double* x, const double* y, size_t n);
+        double (*sum)(const double* x, size_t n);
+        double (*min)(const double* x, size_t n);
+        double (*max)(const double* x, size_t n);
+    };
+
+    // The kernels of ISA, compiled with TARGET enabling its instructions
+#define KERNELS(ISA, TARGET) Kernels { \
+        .add = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Add>(x, y, out, n); }, \
+        .sub = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Sub>(x, y, out, n); }, \
+        .mul = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Mul>(x, y, out, n); }, \
+        .div = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Div>(x, y, out, n); }, \
+        .scale = [](double a, const double* x, double* out, size_t n) TARGET { scale<ISA>(a, x, out, n); }, \
+        .axpy = [](double a, const double* x, double* y, size_t n) TARGET { axpy<ISA>(a, x, y, n); }, \
+        .abs = [](const double* x, double* out, size_t n) TARGET { abs<ISA>(x, out, n); }, \
+        .less = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Less>(x, y, out, n); }, \
+        .lessEqual = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, LessEqual>(x, y, out, n); }, \
+        .equal = [](const double* x, const double* y, double* out, size_t n) TARGET { elementwise<ISA, Equal>(x, y, out, n); }, \
+        .select = [](const double* mask, const double* x, const double* y, double* out, size_t n) TARGET { \
+            select<ISA>(mask, x, y, out, n); \
+        }, \
+        .dot = [](const double* x, const double* y, size_t n) TARGET { return reduce<ISA, Add, true>(x, y, n, 0.0); }, \
+        .sum = [](const double* x, size_t n) TARGET { return reduce<ISA, Add, false>(x, nullptr, n, 0.0); }, \
+        .min = [](const double* x, size_t n) TARGET { return reduce<ISA, Min, false>(x, nullptr, n, x[0]); }, \
+        .max = [](const double* x, size_t n) TARGET { return reduce<ISA, Max, false>(x, nullptr, n, x[0]); }, \
+    }
+
+    const Kernels SCALAR_KERNELS = KERNELS(Scalar, );
+#ifdef MINI_LISP_SIMD_X86
+    const Kernels SSE2_KERNELS = KERNELS(Sse2, );
+    const Kernels AVX2_KERNELS = KERNELS(Avx2, SIMD_TARGET("avx2"));
+#endif
+
+    const Kernels& kernelsFor(Simd::Level level) {
+        switch (level) {
+#ifdef MINI_LISP_SIMD_X86
+            case Simd::Level::AVX2: return AVX2_KERNELS;
+            case Simd::Level::SSE2: return SSE2_KERNELS;
+#endif
+            default: return SCALAR_KERNELS;
+        }
+    }
+
+    Simd::Level detect() {
+#ifdef MINI_LISP_SIMD_X86
+#ifdef _MSC_VER
+        // AVX2 in the CPU, and the OS saving the YMM registers
+        int info[4];
+        __cpuid(info, 1);
+        bool osSaves = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        if (osSaves && (info[1] & (1 << 5))) return Simd::Level::AVX2;
+#else
+        if (__builtin_cpu_supports("avx2")) return Simd::Level::AVX2;
+#endif
+        return Simd::Level::SSE2; // Part of x86-64
+#else
+        return Simd::Level::SCALAR;
+#endif
+    }
+
+    struct Dispatch {
+        Simd::Level supported = detect();
+        Simd::Level level = supported;
+        const Kernels* kernels = &kernelsFor(level);
+    };
+
+    Dispatch& dispatch() {
+        static Dispatch dispatch;
+        return dispatch;
+    }
+
+    const Kernels& active() {
+        return *dispatch().kernels;
+    }
+}
+
+namespace Simd {
+    Level supported() {
+        return dispatch().supported;
+    }
+
+    Level level() {
+        return dispatch().level;
+    }
+
+    void setLevel(Level level) {
+        auto& state = dispatch();
+        state.level = std::min(level, state.supported);
+        state.kernels = &kernelsFor(state.level);
+    }
+
+    void add(const double* x, const double* y, double* out, size_t n) {
+        active().add(x, y, out, n);
+    }
+
+    void sub(const double* x, const double* y, double* out, size_t n) {
+        active().sub(x, y, out, n);
+    }
+
+    void mul(const double* x, const double* y, double* out, size_t n) {
+        active().mul(x, y, out, n);
+    }
+
+    void div(const double* x, const double* y, double* out, size_t n) {
+        active().div(x, y, out, n);
+    }
+
+    void scale(double a, const double* x, double* out, size_t n) {
+        active().scale(a, x, out, n);
+    }
+
+    void axpy(double a, const double* x, double* y, size_t n) {
+        active().axpy(a, x, y, n);
+    }
+
+    void abs(const double* x, double* out, size_t n) {
+        active().abs(x, out, n);
+    }
+
+    void less(const double* x, const double* y, double* out, size_t n) {
+        active().less(x, y, out, n);
+    }
+
+    void lessEqual(const double* x, const double* y, double* out, size_t n) {
+        active().lessEqual(x, y, out, n);
+    }
+
+    void equal(const double* x, const double* y, double* out, size_t n) {
+        active().equal(x, y, out, n);
+    }
+
+    void select(const double* mask, const double* x, const double* y, double* out, size_t n) {
+        active().select(mask, x, y, out, n);
+    }
+
+    double dot(const double* x, const double* y, size_t n) {
+        return active().dot(x, y, n);
+    }
+
+    double sum(const double* x, size_t n) {
+        return active().sum(x, n);
+    }
+
+    double min(const double* x, size_t n) {
+        return active().min(x, n);
+    }
+
+    double max(const double* x, size_t n) {
+        return active().max(x, n);
+    }
+}
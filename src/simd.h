@@ -0,0 +1,53 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+#ifndef MINI_LISP_SIMD_H
+#define MINI_LISP_SIMD_H
+
+#include <cstddef>
+
+// Kernels on arrays of doubles, vectorized for the best instruction set the
+// CPU supports (AVX2, else SSE2, else plain loops), chosen at startup.
+// Reductions add in a different order than a sequential loop does, so their
+// rounding may differ from it in the last bits.
+namespace Simd {
+    enum class Level {
+        SCALAR,
+        SSE2,
+        AVX2,
+    };
+
+    Level supported();
+    Level level();
+    // Switches to the kernels of `level`, at most the supported one, to compare them
+    void setLevel(Level level);
+
+    // out[i] = x[i] op y[i]; `out` may alias the inputs
+    void add(const double* x, const double* y, double* out, size_t n);
+    void sub(const double* x, const double* y, double* out, size_t n);
+    void mul(const double* x, const double* y, double* out, size_t n);
+    void div(const double* x, const double* y, double* out, size_t n);
+    // out[i] = a * x[i]
+    void scale(double a, const double* x, double* out, size_t n);
+    // y[i] += a * x[i]
+    void axpy(double a, const double* x, double* y, size_t n);
+    // out[i] = |x[i]|
+    void abs(const double* x, double* out, size_t n);
+
+    // Masks: out[i] has all bits set where the comparison holds, else none.
+    // Comparisons with NaN do not hold, as in C++.
+    void less(const double* x, const double* y, double* out, size_t n);
+    void lessEqual(const double* x, const double* y, double* out, size_t n);
+    void equal(const double* x, const double* y, double* out, size_t n);
+    // out[i] = mask[i] ? x[i] : y[i] for a mask made by the comparisons
+    void select(const double* mask, const double* x, const double* y, double* out, size_t n);
+
+    double dot(const double* x, const double* y, size_t n);
+    double sum(const double* x, size_t n);
+    // Of n > 0 elements, NaN if any element is NaN
+    double min(const double* x, size_t n);
+    double max(const double* x, size_t n);
+}
+
+#endif //MINI_LISP_SIMD_H
@@ -0,0 +1,41 @@
+//
+// Created by timetraveler314 on 6/4/24.
+//
+
+#include "symbol.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace {
+    struct SymbolTable {
+        std::deque<std::string> names; // Stable addresses, the index keys view into them
+        std::unordered_map<std::string_view, uint32_t> ids;
+
+        SymbolTable() {
+            // Must match the ids of the constants in symbol.h
+            for (auto name : {"quote", "quasiquote", "unquote", "else", "define", "begin", "if", "cond", "and", "or"}) {
+                intern(name);
+            }
+        }
+
+        uint32_t intern(std::string_view name) {
+            if (auto it = ids.find(name); it != ids.end()) {
+                return it->second;
+            }
+            const auto& stored = names.emplace_back(name);
+            return ids[stored] = names.size() - 1;
+        }
+    };
+
+    SymbolTable& table() {
+        static SymbolTable table;
+        return table;
+    }
+}
+
+Symbol::Symbol(std::string_view name): id{table().intern(name)} {}
+
+const std::string& Symbol::name() const {
+    return table().names[id];
+}
@@ -0,0 +1,59 @@
+//
+// Created by timetraveler314 on 6/4/24.
+//
+
+#ifndef MINI_LISP_SYMBOL_H
+#define MINI_LISP_SYMBOL_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// An interned name. Every distinct name gets one id from a process-wide table,
+// filled by the tokenizer, so symbols compare and hash as integers.
+class Symbol {
+    uint32_t id;
+
+    constexpr explicit Symbol(uint32_t id): id{id} {}
+
+public:
+    Symbol(std::string_view name);
+    Symbol(const std::string& name): Symbol(std::string_view(name)) {}
+    Symbol(const char* name): Symbol(std::string_view(name)) {}
+
+    // Names the reader and the special forms compare against, interned first
+    static const Symbol QUOTE, QUASIQUOTE, UNQUOTE, ELSE, DEFINE, BEGIN, IF, COND, AND, OR;
+
+    static constexpr Symbol fromId(uint32_t id) {
+        return Symbol(id);
+    }
+
+    const std::string& name() const;
+
+    constexpr uint32_t getId() const {
+        return id;
+    }
+
+    constexpr bool operator==(const Symbol& other) const = default;
+};
+
+inline constexpr Symbol Symbol::QUOTE{0u};
+inline constexpr Symbol Symbol::QUASIQUOTE{1u};
+inline constexpr Symbol Symbol::UNQUOTE{2u};
+inline constexpr Symbol Symbol::ELSE{3u};
+inline constexpr Symbol Symbol::DEFINE{4u};
+inline constexpr Symbol Symbol::BEGIN{5u};
+inline constexpr Symbol Symbol::IF{6u};
+inline constexpr Symbol Symbol::COND{7u};
+inline constexpr Symbol Symbol::AND{8u};
+inline constexpr Symbol Symbol::OR{9u};
+
+template<>
+struct std::hash<Symbol> {
+    size_t operator()(const Symbol& symbol) const noexcept {
+        return symbol.getId();
+    }
+};
+
+#endif //MINI_LISP_SYMBOL_H
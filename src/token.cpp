@@ -23,6 +23,10 @@ TokenPtr Token::dot() {
     return TokenPtr(new Token(TokenType::DOT));
 }
 
+TokenPtr Token::vectorStart() {
+    return TokenPtr(new Token(TokenType::VECTOR_START));
+}
+
 std::string Token::toString() const {
     switch (type) {
         case TokenType::LEFT_PAREN: return "(LEFT_PAREN)"; break;
@@ -31,6 +35,7 @@ std::string Token::toString() const {
         case TokenType::QUASIQUOTE: return "(QUASIQUOTE)"; break;
         case TokenType::UNQUOTE: return "(UNQUOTE)"; break;
         case TokenType::DOT: return "(DOT)"; break;
+        case TokenType::VECTOR_START: return "(VECTOR_START)"; break;
         default: return "(UNKNOWN)";
     }
 }
@@ -60,7 +65,7 @@ std::string StringLiteralToken::toString() const {
 }
 
 std::string IdentifierToken::toString() const {
-    return "(IDENTIFIER " + name + ")";
+    return "(IDENTIFIER " + getName() + ")";
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& token) {
@@ -1,10 +1,13 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
 
+#include "symbol.h"
+
 struct TokenPosition {
     int line = 1;
     int column = 0;
@@ -26,6 +29,7 @@ enum class TokenType {
     QUASIQUOTE,
     UNQUOTE,
     DOT,
+    VECTOR_START, // #(
     BOOLEAN_LITERAL,
     NUMERIC_LITERAL,
     STRING_LITERAL,
@@ -49,6 +53,7 @@ public:
 
     static TokenPtr fromChar(char c);
     static TokenPtr dot();
+    static TokenPtr vectorStart();
 
     TokenType getType() const {
         return type;
@@ -74,13 +79,25 @@ public:
 class NumericLiteralToken : public Token {
 private:
     double value;
+    std::optional<int64_t> integer; // Set if the literal is written as an integer, so it is exact
+    std::string digits; // Set instead for integers beyond int64_t
 
 public:
     NumericLiteralToken(double value) : Token(TokenType::NUMERIC_LITERAL), value{value} {}
+    NumericLiteralToken(int64_t integer) : Token(TokenType::NUMERIC_LITERAL), value(integer), integer{integer} {}
+    NumericLiteralToken(double value, std::string digits) : Token(TokenType::NUMERIC_LITERAL), value{value}, digits{std::move(digits)} {}
 
     double getValue() const {
         return value;
     }
+
+    std::optional<int64_t> getInteger() const {
+        return integer;
+    }
+
+    const std::string& getDigits() const {
+        return digits;
+    }
     std::string toString() const override;
 };
 
@@ -99,13 +116,17 @@ public:
 
 class IdentifierToken : public Token {
 private:
-    std::string name;
+    Symbol symbol;
 
 public:
-    IdentifierToken(const std::string& name) : Token(TokenType::IDENTIFIER), name{name} {}
+    IdentifierToken(const std::string& name) : Token(TokenType::IDENTIFIER), symbol{name} {}
 
     const std::string& getName() const {
-        return name;
+        return symbol.name();
+    }
+
+    Symbol getSymbol() const {
+        return symbol;
     }
     std::string toString() const override;
 };
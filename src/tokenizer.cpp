@@ -1,6 +1,7 @@
 #include "./tokenizer.h"
 
 #include <cctype>
+#include <charconv>
 #include <set>
 #include <stdexcept>
 
@@ -29,6 +30,11 @@ TokenPtr Tokenizer::tokenizeNext(int& pos) {
             if (auto result = BooleanLiteralToken::fromChar(input[pos + 1])) {
                 pos += 2;
                 return result;
+            } else if (input[pos + 1] == '(') {
+                auto token = Token::vectorStart();
+                token->position = position;
+                pos += 2;
+                return token;
             } else {
                 throw SyntaxError("Unexpected character after #");
             }
@@ -67,6 +73,19 @@ TokenPtr Tokenizer::tokenizeNext(int& pos) {
                 return Token::dot();
             }
             if (std::isdigit(text[0]) || text[0] == '+' || text[0] == '-' || text[0] == '.') {
+                // Integers are exact, anything else (a point, an exponent, too many digits) a flonum
+                int64_t integer;
+                auto first = text.data() + (text[0] == '+');
+                auto last = text.data() + text.size();
+                auto [end, error] = std::from_chars(first, last, integer);
+                if (end == last && (text[0] != '+' || std::isdigit(*first))) {
+                    if (error == std::errc()) {
+                        return std::make_unique<NumericLiteralToken>(integer);
+                    }
+                    if (error == std::errc::result_out_of_range) {
+                        return std::make_unique<NumericLiteralToken>(std::stod(text), std::string(first, last));
+                    }
+                }
                 try {
                     return std::make_unique<NumericLiteralToken>(std::stod(text));
                 } catch (std::invalid_argument& e) {
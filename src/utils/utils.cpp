@@ -4,20 +4,33 @@
 
 #include "utils.h"
 
+
 namespace Utils {
     bool isFalse(const ValuePtr &value) {
         return value->is<BooleanValue>() && !*(value->as<BooleanValue>());
     }
 
-    void checkParams(const std::string &name, size_t exact, const std::vector<ValuePtr> &params) {
+    void checkParams(const std::string &name, size_t exact, Arguments params) {
+        if (params.size() != exact) {
+            throw LispError(name + ": expected " + std::to_string(exact) + " arguments, but got " + std::to_string(params.size()));
+        }
+    }
+
+    void checkParams(const std::string &name, size_t min, size_t max, Arguments params) {
+        if (params.size() < min || params.size() > max) {
+            throw LispError(name + ": expected " + std::to_string(min) + " to " + std::to_string(max) + " arguments, but got " + std::to_string(params.size()));
+        }
+    }
+
+    void checkParams(const std::string &name, size_t exact, std::span<const Word> params) {
         if (params.size() != exact) {
             throw LispError(name + ": expected " + std::to_string(exact) + " arguments, but got " + std::to_string(params.size()));
         }
     }
 
-    void checkParams(const std::string &name, size_t min, size_t max, const std::vector<ValuePtr> &params) {
+    void checkParams(const std::string &name, size_t min, size_t max, std::span<const Word> params) {
         if (params.size() < min || params.size() > max) {
             throw LispError(name + ": expected " + std::to_string(min) + " to " + std::to_string(max) + " arguments, but got " + std::to_string(params.size()));
         }
     }
-}
\ No newline at end of file
+}
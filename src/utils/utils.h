@@ -5,17 +5,25 @@
 #ifndef MINI_LISP_UTILS_H
 #define MINI_LISP_UTILS_H
 
+#include <cmath>
 #include <vector>
+#include <span>
 #include <string>
 #include <format>
+#include <limits>
+#include "../f64vector.h"
+#include "../ndarray.h"
+#include "../hash_table.h"
 #include "../value.h"
 #include "../error.h"
 
 namespace Utils {
     bool isFalse(const ValuePtr& value);
 
-    void checkParams(const std::string &name, size_t exact, const std::vector<ValuePtr> &params);
-    void checkParams(const std::string &name, size_t min, size_t max, const std::vector<ValuePtr> &params);
+    void checkParams(const std::string &name, size_t exact, Arguments params);
+    void checkParams(const std::string &name, size_t min, size_t max, Arguments params);
+    void checkParams(const std::string &name, size_t exact, std::span<const Word> params);
+    void checkParams(const std::string &name, size_t min, size_t max, std::span<const Word> params);
 
     template<typename T>
     concept ValidTypePredicate = requires(T t, const ValuePtr& value) {
@@ -29,45 +37,48 @@ namespace Utils {
         { t.resolve(value) } -> std::convertible_to<typename T::resolve_type>;
     };
 
-    template<size_t index>
-    void requireParamsImpl(const std::string& name, std::size_t total, const std::vector<ValuePtr>& params) {
+    // The helpers below take the arguments as boxed values (Arguments, std::vector<ValuePtr>)
+    // or as words (std::span<const Word>); resolvers overload on both where it applies.
+
+    template<size_t index, typename Params>
+    void requireParamsImpl(const std::string& name, std::size_t total, const Params& params) {
         if (index != params.size()) {
             throw LispError(std::format("{}: expected {} arguments, but got {}", name, index, params.size()));
         }
     }
 
-    template<size_t index, ValidTypePredicate Pred, ValidTypePredicate... Rest>
-    void requireParamsImpl(const std::string& name, std::size_t total, const std::vector<ValuePtr>& params, Pred pred, Rest... preds) {
+    template<size_t index, typename Params, ValidTypePredicate Pred, ValidTypePredicate... Rest>
+    void requireParamsImpl(const std::string& name, std::size_t total, const Params& params, Pred pred, Rest... preds) {
         if (index >= params.size()) throw LispError(std::format("{}: expected {} arguments, but got {}", name, total, params.size()));
         if (!pred(params[index])) throw LispError(std::format("{}: expected argument {} to be of type \"{}\"", name, index + 1, pred.name));
-        requireParamsImpl<index + 1, Rest...>(name, total, params, preds...);
+        requireParamsImpl<index + 1, Params, Rest...>(name, total, params, preds...);
     }
 
-    template<ValidTypePredicate... Preds>
-    void requireParams(const std::string& name, const std::vector<ValuePtr>& params, Preds... preds) {
-        requireParamsImpl<0, Preds...>(name, sizeof...(preds), params, preds...);
+    template<typename Params, ValidTypePredicate... Preds>
+    void requireParams(const std::string& name, const Params& params, Preds... preds) {
+        requireParamsImpl<0, Params, Preds...>(name, sizeof...(preds), params, preds...);
     }
 
-    template<size_t index>
-    std::tuple<> resolveParamsImpl(const std::string& name, std::size_t total, const std::vector<ValuePtr>& params) {
+    template<size_t index, typename Params>
+    std::tuple<> resolveParamsImpl(const std::string& name, std::size_t total, const Params& params) {
         return {};
     }
 
-    template<size_t index, ValidTypeResolver Resolver, ValidTypeResolver... Rest>
-    auto resolveParamsImpl(const std::string& name, std::size_t total, const std::vector<ValuePtr>& params, Resolver res, Rest... rest) {
+    template<size_t index, typename Params, ValidTypeResolver Resolver, ValidTypeResolver... Rest>
+    auto resolveParamsImpl(const std::string& name, std::size_t total, const Params& params, Resolver res, Rest... rest) {
         if (index >= params.size()) throw LispError(std::format("{}: expected {} arguments, but got {}", name, total, params.size()));
         if (!res(params[index])) throw LispError(std::format("{}: expected argument {} to be of type \"{}\"", name, index + 1, res.name));
-        return std::tuple_cat(std::tuple(res.resolve(params[index])), resolveParamsImpl<index + 1, Rest...>(name, total, params, rest...));
+        return std::tuple_cat(std::tuple<typename Resolver::resolve_type>(res.resolve(params[index])), resolveParamsImpl<index + 1, Params, Rest...>(name, total, params, rest...));
     }
 
-    template<ValidTypeResolver... Resolvers>
-    auto resolveParams(const std::string& name, const std::vector<ValuePtr>& params, Resolvers... resolvers) {
+    template<typename Params, ValidTypeResolver... Resolvers>
+    auto resolveParams(const std::string& name, const Params& params, Resolvers... resolvers) {
         if (params.size() != sizeof...(resolvers)) throw LispError(std::format("{}: expected {} arguments, but got {}", name, sizeof...(resolvers), params.size()));
-        return resolveParamsImpl<0, Resolvers...>(name, sizeof...(resolvers), params, resolvers...);
+        return resolveParamsImpl<0, Params, Resolvers...>(name, sizeof...(resolvers), params, resolvers...);
     }
 
-    template<ValidTypeResolver Resolver>
-    auto resolveAllParams(const std::string& name, const std::vector<ValuePtr>& params, Resolver res) {
+    template<typename Params, ValidTypeResolver Resolver>
+    auto resolveAllParams(const std::string& name, const Params& params, Resolver res) {
         std::vector<typename Resolver::resolve_type> result;
         for (size_t i = 0; i < params.size(); ++i) {
             if (!res(params[i])) throw LispError(std::format("{}: expected argument {} to be of type \"{}\"", name, i + 1, res.name));
@@ -76,9 +87,32 @@ namespace Utils {
         return result;
     }
 
+    // Generates the entry points of a builtin for calls with exactly one argument per
+    // resolver (see BuiltinSpec): `impl` gets the resolved arguments. If they do
+    // not resolve, `general` runs instead and reports the error as usual.
+    template<BuiltinFuncType general, auto impl, auto... resolvers>
+    struct FastPath {
+        static ValuePtr unary(const ValuePtr& x, EvalEnv& env) requires (sizeof...(resolvers) == 1) {
+            return call(env, x);
+        }
+
+        static ValuePtr binary(const ValuePtr& x, const ValuePtr& y, EvalEnv& env) requires (sizeof...(resolvers) == 2) {
+            return call(env, x, y);
+        }
+
+    private:
+        template<typename... Args>
+        static ValuePtr call(EvalEnv& env, const Args&... args) {
+            if ((resolvers(args) && ...)) {
+                return impl(resolvers.resolve(args)...);
+            }
+            return general({args...}, env);
+        }
+    };
+
     struct IsAny {
         using resolve_type = const ValuePtr&;
-        std::string name = "any";
+        static constexpr const char* name = "any";
         bool operator()(const ValuePtr& value) const {
             return true;
         }
@@ -91,33 +125,101 @@ namespace Utils {
 
     struct IsNumeric {
         using resolve_type = double;
-        std::string name = "number";
+        static constexpr const char* name = "number";
         bool operator()(const ValuePtr& value) const {
-            return value->is<NumericValue>();
+            return value->isNumber();
         }
 
         double resolve(const ValuePtr& value) const {
-            return value->as<NumericValue>().value();
+            return *value->asNumber();
+        }
+
+        bool operator()(Word word) const {
+            return word.isNumber();
+        }
+
+        double resolve(Word word) const {
+            return word.asNumber();
         }
     };
     static constexpr auto isNumeric = IsNumeric();
 
+    // Any number, for the arithmetic in number.h
+    struct IsNumber {
+        using resolve_type = const Value&;
+        static constexpr const char* name = "number";
+        bool operator()(const ValuePtr& value) const {
+            return value->isNumber();
+        }
+
+        const Value& resolve(const ValuePtr& value) const {
+            return *value;
+        }
+    };
+    static constexpr auto isNumber = IsNumber();
+
     struct IsInteger {
         using resolve_type = int;
-        std::string name = "integer";
+        static constexpr const char* name = "integer";
         bool operator()(const ValuePtr& value) const {
             return value->isNumericInteger();
         }
 
         int resolve(const ValuePtr& value) const {
-            return value->asInteger().value();
+            if (auto integer = value->asInteger()) return *integer;
+            throw LispError("Integer out of range: " + value->toString());
+        }
+
+        bool operator()(Word word) const {
+            double intpart;
+            return word.isFixnum() || (word.isFlonum() && std::modf(word.asFlonum(), &intpart) == 0.0);
+        }
+
+        int resolve(Word word) const {
+            auto value = word.asNumber();
+            if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max()) {
+                throw LispError(std::format("Integer out of range: {}", value));
+            }
+            return static_cast<int>(value);
         }
     };
     static constexpr auto isInteger = IsInteger();
 
+    // An integer used as an index or a length, kept whole for the caller to
+    // range-check rather than narrowed to int like IsInteger
+    struct IsIndex {
+        using resolve_type = int64_t;
+        static constexpr const char* name = "integer";
+        bool operator()(const ValuePtr& value) const {
+            return value->isNumericInteger();
+        }
+
+        int64_t resolve(const ValuePtr& value) const {
+            if (auto fixnum = valueCast<FixnumValue>(value.get())) return fixnum->getValue();
+            if (auto flonum = valueCast<NumericValue>(value.get())) return resolve(flonum->getValue());
+            throw LispError("Integer out of range: " + value->toString());
+        }
+
+        bool operator()(Word word) const {
+            return isInteger(word);
+        }
+
+        int64_t resolve(Word word) const {
+            return word.isFixnum() ? word.asFixnum() : resolve(word.asFlonum());
+        }
+
+    private:
+        static int64_t resolve(double value) {
+            // 2^63 itself is out of range
+            if (std::abs(value) >= 0x1p63) throw LispError(std::format("Integer out of range: {}", value));
+            return static_cast<int64_t>(value);
+        }
+    };
+    static constexpr auto isIndex = IsIndex();
+
     struct IsBoolean {
         using resolve_type = bool;
-        std::string name = "boolean";
+        static constexpr const char* name = "boolean";
         bool operator()(const ValuePtr& value) const {
             return value->is<BooleanValue>();
         }
@@ -125,12 +227,20 @@ namespace Utils {
         bool resolve(const ValuePtr& value) const {
             return value->as<BooleanValue>().value();
         }
+
+        bool operator()(Word word) const {
+            return word.isBoolean();
+        }
+
+        bool resolve(Word word) const {
+            return word.asBoolean();
+        }
     };
     static constexpr auto isBoolean = IsBoolean();
 
     struct IsString {
         using resolve_type = std::string;
-        std::string name = "string";
+        static constexpr const char* name = "string";
         bool operator()(const ValuePtr& value) const {
             return value->is<StringValue>();
         }
@@ -143,33 +253,33 @@ namespace Utils {
 
     struct IsSymbol {
         using resolve_type = std::string;
-        std::string name = "symbol";
+        static constexpr const char* name = "symbol";
         bool operator()(const ValuePtr& value) const {
             return value->is<SymbolValue>();
         }
 
         std::string resolve(const ValuePtr& value) const {
-            return value->asSymbol().value();
+            return value->asSymbol()->name();
         }
     };
     static constexpr auto isSymbol = IsSymbol();
 
     struct IsPair {
-        using resolve_type = std::shared_ptr<PairValue>;
-        std::string name = "pair";
+        using resolve_type = const PairValue&;
+        static constexpr const char* name = "pair";
         bool operator()(const ValuePtr& value) const {
             return value->is<PairValue>();
         }
 
-        std::shared_ptr<PairValue> resolve(const ValuePtr& value) const {
-            return std::dynamic_pointer_cast<PairValue>(value);
+        const PairValue& resolve(const ValuePtr& value) const {
+            return static_cast<const PairValue&>(*value);
         }
     };
     static constexpr auto isPair = IsPair();
 
     struct IsList {
         using resolve_type = std::vector<ValuePtr>;
-        std::string name = "list";
+        static constexpr const char* name = "list";
         bool operator()(const ValuePtr& value) const {
             return value->isList();
         }
@@ -180,9 +290,48 @@ namespace Utils {
     };
     static constexpr auto isList = IsList();
 
+    struct IsVector {
+        using resolve_type = VectorValue&;
+        static constexpr const char* name = "vector";
+        bool operator()(const ValuePtr& value) const {
+            return value->is<VectorValue>();
+        }
+
+        VectorValue& resolve(const ValuePtr& value) const {
+            return static_cast<VectorValue&>(*value);
+        }
+    };
+    static constexpr auto isVector = IsVector();
+
+    struct IsF64Vector {
+        using resolve_type = F64VectorValue&;
+        static constexpr const char* name = "f64vector";
+        bool operator()(const ValuePtr& value) const {
+            return value->is<F64VectorValue>();
+        }
+
+        F64VectorValue& resolve(const ValuePtr& value) const {
+            return static_cast<F64VectorValue&>(*value);
+        }
+    };
+    static constexpr auto isF64Vector = IsF64Vector();
+
+    struct IsNDArray {
+        using resolve_type = NDArrayValue&;
+        static constexpr const char* name = "ndarray";
+        bool operator()(const ValuePtr& value) const {
+            return value->is<NDArrayValue>();
+        }
+
+        NDArrayValue& resolve(const ValuePtr& value) const {
+            return static_cast<NDArrayValue&>(*value);
+        }
+    };
+    static constexpr auto isNDArray = IsNDArray();
+
     struct IsNonEmptyList {
         using resolve_type = std::vector<ValuePtr>;
-        std::string name = "non-empty list";
+        static constexpr const char* name = "non-empty list";
         bool operator()(const ValuePtr& value) const {
             return value->isNonEmptyList();
         }
@@ -195,16 +344,29 @@ namespace Utils {
 
     struct IsProcedure {
         using resolve_type = std::shared_ptr<ProcedureValue>;
-        std::string name = "procedure";
+        static constexpr const char* name = "procedure";
         bool operator()(const ValuePtr& value) const {
             return value->is<ProcedureValue>();
         }
 
         std::shared_ptr<ProcedureValue> resolve(const ValuePtr& value) const {
-            return std::dynamic_pointer_cast<ProcedureValue>(value);
+            return valueCast<ProcedureValue>(value);
         }
     };
     static constexpr auto isProcedure = IsProcedure();
+
+    struct IsHashTable {
+        using resolve_type = HashTableValue&;
+        static constexpr const char* name = "hash table";
+        bool operator()(const ValuePtr& value) const {
+            return value->is<HashTableValue>();
+        }
+
+        HashTableValue& resolve(const ValuePtr& value) const {
+            return static_cast<HashTableValue&>(*value);
+        }
+    };
+    static constexpr auto isHashTable = IsHashTable();
 }
 
 #endif //MINI_LISP_UTILS_H
@@ -4,28 +4,33 @@
 
 #include "value.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
+#include <limits>
 
+#include "arena.h"
+#include "compiler.h"
 #include "error.h"
 #include "eval_env.h"
 
 bool Value::isNumericInteger() const {
+    if (is<FixnumValue>() || is<BignumValue>()) return true;
     if (!is<NumericValue>()) return false;
 
     double intpart;
-    return std::modf(dynamic_cast<const NumericValue*>(this)->getValue(), &intpart) == 0.0;
+    return std::modf(static_cast<const NumericValue*>(this)->getValue(), &intpart) == 0.0;
 }
 
 bool Value::isNonEmptyList() const {
     if (!is<PairValue>()) return false;
 
-    auto current = dynamic_cast<const PairValue*>(this);
+    auto current = valueCast<PairValue>(this);
     while (current) {
-        if (auto pair = dynamic_cast<const PairValue*>(current->getCdr().get())) {
+        if (auto pair = valueCast<PairValue>(current->getCdr().get())) {
             current = pair;
         } else {
-            if (auto nil = dynamic_cast<const NilValue*>(current->getCdr().get())) {
+            if (auto nil = valueCast<NilValue>(current->getCdr().get())) {
                 return true;
             } else {
                 return false;
@@ -40,49 +45,114 @@ bool Value::isList() const {
     return is<NilValue>() || isNonEmptyList();
 }
 
-std::optional<std::string> Value::asSymbol() const {
+std::optional<Symbol> Value::asSymbol() const {
     if (is<SymbolValue>()) {
-        return dynamic_cast<const SymbolValue*>(this)->getValue();
+        return static_cast<const SymbolValue*>(this)->getSymbol();
     } else {
         return std::nullopt;
     }
 }
 
 std::optional<int> Value::asInteger() const {
+    // Integers beyond int have none, like bignums
+    using Limits = std::numeric_limits<int>;
+    if (is<FixnumValue>()) {
+        auto value = static_cast<const FixnumValue*>(this)->getValue();
+        if (value < Limits::min() || value > Limits::max()) return std::nullopt;
+        return static_cast<int>(value);
+    }
     double intpart;
-    if (is<NumericValue>() && std::modf(dynamic_cast<const NumericValue*>(this)->getValue(), &intpart) == 0.0) {
-        return std::lround(intpart);
+    if (is<NumericValue>() && std::modf(static_cast<const NumericValue*>(this)->getValue(), &intpart) == 0.0 &&
+        intpart >= Limits::min() && intpart <= Limits::max()) {
+        return static_cast<int>(intpart);
     } else {
         return std::nullopt;
     }
 }
 
-ValuePtr Value::fromVector(const std::vector<ValuePtr> &values) {
-    ValuePtr result = std::make_shared<NilValue>();
+std::optional<double> Value::asNumber() const {
+    if (is<FixnumValue>()) {
+        return static_cast<double>(static_cast<const FixnumValue*>(this)->getValue());
+    }
+    if (is<BignumValue>()) {
+        return static_cast<const BignumValue*>(this)->getValue().toDouble();
+    }
+    return as<NumericValue>();
+}
+
+const ValuePtr& Value::nil() {
+    static const ValuePtr instance = std::make_shared<NilValue>();
+    return instance;
+}
+
+const ValuePtr& Value::boolean(bool value) {
+    static const ValuePtr instances[] = {std::make_shared<BooleanValue>(false), std::make_shared<BooleanValue>(true)};
+    return instances[value];
+}
+
+namespace {
+    constexpr int SMALL_INTEGER_MIN = -128;
+    constexpr int SMALL_INTEGER_MAX = 1024;
+
+    template<typename T>
+    const std::vector<ValuePtr>& smallIntegers() {
+        static const std::vector<ValuePtr> cache = [] {
+            std::vector<ValuePtr> values;
+            for (int i = SMALL_INTEGER_MIN; i <= SMALL_INTEGER_MAX; i++) {
+                values.push_back(std::make_shared<T>(i));
+            }
+            return values;
+        }();
+        return cache;
+    }
+}
+
+ValuePtr Value::number(double value) {
+    // -0.0 is kept distinct, (/ 1 -0.0) must not see 0
+    if (value >= SMALL_INTEGER_MIN && value <= SMALL_INTEGER_MAX && std::trunc(value) == value && !(value == 0 && std::signbit(value))) {
+        return smallIntegers<NumericValue>()[static_cast<int>(value) - SMALL_INTEGER_MIN];
+    }
+    return std::allocate_shared<NumericValue>(ArenaAllocator<NumericValue>(), value);
+}
+
+ValuePtr Value::integer(int64_t value) {
+    if (value >= SMALL_INTEGER_MIN && value <= SMALL_INTEGER_MAX) {
+        return smallIntegers<FixnumValue>()[value - SMALL_INTEGER_MIN];
+    }
+    if (!Word::fitsFixnum(value)) {
+        return std::make_shared<BignumValue>(BigInt(value));
+    }
+    return std::allocate_shared<FixnumValue>(ArenaAllocator<FixnumValue>(), value);
+}
+
+ValuePtr Value::promote(ValuePtr value) {
+    if (value->isNumber() && Arena::instance().contains(value.get())) {
+        if (value->is<FixnumValue>()) {
+            return std::make_shared<FixnumValue>(static_cast<const FixnumValue&>(*value).getValue());
+        }
+        return std::make_shared<NumericValue>(static_cast<const NumericValue&>(*value).getValue());
+    }
+    return value;
+}
+
+ValuePtr Value::fromVector(Arguments values) {
+    ValuePtr result = nil();
     for (auto it = values.rbegin(); it != values.rend(); ++it) {
-        result = std::make_shared<PairValue>(*it, result);
+        result = PairValue::create(*it, result);
     }
     return result;
 }
 
 std::vector<ValuePtr> Value::toVector() {
+    // One pass over the cells, checking for a proper list at the end
     std::vector<ValuePtr> result;
-    if (is<NilValue>()) return result;
-    if (!isNonEmptyList()) throw LispError("Cannot convert improper list to vector.");
-
-    auto current = dynamic_cast<const PairValue*>(this);
-    while (true) {
-        result.push_back(current->getCar());
-        if (auto pair = dynamic_cast<const PairValue*>(current->getCdr().get())) {
-            current = pair;
-        } else {
-            if (auto nil = dynamic_cast<const NilValue*>(current->getCdr().get())) {
-                return result;
-            } else {
-                throw LispError("Cannot convert improper list to vector. This branch shall not happen.");
-            }
-        }
+    const Value* current = this;
+    while (auto pair = valueCast<PairValue>(current)) {
+        result.push_back(pair->getCar());
+        current = pair->getCdr().get();
     }
+    if (!current->is<NilValue>()) throw LispError("Cannot convert improper list to vector.");
+    return result;
 }
 
 template <>
@@ -91,6 +161,15 @@ std::string NumericValue::toString() const {
     return std::modf(value, &intpart) == 0.0 ? std::to_string(std::lround(intpart)) : std::to_string(value);
 }
 
+template<>
+std::string FixnumValue::toString() const {
+    return std::to_string(value);
+}
+
+std::string BignumValue::toString() const {
+    return value.toString();
+}
+
 template<>
 std::string BooleanValue::toString() const {
     return value ? "#t" : "#f";
@@ -108,7 +187,7 @@ std::string NilValue::toString() const {
 }
 
 std::string SymbolValue::toString() const {
-    return name;
+    return symbol.name();
 }
 
 std::string PairValue::toString() const {
@@ -118,11 +197,11 @@ std::string PairValue::toString() const {
 
     while (current) {
         ss << current->car->toString();
-        if (auto pair = dynamic_cast<const PairValue*>(current->cdr.get())) {
+        if (auto pair = valueCast<PairValue>(current->cdr.get())) {
             ss << " ";
             current = pair;
         } else {
-            if (dynamic_cast<const NilValue*>(current->cdr.get())) {
+            if (valueCast<NilValue>(current->cdr.get())) {
                 ss << ")";
                 current = nullptr;
             } else {
@@ -135,26 +214,161 @@ std::string PairValue::toString() const {
     return ss.str();
 }
 
+PairValue::~PairValue() {
+    auto next = std::move(cdr);
+    while (next && next.use_count() == 1 && next->getType() == ValueType::PAIR_VALUE) {
+        auto pair = valueCast<PairValue>(next.get());
+        next = std::move(pair->cdr); // Destroys the pair, whose cdr is already empty
+    }
+}
+
 bool PairValue::isEqual(const ValuePtr &other) const {
-    if (auto ptr = std::dynamic_pointer_cast<PairValue>(other)) {
+    if (auto ptr = valueCast<PairValue>(other)) {
         return car->isEqual(ptr->car) && cdr->isEqual(ptr->cdr);
     }
     return false;
 }
 
+size_t PairValue::hash() const {
+    // Along the spine iteratively, like the destructor
+    size_t result = 0x9e3779b9;
+    const Value* current = this;
+    while (auto pair = valueCast<PairValue>(current)) {
+        result = result * 31 + pair->car->hash();
+        current = pair->cdr.get();
+    }
+    return result * 31 + current->hash();
+}
+
+VectorValue::VectorValue(std::vector<ValuePtr> elements): SelfEvaluatingValue(ValueType::VECTOR_VALUE), elements{std::move(elements)} {
+    for (auto& element : this->elements) element = promote(std::move(element));
+}
+
+namespace {
+    // The vectors being printed or compared by the calls up the stack. A
+    // vector met again inside itself closes a cycle, which would otherwise
+    // recurse without end.
+    std::vector<const VectorValue*> printing;
+    std::vector<std::pair<const VectorValue*, const VectorValue*>> comparing;
+
+    // Elements hashed per outermost vector; the rest of a large or cyclic vector is left out
+    constexpr size_t HASH_BUDGET = 256;
+    size_t hashDepth = 0;
+    size_t hashBudget = 0;
+
+    // Pushes onto one of the stacks above for the duration of a call
+    template<typename T>
+    class Visit {
+        std::vector<T>& stack;
+
+    public:
+        Visit(std::vector<T>& stack, T item): stack{stack} {
+            stack.push_back(item);
+        }
+
+        ~Visit() {
+            stack.pop_back();
+        }
+    };
+}
+
+std::string VectorValue::toString() const {
+    if (std::ranges::find(printing, this) != printing.end()) return "#(...)";
+    Visit visit(printing, this);
+    std::string result = "#(";
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (i > 0) result += ' ';
+        result += elements[i]->toString();
+    }
+    return result + ")";
+}
+
+bool VectorValue::isEqual(const ValuePtr& other) const {
+    auto vector = valueCast<VectorValue>(other.get());
+    if (!vector || elements.size() != vector->elements.size()) return false;
+    // Comparing the same two vectors again inside themselves: equal unless told apart elsewhere
+    std::pair<const VectorValue*, const VectorValue*> operands{this, vector};
+    if (std::ranges::find(comparing, operands) != comparing.end()) return true;
+    Visit visit(comparing, operands);
+    return std::ranges::equal(elements, vector->elements, [](const ValuePtr& x, const ValuePtr& y) {
+        return x->isEqual(y);
+    });
+}
+
+size_t VectorValue::hash() const {
+    // Equal vectors hash the same elements in the same order, so they spend the budget alike
+    if (hashDepth == 0) hashBudget = HASH_BUDGET;
+    hashDepth++;
+    size_t result = elements.size();
+    for (auto& element : elements) {
+        if (hashBudget == 0) break;
+        hashBudget--;
+        result = result * 31 + element->hash();
+    }
+    hashDepth--;
+    return result;
+}
+
+LambdaValue::LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<Symbol> params, const std::vector<ValuePtr> &body):
+    ProcedureValue(ValueType::LAMBDA_VALUE), env{std::move(env)}, params{std::move(params)} {
+    auto function = Compiler::compileFunction(this->params, body, nullptr);
+    this->body = std::move(function.body);
+    frame = function.frame;
+}
+
 std::string LambdaValue::toString() const {
     return "#<procedure>";
 }
 
-ValuePtr LambdaValue::apply(const std::vector<ValuePtr> &args, EvalEnv& currentEnv) {
-    if (args.size() != params.size()) {
-        throw LispError("Procedure expected " + std::to_string(params.size()) + " arguments, but got " + std::to_string(args.size()));
+void LambdaValue::trace(GC::Tracer &tracer) const {
+    tracer(env);
+}
+
+namespace {
+    struct PendingTailCall {
+        std::shared_ptr<LambdaValue> proc;
+        std::vector<ValuePtr> args;
+    } pendingTailCall;
+
+    const ValuePtr& tailCallMarker() {
+        static const ValuePtr marker = std::make_shared<NilValue>();
+        return marker;
     }
+}
 
-    auto lambdaEnv = env->createChild(params, args, getName(), currentEnv.shared_from_this());
-    ValuePtr evalResult;
-    for (const auto& expr : body) {
-        evalResult = lambdaEnv->eval(expr);
+ValuePtr LambdaValue::tailCall(std::shared_ptr<LambdaValue> proc, std::vector<ValuePtr> args) {
+    pendingTailCall = {std::move(proc), std::move(args)};
+    return tailCallMarker();
+}
+
+bool LambdaValue::isTailCall(const ValuePtr &value) {
+    return value == tailCallMarker();
+}
+
+ValuePtr LambdaValue::apply(Arguments args, EvalEnv& currentEnv) {
+    // Frames of tail calls replace the caller's, so tracebacks lead back to currentEnv
+    auto runtimeParent = currentEnv.shared_from_this();
+    std::shared_ptr<LambdaValue> self; // Keeps the procedure of a tail call alive
+    auto proc = this;
+    std::vector<ValuePtr> arguments; // Of the tail call being run, `args` refers to them
+    while (true) {
+        if (args.size() != proc->params.size()) {
+            throw LispError("Procedure expected " + std::to_string(proc->params.size()) + " arguments, but got " + std::to_string(args.size()));
+        }
+        ValuePtr result;
+        if (proc->frame.captured) {
+            auto lambdaEnv = proc->env->createChild(std::vector(args.begin(), args.end()), proc->frame.size, proc->getName(), runtimeParent);
+            result = proc->body(*lambdaEnv);
+        } else {
+            EvalEnv::StackFrame lambdaEnv(*proc->env, args, proc->frame.size, runtimeParent, proc->name);
+            result = proc->body(*lambdaEnv);
+        }
+        if (!isTailCall(result)) {
+            return result;
+        }
+        self = std::move(pendingTailCall.proc);
+        arguments = std::move(pendingTailCall.args);
+        args = arguments;
+        proc = self.get();
     }
-    return evalResult;
 }
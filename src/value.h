@@ -5,31 +5,84 @@
 #ifndef MINI_LISP_VALUE_H
 #define MINI_LISP_VALUE_H
 
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
 #include <utility>
 #include <vector>
 
+#include "bigint.h"
+#include "gc.h"
+#include "number.h"
+#include "pool.h"
+#include "symbol.h"
 #include "token.h"
+#include "word.h"
 
 enum class ValueType {
     BOOLEAN_VALUE,
     NUMERIC_VALUE,
+    FIXNUM_VALUE,
+    BIGNUM_VALUE,
     STRING_VALUE,
     NIL_VALUE,
     SYMBOL_VALUE,
     PAIR_VALUE,
     BUILTIN_PROC_VALUE,
     LAMBDA_VALUE,
+    BYTECODE_PROC_VALUE,
+    MEMO_PROC_VALUE,
+    HASH_TABLE_VALUE,
+    VECTOR_VALUE,
+    F64VECTOR_VALUE,
+    NDARRAY_VALUE,
     CUSTOM_VALUE,
 };
 
+// Type tests compare the ValueType tag against a class's TYPE_MASK, the set
+// of tags its instances (including those of subclasses) can carry
+constexpr uint32_t typeBit(ValueType type) {
+    return uint32_t{1} << static_cast<uint32_t>(type);
+}
+
+template<std::same_as<ValueType>... Types>
+constexpr uint32_t typeMask(Types... types) {
+    return (typeBit(types) | ...);
+}
+
 class Value;
 class EvalEnv;
+namespace Inlining {
+    struct Definition;
+}
+namespace Batch {
+    struct Program;
+}
 
 using ValuePtr = std::shared_ptr<Value>;
-using BuiltinFuncType = std::function<ValuePtr(const std::vector<ValuePtr>&, EvalEnv& env)>;
+
+// The arguments of a call, a view into storage owned by the caller.
+// Braced lists are accepted too, they live until the end of the full expression.
+class Arguments : public std::span<const ValuePtr> {
+public:
+    using std::span<const ValuePtr>::span;
+
+    Arguments() = default;
+    Arguments(std::span<const ValuePtr> span): std::span<const ValuePtr>(span) {}
+    Arguments(std::initializer_list<ValuePtr> list): std::span<const ValuePtr>(list.begin(), list.size()) {}
+};
+
+using BuiltinFuncType = ValuePtr (*)(Arguments params, EvalEnv& env);
+// Entry points of builtins for calls with exactly one or two arguments, no span is built
+using UnaryFuncType = ValuePtr (*)(const ValuePtr& x, EvalEnv& env);
+using BinaryFuncType = ValuePtr (*)(const ValuePtr& x, const ValuePtr& y, EvalEnv& env);
+// A builtin working on unboxed arguments, see word.h. It must return an immediate.
+using WordFuncType = Word (*)(std::span<const Word>);
+// Compiled code, see compiler.h
+using Closure = std::function<ValuePtr(EvalEnv&)>;
 
 template<typename T>
 concept IsConcreteValue = requires(T t) {
@@ -44,6 +97,8 @@ protected:
     explicit Value(ValueType type): type{type} {}
 
 public:
+    static constexpr uint32_t TYPE_MASK = ~uint32_t{0};
+
     virtual ~Value() = default;
 
     ValueType getType() const {
@@ -55,50 +110,101 @@ public:
 
     template<class T> requires std::is_base_of_v<Value, T>
     constexpr bool is() const {
-        return dynamic_cast<const T*>(this) != nullptr;
+        return (T::TYPE_MASK & typeBit(type)) != 0;
     }
 
     template<IsConcreteValue T>
     auto as() const -> std::optional<typename T::element_type> {
         if (is<T>()) {
-            return dynamic_cast<const T*>(this)->getValue();
+            return static_cast<const T*>(this)->getValue();
         } else {
             return std::nullopt;
         }
     }
 
+    // Numbers are flonums (NumericValue, inexact) or integers, which are exact:
+    // fixnums (FixnumValue) and, beyond the fixnum range, bignums (BignumValue)
+    static constexpr uint32_t NUMBER_TYPES = typeMask(ValueType::NUMERIC_VALUE, ValueType::FIXNUM_VALUE, ValueType::BIGNUM_VALUE);
+
+    bool isNumber() const {
+        return (NUMBER_TYPES & typeBit(type)) != 0;
+    }
+
     bool isNumericInteger() const;
     bool isNonEmptyList() const;
     bool isList() const;
 
-    std::optional<std::string> asSymbol() const;
+    std::optional<Symbol> asSymbol() const;
     std::optional<int> asInteger() const;
+    std::optional<double> asNumber() const;
+
+    static ValuePtr fromVector(Arguments values);
 
-    static ValuePtr fromVector(const std::vector<ValuePtr>& values);
+    // (), #t, #f and small integers are immutable, so they are shared
+    // instances that live as long as the process
+    static const ValuePtr& nil();
+    static const ValuePtr& boolean(bool value);
+    static ValuePtr number(double value);
+    // A fixnum if `value` fits one (see Word), otherwise a bignum
+    static ValuePtr integer(int64_t value);
+
+    // Numbers are allocated in the Arena. Values kept beyond the current form
+    // may be promoted: numbers have no identity, so a heap copy can replace them.
+    static ValuePtr promote(ValuePtr value);
 
     virtual bool isEqual(const ValuePtr& other) const = 0;
+    // Equal values (see isEqual) hash equally. Values equal only to themselves hash by address.
+    virtual size_t hash() const {
+        return std::hash<const Value*>()(this);
+    }
+
+    // Reports the values and environments this value holds, see gc.h
+    virtual void trace(GC::Tracer& tracer) const {}
+
+    // This value as a Traceable, for the mutable containers that may close a cycle
+    virtual const GC::Traceable* traceable() const {
+        return nullptr;
+    }
 };
 
-class SelfEvaluatingValue : virtual public Value {};
+class AtomicValue : public Value {
+protected:
+    using Value::Value;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeMask(ValueType::BOOLEAN_VALUE, ValueType::NUMERIC_VALUE, ValueType::FIXNUM_VALUE,
+                                                   ValueType::BIGNUM_VALUE, ValueType::STRING_VALUE, ValueType::NIL_VALUE,
+                                                   ValueType::SYMBOL_VALUE, ValueType::VECTOR_VALUE);
+};
 
-class AtomicValue : virtual public Value {};
+// Every self-evaluating value is atomic
+class SelfEvaluatingValue : public AtomicValue {
+protected:
+    using AtomicValue::AtomicValue;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeMask(ValueType::BOOLEAN_VALUE, ValueType::NUMERIC_VALUE, ValueType::FIXNUM_VALUE,
+                                                   ValueType::BIGNUM_VALUE, ValueType::STRING_VALUE, ValueType::VECTOR_VALUE);
+};
 
 template<ValueType value_type, typename T>
 class ConcreteValue;
 
 using BooleanValue = ConcreteValue<ValueType::BOOLEAN_VALUE, bool>;
 using NumericValue = ConcreteValue<ValueType::NUMERIC_VALUE, double>;
+// Holds values within Word's fixnum range, Value::integer() makes them
+using FixnumValue = ConcreteValue<ValueType::FIXNUM_VALUE, int64_t>;
 using StringValue = ConcreteValue<ValueType::STRING_VALUE, std::string>;
 
 template<ValueType value_type, typename T>
-class ConcreteValue final : public SelfEvaluatingValue, public AtomicValue {
+class ConcreteValue final : public SelfEvaluatingValue {
     T value;
 
 public:
     using element_type = T;
+    static constexpr uint32_t TYPE_MASK = typeBit(value_type);
 
-    explicit ConcreteValue(T value):
-        Value(value_type), SelfEvaluatingValue(), AtomicValue(), value{value} {}
+    explicit ConcreteValue(T value): SelfEvaluatingValue(value_type), value{value} {}
 
     T getValue() const {
         return value;
@@ -107,80 +213,245 @@ public:
     std::string toString() const override;
 
     bool isEqual(const ValuePtr& other) const override {
-        if (auto ptr = std::dynamic_pointer_cast<ConcreteValue>(other)) {
-            return value == ptr->getValue();
+        if constexpr ((NUMBER_TYPES & TYPE_MASK) != 0) {
+            // Numbers compare by value across their types
+            return other->isNumber() && Number::compare(*this, *other) == 0;
+        }
+        if (other->is<ConcreteValue>()) {
+            return value == static_cast<const ConcreteValue&>(*other).getValue();
         }
         return false;
     }
+
+    size_t hash() const override {
+        if constexpr ((NUMBER_TYPES & TYPE_MASK) != 0) {
+            return std::hash<double>()(static_cast<double>(value));
+        } else {
+            return std::hash<T>()(value);
+        }
+    }
+};
+
+class BignumValue final : public SelfEvaluatingValue {
+    BigInt value;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::BIGNUM_VALUE);
+
+    // `value` must be outside the fixnum range, Number::integer() makes bignums
+    explicit BignumValue(BigInt value): SelfEvaluatingValue(ValueType::BIGNUM_VALUE), value{std::move(value)} {}
+
+    const BigInt& getValue() const {
+        return value;
+    }
+
+    std::string toString() const override;
+
+    bool isEqual(const ValuePtr& other) const override {
+        return other->isNumber() && Number::compare(*this, *other) == 0;
+    }
+
+    size_t hash() const override {
+        // Like the flonum it compares equal to, if any
+        return std::hash<double>()(value.toDouble());
+    }
 };
 
 class NilValue final : public AtomicValue {
 public:
-    NilValue(): Value(ValueType::NIL_VALUE), AtomicValue() {}
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::NIL_VALUE);
+
+    NilValue(): AtomicValue(ValueType::NIL_VALUE) {}
 
     std::string toString() const override;
 
     bool isEqual(const ValuePtr& other) const override {
         return other->is<NilValue>();
     }
+
+    size_t hash() const override {
+        return 0;
+    }
 };
 
 class SymbolValue final : public AtomicValue {
-    std::string name;
+    Symbol symbol;
 
 public:
-    explicit SymbolValue(std::string name): Value(ValueType::SYMBOL_VALUE), AtomicValue(), name{std::move(name)} {}
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::SYMBOL_VALUE);
+
+    explicit SymbolValue(Symbol symbol): AtomicValue(ValueType::SYMBOL_VALUE), symbol{symbol} {}
 
-    inline std::string getValue() const {
-        return name;
+    inline const std::string& getValue() const {
+        return symbol.name();
+    }
+
+    inline Symbol getSymbol() const {
+        return symbol;
     }
 
     std::string toString() const override;
 
     bool isEqual(const ValuePtr& other) const override {
-        if (auto ptr = std::dynamic_pointer_cast<SymbolValue>(other)) {
-            return name == ptr->getValue();
+        if (other->is<SymbolValue>()) {
+            return symbol == static_cast<const SymbolValue&>(*other).symbol;
         }
         return false;
     }
+
+    size_t hash() const override {
+        return std::hash<Symbol>()(symbol);
+    }
 };
 
 class PairValue final : public Value {
+public:
+    // Declared first so it fills the tail padding of Value
+    std::optional<TokenPosition> position = std::nullopt;
+
+private:
     ValuePtr car;
     ValuePtr cdr;
 
 public:
-    std::optional<TokenPosition> position = std::nullopt;
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::PAIR_VALUE);
 
-    PairValue(const ValuePtr& car, const ValuePtr& cdr): Value(ValueType::PAIR_VALUE), car{car}, cdr{cdr} {}
+    // Lists outlive the form that builds them often enough, so numbers are
+    // promoted out of the arena rather than pinning their chunk
+    PairValue(const ValuePtr& car, const ValuePtr& cdr): Value(ValueType::PAIR_VALUE), car{promote(car)}, cdr{promote(cdr)} {}
 
-    ValuePtr getCar() const {
+    // Allocates from the cons cell pool, see pool.h
+    static std::shared_ptr<PairValue> create(const ValuePtr& car, const ValuePtr& cdr) {
+        return std::allocate_shared<PairValue>(PoolAllocator<PairValue>(), car, cdr);
+    }
+
+    // Releases the spine of a list iteratively, long lists would overflow the stack otherwise
+    ~PairValue() override;
+
+    const ValuePtr& getCar() const {
         return car;
     }
 
-    ValuePtr getCdr() const {
+    const ValuePtr& getCdr() const {
         return cdr;
     }
 
     std::string toString() const override;
 
     bool isEqual(const ValuePtr& other) const override;
+    size_t hash() const override;
+
+    void trace(GC::Tracer& tracer) const override {
+        tracer(car);
+        tracer(cdr);
+    }
 };
 
-class ProcedureValue : virtual public Value {
+// Fixed-length, mutable, indexed in constant time. Literals #(...) evaluate to themselves.
+// A vector may be stored into itself, which makes it a Traceable (see gc.h).
+// Such cycles print as #(...), compare equal when they unfold alike, and hash
+// a bounded number of elements.
+class VectorValue final : public SelfEvaluatingValue, public std::enable_shared_from_this<VectorValue>, public GC::Traceable {
+    std::vector<ValuePtr> elements;
+
 public:
-    virtual ValuePtr apply(const std::vector<ValuePtr>&, EvalEnv&) = 0;
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::VECTOR_VALUE);
+
+    // Elements are kept, so they are promoted, see Value::promote
+    explicit VectorValue(std::vector<ValuePtr> elements);
+
+    size_t size() const {
+        return elements.size();
+    }
+
+    const ValuePtr& operator[](size_t index) const {
+        return elements[index];
+    }
+
+    void set(size_t index, ValuePtr value) {
+        elements[index] = promote(std::move(value));
+    }
+
+    const std::vector<ValuePtr>& getElements() const {
+        return elements;
+    }
+
+    std::string toString() const override;
+
+    bool isEqual(const ValuePtr& other) const override;
+    size_t hash() const override;
+
+    void trace(GC::Tracer& tracer) const override {
+        for (auto& element : elements) tracer(element);
+    }
+
+    const GC::Traceable* traceable() const override {
+        return this;
+    }
+
+    std::shared_ptr<GC::Traceable> lock() override {
+        return weak_from_this().lock();
+    }
+
+    void clear() override {
+        elements.clear();
+    }
 };
 
-class BuiltinProcValue final : public ProcedureValue {
+class ProcedureValue : public Value {
+protected:
+    using Value::Value;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeMask(ValueType::BUILTIN_PROC_VALUE, ValueType::LAMBDA_VALUE, ValueType::BYTECODE_PROC_VALUE,
+                                                   ValueType::MEMO_PROC_VALUE);
+
+    virtual ValuePtr apply(Arguments args, EvalEnv& env) = 0;
+};
+
+// Everything known about a builtin. `func` takes any number of arguments and
+// reports arity and type errors; the other entry points compute the same for
+// the calls they cover and are optional.
+struct BuiltinSpec {
+    static constexpr size_t VARIADIC = SIZE_MAX;
+
     BuiltinFuncType func;
+    size_t minArgs = 0;
+    size_t maxArgs = VARIADIC;
+    UnaryFuncType unary = nullptr;
+    BinaryFuncType binary = nullptr;
+    WordFuncType word = nullptr; // Computes on unboxed arguments, the VM calls it directly
+    bool pure = false; // No effects, and equal arguments give equal results: calls on constants fold
+};
+
+class BuiltinProcValue final : public ProcedureValue {
+    BuiltinSpec spec;
 
 public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::BUILTIN_PROC_VALUE);
+
     explicit BuiltinProcValue(BuiltinFuncType func):
-        Value(ValueType::BUILTIN_PROC_VALUE), ProcedureValue(), func{std::move(func)} {}
+        ProcedureValue(ValueType::BUILTIN_PROC_VALUE), spec{.func = func} {}
+
+    explicit BuiltinProcValue(const BuiltinSpec& spec):
+        ProcedureValue(ValueType::BUILTIN_PROC_VALUE), spec{spec} {}
+
+    const BuiltinSpec& getSpec() const {
+        return spec;
+    }
 
-    inline ValuePtr apply(const std::vector<ValuePtr>& params, EvalEnv& env) override {
-        return func(params, env);
+    WordFuncType getWordFunc() const {
+        return spec.word;
+    }
+
+    bool accepts(size_t argc) const {
+        return spec.minArgs <= argc && argc <= spec.maxArgs;
+    }
+
+    inline ValuePtr apply(Arguments params, EvalEnv& env) override {
+        if (params.size() == 1 && spec.unary) return spec.unary(params[0], env);
+        if (params.size() == 2 && spec.binary) return spec.binary(params[0], params[1], env);
+        return spec.func(params, env);
     }
 
     inline std::string toString() const override {
@@ -192,32 +463,88 @@ public:
     }
 };
 
+// The frame a procedure body runs in, see Compiler::Scope
+struct FrameLayout {
+    size_t size = 0;      // Parameters plus internal definitions
+    bool captured = true; // Whether closures created in the body may keep the frame alive
+};
+
 class LambdaValue final : public ProcedureValue {
 private:
     std::optional<std::string> name;
     std::shared_ptr<EvalEnv> env;
-    std::vector<std::string> params;
-    std::vector<ValuePtr> body;
+    std::vector<Symbol> params;
+    Closure body;
+    FrameLayout frame;
+    std::shared_ptr<const Inlining::Definition> definition; // Set if call sites may expand the body
+    std::shared_ptr<const Batch::Program> program; // Set if the body can run over arrays, see batch.h
 
 public:
-    LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<std::string> params, std::vector<ValuePtr> body):
-        Value(ValueType::LAMBDA_VALUE), ProcedureValue(), env{std::move(env)}, params{std::move(params)}, body{std::move(body)} {}
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::LAMBDA_VALUE);
+
+    LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<Symbol> params, Closure body, FrameLayout frame,
+                std::shared_ptr<const Batch::Program> program = nullptr):
+        ProcedureValue(ValueType::LAMBDA_VALUE), env{std::move(env)}, params{std::move(params)}, body{std::move(body)}, frame{frame},
+        program{std::move(program)} {}
 
-    LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<std::string> params, std::vector<ValuePtr> body, std::string name):
-        Value(ValueType::LAMBDA_VALUE), ProcedureValue(), name{std::move(name)}, env{std::move(env)}, params{std::move(params)}, body{std::move(body)} {}
+    LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<Symbol> params, Closure body, FrameLayout frame, std::string name,
+                std::shared_ptr<const Inlining::Definition> definition = nullptr, std::shared_ptr<const Batch::Program> program = nullptr):
+        ProcedureValue(ValueType::LAMBDA_VALUE), name{std::move(name)}, env{std::move(env)}, params{std::move(params)}, body{std::move(body)},
+        frame{frame}, definition{std::move(definition)}, program{std::move(program)} {}
+
+    // Compiles the body forms on construction, free variables refer to the global frame
+    LambdaValue(std::shared_ptr<EvalEnv> env, std::vector<Symbol> params, const std::vector<ValuePtr>& body);
 
 
     std::string toString() const override;
 
-    ValuePtr apply(const std::vector<ValuePtr>& args, EvalEnv& currentEnv) override;
+    // Runs the body, then any tail calls it hands back, in constant C++ stack space
+    ValuePtr apply(Arguments args, EvalEnv& currentEnv) override;
+
+    // A call in tail position of a body does not apply the procedure itself: it
+    // stashes the call and returns a marker to the apply() loop running the body
+    static ValuePtr tailCall(std::shared_ptr<LambdaValue> proc, std::vector<ValuePtr> args);
+    static bool isTailCall(const ValuePtr& value);
 
     bool isEqual(const ValuePtr &other) const override {
         return this == other.get();
     }
 
+    void trace(GC::Tracer& tracer) const override;
+
     std::string getName() const {
         return name.value_or("<anonymous>");
     }
+
+    // The frame the procedure was created in
+    const std::shared_ptr<EvalEnv>& getEnv() const {
+        return env;
+    }
+
+    const std::shared_ptr<const Batch::Program>& getProgram() const {
+        return program;
+    }
+
+    // Whether this is the procedure `definition` evaluates to in `globalEnv`
+    bool isInstanceOf(const Inlining::Definition* definition, const EvalEnv& globalEnv) const {
+        return this->definition.get() == definition && env.get() == &globalEnv;
+    }
 };
 
+// Downcast checked against the type tag, null if `value` is not a T
+template<class T> requires std::is_base_of_v<Value, T>
+std::shared_ptr<T> valueCast(const ValuePtr& value) {
+    return value && value->is<T>() ? std::static_pointer_cast<T>(value) : nullptr;
+}
+
+template<class T> requires std::is_base_of_v<Value, T>
+const T* valueCast(const Value* value) {
+    return value && value->is<T>() ? static_cast<const T*>(value) : nullptr;
+}
+
+template<class T> requires std::is_base_of_v<Value, T>
+T* valueCast(Value* value) {
+    return value && value->is<T>() ? static_cast<T*>(value) : nullptr;
+}
+
 #endif //MINI_LISP_VALUE_H
@@ -0,0 +1,82 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+
+#ifndef MINI_LISP_BYTECODE_H
+#define MINI_LISP_BYTECODE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../value.h"
+
+namespace VM {
+    // Every instruction is one code word followed by its operands (also code words).
+    // Jump targets are absolute code offsets.
+    enum class OpCode : uint32_t {
+        CONST,          // k          push constants[k]
+        LOCAL,          // slot       push the current frame's slot
+        UPVALUE,        // depth slot push a slot of an enclosing frame
+        GLOBAL,         // g          push the global binding described by globals[g]
+        SET_LOCAL,      // slot       pop into the current frame's slot
+        DEFINE_GLOBAL,  // g          pop into a global binding
+        POP,            //            drop the top of the stack
+        JUMP,           // target
+        JUMP_IF_FALSE,  // target     pop, jump if #f
+        JUMP_IF_FALSE_KEEP, // target jump if the top is #f, otherwise pop it
+        JUMP_IF_TRUE_KEEP,  // target jump if the top is not #f, otherwise pop it
+        CALL,           // argc       call the procedure below the arguments
+        TAIL_CALL,      // argc       like CALL, but a compiled callee replaces the current activation
+        RETURN,         //            return the top of the stack
+        CLOSURE,        // p          push a procedure for protos[p] capturing the current frame
+        CONS,           //            pop cdr and car, push their pair
+        FAIL,           // k          throw a LispError with the message constants[k]
+        COUNT_
+    };
+
+    // A word as the VM stores it, with the reference keeping an object word's
+    // value alive. Immediates carry no owner, so they cost no allocation.
+    struct Cell {
+        Word word;
+        ValuePtr owner;
+
+        Cell() = default;
+
+        explicit Cell(ValuePtr value): word{Word::from(value)} {
+            if (word.isObject()) owner = std::move(value);
+        }
+
+        explicit Cell(Word word): word{word} {}
+
+        ValuePtr toValue() const {
+            return word.toValue(owner);
+        }
+    };
+
+    // Per-instruction cache of a global lookup, see EvalEnv::lookupSlot
+    struct GlobalRef {
+        Symbol name;
+        const ValuePtr* slot = nullptr;
+        uint64_t epoch = 0;
+    };
+
+    // A compiled function body (or top level form)
+    struct Proto {
+        std::string name = "<anonymous>";
+        size_t arity = 0;
+        size_t frameSize = 0;   // parameters first, then let and internal define slots
+        size_t maxStack = 0;
+
+        std::vector<uint32_t> code;
+        std::vector<Cell> constants;
+        mutable std::vector<GlobalRef> globals;
+        std::vector<std::shared_ptr<const Proto>> protos;
+        std::vector<Symbol> slotNames;
+    };
+
+    using ProtoPtr = std::shared_ptr<const Proto>;
+}
+
+#endif //MINI_LISP_BYTECODE_H
@@ -0,0 +1,337 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+
+#include "vm.h"
+
+#include <array>
+
+#include "vm_compiler.h"
+#include "../error.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MINI_LISP_COMPUTED_GOTO 1
+#endif
+
+namespace VM {
+    // One running procedure. Activations live in a heap vector rather than on
+    // the native stack, so the depth of Lisp recursion is bounded by
+    // stackLimit bytes instead of the C++ stack.
+    struct Activation {
+        ValuePtr callee;        // Keeps the running procedure alive, null at top level
+        const Proto* proto;
+        FramePtr frame;
+        EvalEnv* globals;
+        const uint32_t* ip;     // Saved while a callee runs
+        size_t base;            // Operand window [base, base + proto->maxStack)
+        size_t bytes;           // Estimated footprint counted against stackLimit
+    };
+
+    class Machine {
+        std::vector<Cell> stack = std::vector<Cell>(1024);
+        size_t sp = 0; // Where the operands of a nested run() start
+        std::vector<Activation> activations;
+        size_t stackUsed = 0;
+
+        void enter(ValuePtr callee, const Proto& proto, FramePtr frame, EvalEnv* globals, size_t base);
+        void leave();
+        static Cell callBuiltin(Cell* callee, size_t argc, EvalEnv& globals);
+        template<typename It>
+        static FramePtr bindArguments(const BytecodeProcValue& proc, It args, size_t argc);
+
+        // Runs until the activation on top when called returns
+        Cell run();
+
+    public:
+        size_t stackLimit = DEFAULT_STACK_LIMIT;
+
+        static Machine& instance() {
+            static Machine machine;
+            return machine;
+        }
+
+        ValuePtr execute(const ProtoPtr& proto, EvalEnv& globals);
+        ValuePtr call(const BytecodeProcValue& proc, const ValuePtr* args, size_t argc);
+    };
+
+    void setStackLimit(size_t bytes) {
+        Machine::instance().stackLimit = bytes;
+    }
+
+    static LispError undefinedVariable(Symbol name) {
+        return LispError("Variable " + name.name() + " not defined.");
+    }
+
+    void Machine::enter(ValuePtr callee, const Proto& proto, FramePtr frame, EvalEnv* globals, size_t base) {
+        auto bytes = sizeof(Activation) + sizeof(Frame) + (proto.frameSize + proto.maxStack) * sizeof(Cell);
+        if (stackUsed + bytes > stackLimit) {
+            throw LispError("Maximum recursion depth exceeded.");
+        }
+        if (stack.size() < base + proto.maxStack) {
+            stack.resize(std::max(stack.size() * 2, base + proto.maxStack));
+        }
+        stackUsed += bytes;
+        activations.push_back({std::move(callee), &proto, std::move(frame), globals, proto.code.data(), base, bytes});
+    }
+
+    void Machine::leave() {
+        auto& activation = activations.back();
+        std::fill_n(stack.begin() + activation.base, activation.proto->maxStack, Cell());
+        stackUsed -= activation.bytes;
+        activations.pop_back();
+    }
+
+    template<typename It>
+    FramePtr Machine::bindArguments(const BytecodeProcValue& proc, It args, size_t argc) {
+        const auto& proto = *proc.getProto();
+        if (argc != proto.arity) {
+            throw LispError("Procedure expected " + std::to_string(proto.arity) + " arguments, but got " + std::to_string(argc));
+        }
+        auto frame = std::make_shared<Frame>(&proto, proc.getFrame());
+        for (size_t i = 0; i < argc; i++, ++args) {
+            frame->slots[i] = Cell(*args);
+        }
+        return frame;
+    }
+
+    Cell Machine::callBuiltin(Cell* callee, size_t argc, EvalEnv& globals) {
+        constexpr size_t INLINE_ARGS = 8;
+        auto builtin = valueCast<BuiltinProcValue>(callee->owner.get());
+        if (builtin && builtin->getWordFunc()) {
+            // Word-level builtins take the unboxed arguments as they are. An
+            // undefined result means they left the call to the boxed builtin.
+            std::array<Word, INLINE_ARGS> inlineArgs;
+            std::vector<Word> args;
+            Word* words = inlineArgs.data();
+            if (argc > INLINE_ARGS) {
+                args.resize(argc);
+                words = args.data();
+            }
+            for (size_t i = 0; i < argc; i++) words[i] = callee[i + 1].word;
+            auto result = builtin->getWordFunc()(std::span<const Word>(words, argc));
+            if (!result.isUndefined()) return Cell(result);
+        }
+        if (builtin) {
+            auto& spec = builtin->getSpec();
+            if (argc == 1 && spec.unary) {
+                return Cell(spec.unary(callee[1].toValue(), globals));
+            }
+            if (argc == 2 && spec.binary) {
+                return Cell(spec.binary(callee[1].toValue(), callee[2].toValue(), globals));
+            }
+        }
+        auto procedure = valueCast<ProcedureValue>(callee->owner);
+        if (!procedure) {
+            throw LispError("Not a procedure: " + callee->toValue()->toString());
+        }
+        if (argc <= INLINE_ARGS) {
+            std::array<ValuePtr, INLINE_ARGS> args;
+            for (size_t i = 0; i < argc; i++) args[i] = callee[i + 1].toValue();
+            return Cell(procedure->apply(Arguments(args.data(), argc), globals));
+        }
+        std::vector<ValuePtr> args;
+        args.reserve(argc);
+        for (size_t i = 1; i <= argc; i++) args.push_back(callee[i].toValue());
+        return Cell(procedure->apply(args, globals));
+    }
+
+    ValuePtr Machine::execute(const ProtoPtr& proto, EvalEnv& globals) {
+        enter(nullptr, *proto, std::make_shared<Frame>(proto.get(), nullptr), &globals, sp);
+        return run().toValue();
+    }
+
+    ValuePtr Machine::call(const BytecodeProcValue& proc, const ValuePtr* args, size_t argc) {
+        auto frame = bindArguments(proc, args, argc);
+        enter(nullptr, *proc.getProto(), std::move(frame), proc.getGlobals().get(), sp); // The caller keeps proc alive
+        return run().toValue();
+    }
+
+    Cell Machine::run() {
+        const size_t entry = activations.size() - 1;
+        const size_t entrySp = sp;
+        // Unwinds the activations of this run when leaving by an exception
+        struct Unwind {
+            Machine& machine;
+            size_t entry, sp;
+            ~Unwind() {
+                while (machine.activations.size() > entry) machine.leave();
+                machine.sp = sp;
+            }
+        } unwind {*this, entry, entrySp};
+
+        // Registers of the running activation, reloaded whenever it changes
+        const Proto* proto;
+        const uint32_t* code;
+        const uint32_t* ip;
+        Frame* frame;
+        EvalEnv* globals;
+        Cell* top;
+        auto load = [&](Cell* operands) {
+            auto& activation = activations.back();
+            proto = activation.proto;
+            code = proto->code.data();
+            ip = activation.ip;
+            frame = activation.frame.get();
+            globals = activation.globals;
+            top = operands;
+        };
+        load(stack.data() + activations.back().base);
+
+#ifdef MINI_LISP_COMPUTED_GOTO
+        static const void* const DISPATCH[] = {
+            &&op_CONST, &&op_LOCAL, &&op_UPVALUE, &&op_GLOBAL, &&op_SET_LOCAL, &&op_DEFINE_GLOBAL, &&op_POP,
+            &&op_JUMP, &&op_JUMP_IF_FALSE, &&op_JUMP_IF_FALSE_KEEP, &&op_JUMP_IF_TRUE_KEEP,
+            &&op_CALL, &&op_TAIL_CALL, &&op_RETURN, &&op_CLOSURE, &&op_CONS, &&op_FAIL,
+        };
+        static_assert(std::size(DISPATCH) == static_cast<size_t>(OpCode::COUNT_));
+#define VM_NEXT() goto *DISPATCH[*ip++]
+#define VM_OP(name) op_##name:
+        VM_NEXT();
+#else
+#define VM_NEXT() continue
+#define VM_OP(name) case OpCode::name:
+        while (true) {
+            switch (static_cast<OpCode>(*ip++)) {
+#endif
+        VM_OP(CONST) {
+            *top++ = proto->constants[*ip++];
+            VM_NEXT();
+        }
+        VM_OP(LOCAL) {
+            auto slot = *ip++;
+            const auto& cell = frame->slots[slot];
+            if (cell.word.isUndefined()) throw undefinedVariable(proto->slotNames[slot]);
+            *top++ = cell;
+            VM_NEXT();
+        }
+        VM_OP(UPVALUE) {
+            auto depth = *ip++;
+            auto slot = *ip++;
+            const Frame* enclosing = frame;
+            while (depth--) enclosing = enclosing->parent.get();
+            const auto& cell = enclosing->slots[slot];
+            if (cell.word.isUndefined()) throw undefinedVariable(enclosing->proto->slotNames[slot]);
+            *top++ = cell;
+            VM_NEXT();
+        }
+        VM_OP(GLOBAL) {
+            auto& ref = proto->globals[*ip++];
+            if (!ref.slot || ref.epoch != EvalEnv::bindingsEpoch()) {
+                ref.slot = globals->lookupSlot(ref.name);
+                ref.epoch = EvalEnv::bindingsEpoch();
+                if (!ref.slot) throw undefinedVariable(ref.name);
+            }
+            *top++ = Cell(*ref.slot);
+            VM_NEXT();
+        }
+        VM_OP(SET_LOCAL) {
+            frame->slots[*ip++] = std::move(*--top);
+            VM_NEXT();
+        }
+        VM_OP(DEFINE_GLOBAL) {
+            auto value = (--top)->toValue();
+            top->owner.reset();
+            globals->defineBinding(proto->globals[*ip++].name, std::move(value));
+            VM_NEXT();
+        }
+        VM_OP(POP) {
+            (--top)->owner.reset();
+            VM_NEXT();
+        }
+        VM_OP(JUMP) {
+            ip = code + *ip;
+            VM_NEXT();
+        }
+        VM_OP(JUMP_IF_FALSE) {
+            auto target = *ip++;
+            auto condition = (--top)->word;
+            top->owner.reset();
+            if (condition.isFalse()) ip = code + target;
+            VM_NEXT();
+        }
+        VM_OP(JUMP_IF_FALSE_KEEP) {
+            auto target = *ip++;
+            if (top[-1].word.isFalse()) ip = code + target;
+            else (--top)->owner.reset();
+            VM_NEXT();
+        }
+        VM_OP(JUMP_IF_TRUE_KEEP) {
+            auto target = *ip++;
+            if (!top[-1].word.isFalse()) ip = code + target;
+            else (--top)->owner.reset();
+            VM_NEXT();
+        }
+        VM_OP(CALL)
+        VM_OP(TAIL_CALL) {
+            bool tail = static_cast<OpCode>(ip[-1]) == OpCode::TAIL_CALL;
+            auto argc = *ip++;
+            auto callee = top - argc - 1;
+            if (auto bytecode = valueCast<BytecodeProcValue>(callee->owner.get())) {
+                auto frame = bindArguments(*bytecode, std::make_move_iterator(callee + 1), argc);
+                auto procedure = std::move(callee->owner);
+                size_t base;
+                if (tail) {
+                    // Replace the current activation, keeping its operand window
+                    base = activations.back().base;
+                    leave();
+                } else {
+                    // The callee's operands start where the call's were
+                    base = callee - stack.data();
+                    activations.back().ip = ip;
+                }
+                enter(std::move(procedure), *bytecode->getProto(), std::move(frame), bytecode->getGlobals().get(), base);
+                load(stack.data() + base);
+                VM_NEXT();
+            }
+            // Other procedures run on the native stack and return right away
+            auto calleeIndex = callee - stack.data();
+            sp = top - stack.data(); // Nested runs start above our operands
+            auto result = callBuiltin(callee, argc, *globals);
+            // The stack may have been reallocated by the call
+            top = stack.data() + calleeIndex;
+            for (size_t i = 0; i <= argc; i++) top[i].owner.reset();
+            *top++ = std::move(result);
+            VM_NEXT();
+        }
+        VM_OP(RETURN) {
+            auto result = std::move(*--top);
+            auto base = activations.back().base;
+            leave();
+            if (activations.size() == entry) {
+                return result;
+            }
+            load(stack.data() + base);
+            *top++ = std::move(result);
+            VM_NEXT();
+        }
+        VM_OP(CLOSURE) {
+            *top++ = Cell(std::make_shared<BytecodeProcValue>(proto->protos[*ip++], activations.back().frame, activations.back().globals->shared_from_this()));
+            VM_NEXT();
+        }
+        VM_OP(CONS) {
+            auto cdr = std::move(*--top);
+            top[-1] = Cell(PairValue::create(top[-1].toValue(), cdr.toValue()));
+            VM_NEXT();
+        }
+        VM_OP(FAIL) {
+            throw LispError(*proto->constants[*ip++].owner->as<StringValue>());
+        }
+#ifndef MINI_LISP_COMPUTED_GOTO
+            case OpCode::COUNT_:
+                break;
+            }
+            throw LispError("Invalid opcode.");
+        }
+#endif
+#undef VM_NEXT
+#undef VM_OP
+    }
+
+    ValuePtr eval(const ValuePtr& expr, EvalEnv& env) {
+        return Machine::instance().execute(BytecodeCompiler::compileTopLevel(expr), env);
+    }
+}
+
+ValuePtr BytecodeProcValue::apply(Arguments args, EvalEnv& env) {
+    return VM::Machine::instance().call(*this, args.data(), args.size());
+}
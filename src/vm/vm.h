@@ -0,0 +1,87 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+
+#ifndef MINI_LISP_VM_H
+#define MINI_LISP_VM_H
+
+#include "bytecode.h"
+#include "../eval_env.h"
+
+namespace VM {
+    // Activation record of a compiled procedure. Frames are heap allocated
+    // because closures capture the frame they are created in.
+    struct Frame : std::enable_shared_from_this<Frame>, GC::Traceable {
+        const Proto* proto;
+        std::shared_ptr<Frame> parent;
+        std::vector<Cell> slots; // Unassigned slots hold undefined words
+
+        Frame(const Proto* proto, std::shared_ptr<Frame> parent):
+            proto{proto}, parent{std::move(parent)}, slots(proto->frameSize) {}
+
+        std::shared_ptr<GC::Traceable> lock() override {
+            return weak_from_this().lock();
+        }
+
+        void trace(GC::Tracer& tracer) const override {
+            tracer(parent);
+            for (const auto& slot : slots) tracer(slot.owner);
+        }
+
+        void clear() override {
+            parent.reset();
+            slots.clear();
+        }
+    };
+    using FramePtr = std::shared_ptr<Frame>;
+
+    // Compiles `expr` to bytecode and runs it with `env` providing the globals
+    ValuePtr eval(const ValuePtr& expr, EvalEnv& env);
+
+    constexpr size_t DEFAULT_STACK_LIMIT = size_t{1} << 30;
+
+    // Memory the VM may spend on activations before deep recursion fails with a LispError
+    void setStackLimit(size_t bytes);
+}
+
+class BytecodeProcValue final : public ProcedureValue {
+    VM::ProtoPtr proto;
+    VM::FramePtr frame;
+    std::shared_ptr<EvalEnv> globals;
+
+public:
+    static constexpr uint32_t TYPE_MASK = typeBit(ValueType::BYTECODE_PROC_VALUE);
+
+    BytecodeProcValue(VM::ProtoPtr proto, VM::FramePtr frame, std::shared_ptr<EvalEnv> globals):
+        ProcedureValue(ValueType::BYTECODE_PROC_VALUE),
+        proto{std::move(proto)}, frame{std::move(frame)}, globals{std::move(globals)} {}
+
+    const VM::ProtoPtr& getProto() const {
+        return proto;
+    }
+
+    const VM::FramePtr& getFrame() const {
+        return frame;
+    }
+
+    const std::shared_ptr<EvalEnv>& getGlobals() const {
+        return globals;
+    }
+
+    ValuePtr apply(Arguments args, EvalEnv& env) override;
+
+    std::string toString() const override {
+        return "#<procedure>";
+    }
+
+    bool isEqual(const ValuePtr &other) const override {
+        return this == other.get();
+    }
+
+    void trace(GC::Tracer& tracer) const override {
+        tracer(frame);
+        tracer(globals);
+    }
+};
+
+#endif //MINI_LISP_VM_H
@@ -0,0 +1,447 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+
+#include "vm_compiler.h"
+
+#include <ranges>
+
+#include "../error.h"
+#include "../utils/utils.h"
+
+namespace VM {
+    const std::unordered_map<Symbol, BytecodeCompiler::FormCompiler> BytecodeCompiler::FORMS {
+        {"define", &BytecodeCompiler::compileDefine},
+        {"quote", &BytecodeCompiler::compileQuote},
+        {"if", &BytecodeCompiler::compileIf},
+        {"cond", &BytecodeCompiler::compileCond},
+        {"let", &BytecodeCompiler::compileLet},
+        {"begin", &BytecodeCompiler::compileBegin},
+        {"quasiquote", &BytecodeCompiler::compileQuasiquote},
+        {"unquote", &BytecodeCompiler::compileUnquote},
+        {"and", &BytecodeCompiler::compileAnd},
+        {"or", &BytecodeCompiler::compileOr},
+        {"lambda", &BytecodeCompiler::compileLambda},
+        {"λ", &BytecodeCompiler::compileLambda},
+    };
+
+    static std::vector<Symbol> lambdaParameters(const ValuePtr& list) {
+        auto viewLambdaParams = list->toVector()
+                                | std::views::transform([](const ValuePtr& v) { return v->asSymbol(); })
+                                | std::views::transform([](const std::optional<Symbol>& s) {
+            if (!s) {
+                throw LispError("lambda: Arguments must be symbols.");
+            }
+            return *s;
+        });
+        return {viewLambdaParams.begin(), viewLambdaParams.end()};
+    }
+
+    // Whether `value` has an unquote to fill in at quasiquote depth `depth`.
+    // A nested quasiquote goes one level deeper, an unquote one level back out,
+    // and only the unquotes at depth 0 are evaluated.
+    static bool containsUnquote(const ValuePtr& value, size_t depth) {
+        if (auto pair = valueCast<PairValue>(value)) {
+            auto head = pair->getCar()->asSymbol();
+            if (head == Symbol::UNQUOTE) {
+                return depth == 0 || containsUnquote(pair->getCdr(), depth - 1);
+            }
+            if (head == Symbol::QUASIQUOTE) return containsUnquote(pair->getCdr(), depth + 1);
+            return containsUnquote(pair->getCar(), depth) || containsUnquote(pair->getCdr(), depth);
+        }
+        return false;
+    }
+
+    // The depth the operands of a form headed by `head` are at
+    static size_t operandDepth(const std::optional<Symbol>& head, size_t depth) {
+        if (head == Symbol::QUASIQUOTE) return depth + 1;
+        if (head == Symbol::UNQUOTE) return depth - 1;
+        return depth;
+    }
+
+    // Names an internal define in `expr` would bind in the enclosing body
+    static void collectDefines(const ValuePtr& expr, std::vector<Symbol>& names) {
+        if (!expr->isNonEmptyList()) return;
+        auto pair = valueCast<PairValue>(expr);
+        auto head = pair->getCar()->asSymbol();
+        if (!head) return;
+        auto operands = pair->getCdr()->toVector();
+        if (*head == Symbol::DEFINE && !operands.empty()) {
+            if (auto name = operands[0]->asSymbol()) {
+                names.push_back(*name);
+            } else if (auto target = valueCast<PairValue>(operands[0])) {
+                if (auto function = target->getCar()->asSymbol()) names.push_back(*function);
+            }
+        } else if (*head == Symbol::BEGIN || *head == Symbol::IF || *head == Symbol::AND || *head == Symbol::OR) {
+            for (const auto& operand : operands) collectDefines(operand, names);
+        } else if (*head == Symbol::COND) {
+            for (const auto& clause : operands) {
+                if (!clause->isList()) continue;
+                for (const auto& operand : clause->toVector()) collectDefines(operand, names);
+            }
+        }
+    }
+
+    ProtoPtr BytecodeCompiler::compileTopLevel(const ValuePtr& expr) {
+        BytecodeCompiler compiler;
+        Function toplevel {std::make_shared<Proto>(), nullptr, {}, 0};
+        toplevel.proto->name = "<toplevel>";
+        compiler.current = &toplevel;
+        compiler.compileExpr(expr);
+        compiler.emit(OpCode::RETURN, -1);
+        toplevel.proto->frameSize = toplevel.proto->slotNames.size();
+        return toplevel.proto;
+    }
+
+    void BytecodeCompiler::adjustStack(int stackEffect) {
+        current->depth += stackEffect;
+        current->proto->maxStack = std::max(current->proto->maxStack, current->depth);
+    }
+
+    void BytecodeCompiler::emit(OpCode op, int stackEffect) {
+        current->proto->code.push_back(static_cast<uint32_t>(op));
+        adjustStack(stackEffect);
+    }
+
+    void BytecodeCompiler::emitOperand(uint32_t operand) {
+        current->proto->code.push_back(operand);
+    }
+
+    size_t BytecodeCompiler::emitJump(OpCode op, int stackEffect) {
+        emit(op, stackEffect);
+        emitOperand(0);
+        return current->proto->code.size() - 1;
+    }
+
+    void BytecodeCompiler::patchJump(size_t at) {
+        current->proto->code[at] = current->proto->code.size();
+    }
+
+    uint32_t BytecodeCompiler::addConstant(const ValuePtr& value) {
+        current->proto->constants.emplace_back(value);
+        return current->proto->constants.size() - 1;
+    }
+
+    uint32_t BytecodeCompiler::addGlobal(Symbol name) {
+        auto& globals = current->proto->globals;
+        for (size_t i = 0; i < globals.size(); i++) {
+            if (globals[i].name == name) return i;
+        }
+        globals.push_back({name});
+        return globals.size() - 1;
+    }
+
+    uint32_t BytecodeCompiler::declareSlot(Scope& scope, Symbol name) {
+        auto& slotNames = current->proto->slotNames;
+        slotNames.push_back(name);
+        return scope.slots[name] = slotNames.size() - 1;
+    }
+
+    void BytecodeCompiler::declareDefines(Scope& scope, const std::vector<ValuePtr>& body) {
+        std::vector<Symbol> names;
+        for (const auto& expr : body) collectDefines(expr, names);
+        for (const auto& name : names) {
+            if (!scope.slots.contains(name)) declareSlot(scope, name);
+        }
+    }
+
+    void BytecodeCompiler::compileExpr(const ValuePtr& expr, bool tail) {
+        if (expr->is<SelfEvaluatingValue>()) {
+            return compileConstant(expr);
+        }
+        if (expr->is<NilValue>()) {
+            return compileFail("Evaluating nil is prohibited.");
+        }
+        if (auto symbol = expr->asSymbol()) {
+            return compileSymbol(*symbol);
+        }
+        if (expr->is<PairValue>()) {
+            if (!expr->isList()) return compileFail("Malformed list " + expr->toString());
+            auto pair = valueCast<PairValue>(expr);
+            if (auto name = pair->getCar()->asSymbol()) {
+                auto form = FORMS.find(*name);
+                if (form != FORMS.end()) { // Special form
+                    // Like the tree walker, a malformed form only fails once it is evaluated
+                    auto codeSize = current->proto->code.size();
+                    auto depth = current->depth;
+                    auto scopes = current->scopes.size();
+                    try {
+                        (this->*form->second)(pair->getCdr()->toVector(), tail);
+                    } catch (const LispError& e) {
+                        current->proto->code.resize(codeSize);
+                        current->depth = depth;
+                        current->scopes.resize(scopes);
+                        compileFail(e.what());
+                    }
+                    return;
+                }
+            }
+            // Not special form, treat as built-in procedure call or lambda call
+            return compileCall(expr, tail);
+        }
+        compileFail("Unimplemented");
+    }
+
+    void BytecodeCompiler::compileFail(const std::string& message) {
+        emit(OpCode::FAIL, 1);
+        emitOperand(addConstant(std::make_shared<StringValue>(message)));
+    }
+
+    void BytecodeCompiler::compileConstant(const ValuePtr& value) {
+        emit(OpCode::CONST, 1);
+        emitOperand(addConstant(value));
+    }
+
+    void BytecodeCompiler::compileSymbol(Symbol name) {
+        size_t depth = 0;
+        for (auto function = current; function; function = function->enclosing, depth++) {
+            for (auto scope = function->scopes.rbegin(); scope != function->scopes.rend(); ++scope) {
+                auto slot = scope->slots.find(name);
+                if (slot == scope->slots.end()) continue;
+                if (depth == 0) {
+                    emit(OpCode::LOCAL, 1);
+                } else {
+                    emit(OpCode::UPVALUE, 1);
+                    emitOperand(depth);
+                }
+                emitOperand(slot->second);
+                return;
+            }
+        }
+        emit(OpCode::GLOBAL, 1);
+        emitOperand(addGlobal(name));
+    }
+
+    void BytecodeCompiler::compileCall(const ValuePtr& expr, bool tail) {
+        auto elements = expr->toVector();
+        for (const auto& element : elements) {
+            compileExpr(element);
+        }
+        auto argc = static_cast<int>(elements.size()) - 1;
+        emit(tail ? OpCode::TAIL_CALL : OpCode::CALL, -argc);
+        emitOperand(argc);
+    }
+
+    void BytecodeCompiler::compileBody(const std::vector<ValuePtr>& body, bool tail) {
+        if (body.empty()) {
+            return compileConstant(Value::nil());
+        }
+        for (size_t i = 0; i < body.size(); i++) {
+            if (i != 0) emit(OpCode::POP, -1);
+            compileExpr(body[i], tail && i + 1 == body.size());
+        }
+    }
+
+    ProtoPtr BytecodeCompiler::compileFunction(const std::string& name, const std::vector<Symbol>& params,
+                                               const std::vector<ValuePtr>& body) {
+        Function function {std::make_shared<Proto>(), current, {}, 0};
+        function.proto->name = name;
+        function.proto->arity = params.size();
+
+        auto enclosing = current;
+        current = &function;
+        try {
+            auto& scope = function.scopes.emplace_back();
+            for (const auto& param : params) {
+                declareSlot(scope, param);
+            }
+            declareDefines(scope, body);
+            compileBody(body, true);
+            emit(OpCode::RETURN, -1);
+        } catch (...) {
+            current = enclosing;
+            throw;
+        }
+        current = enclosing;
+
+        function.proto->frameSize = function.proto->slotNames.size();
+        current->proto->protos.push_back(function.proto);
+        return function.proto;
+    }
+
+    void BytecodeCompiler::compileDefine(const std::vector<ValuePtr>& params, bool tail) {
+        if (params.size() == 0) throw LispError("define: expected at least 2 arguments.");
+        std::optional<Symbol> name;
+        if (auto symbol = params[0]->asSymbol()) {
+            Utils::checkParams("define", 2, params);
+            name = symbol;
+            compileExpr(params[1]);
+        } else if (auto pair = valueCast<PairValue>(params[0])) {
+            if (!pair->getCar()->is<SymbolValue>()) throw LispError("define: Invalid expression.");
+            if (params.size() < 2) {
+                throw LispError("define: expected at least 2 arguments.");
+            }
+            name = pair->getCar()->asSymbol();
+            auto proto = compileFunction(name->name(), lambdaParameters(pair->getCdr()), std::vector(params.begin() + 1, params.end()));
+            emit(OpCode::CLOSURE, 1);
+            emitOperand(current->proto->protos.size() - 1);
+        } else {
+            throw LispError("define: Invalid expression.");
+        }
+
+        if (current->scopes.empty()) {
+            emit(OpCode::DEFINE_GLOBAL, -1);
+            emitOperand(addGlobal(*name));
+        } else {
+            auto& scope = current->scopes.back();
+            auto slot = scope.slots.find(*name);
+            emit(OpCode::SET_LOCAL, -1);
+            emitOperand(slot != scope.slots.end() ? slot->second : declareSlot(scope, *name));
+        }
+        compileConstant(Value::nil());
+    }
+
+    void BytecodeCompiler::compileQuote(const std::vector<ValuePtr>& params, bool tail) {
+        Utils::checkParams("quote", 1, params);
+        compileConstant(params[0]);
+    }
+
+    void BytecodeCompiler::compileIf(const std::vector<ValuePtr>& params, bool tail) {
+        Utils::checkParams("if", 2, 3, params);
+        compileExpr(params[0]);
+        auto toAlternative = emitJump(OpCode::JUMP_IF_FALSE, -1);
+        compileExpr(params[1], tail);
+        auto toEnd = emitJump(OpCode::JUMP, 0);
+        adjustStack(-1);
+        patchJump(toAlternative);
+        if (params.size() == 3) {
+            compileExpr(params[2], tail);
+        } else {
+            compileConstant(Value::nil()); // Undefined behavior, return ()
+        }
+        patchJump(toEnd);
+    }
+
+    void BytecodeCompiler::compileCond(const std::vector<ValuePtr>& params, bool tail) {
+        std::vector<size_t> toEnd;
+        bool hasElse = false;
+        for (auto it = params.begin(); it != params.end(); it++) {
+            auto pair = valueCast<PairValue>(*it);
+            if (!pair) throw LispError("cond: Invalid expression.");
+            auto rest = pair->getCdr()->toVector();
+            if (pair->getCar()->asSymbol() == Symbol::ELSE) {
+                if (rest.empty()) {
+                    throw LispError("cond: `else` must be followed by an expression.");
+                }
+                if (it + 1 != params.end()) throw LispError("cond: `else` must be the last clause.");
+                compileBody(rest, tail);
+                hasElse = true;
+            } else if (rest.empty()) {
+                compileExpr(pair->getCar());
+                toEnd.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP, -1));
+            } else {
+                compileExpr(pair->getCar());
+                auto toNext = emitJump(OpCode::JUMP_IF_FALSE, -1);
+                compileBody(rest, tail);
+                toEnd.push_back(emitJump(OpCode::JUMP, 0));
+                adjustStack(-1);
+                patchJump(toNext);
+            }
+        }
+        if (!hasElse) {
+            compileConstant(Value::nil());
+        }
+        for (auto jump : toEnd) patchJump(jump);
+    }
+
+    void BytecodeCompiler::compileLet(const std::vector<ValuePtr>& params, bool tail) {
+        if (params.size() < 2) throw LispError("let: expected at least 2 arguments.");
+        if (!params[0]->isList()) throw LispError("let: Invalid expression.");
+        std::vector<Symbol> letParams;
+        for (const auto& bind : params[0]->toVector()) {
+            auto bindPair = valueCast<PairValue>(bind);
+            if (!bindPair) throw LispError("let: Invalid expression.");
+            auto symbol = bindPair->getCar()->asSymbol();
+            if (!symbol) throw LispError("let: Expected symbol in the binding list.");
+            if (!bindPair->getCdr()->isList()) throw LispError("let: Invalid expression.");
+            auto cdrVector = bindPair->getCdr()->toVector();
+            if (cdrVector.size() != 1) throw LispError("let: Invalid expression.");
+            letParams.push_back(*symbol);
+            compileExpr(cdrVector[0]);
+        }
+
+        // let variables live in the frame of the enclosing function
+        auto& scope = current->scopes.emplace_back();
+        std::vector<uint32_t> slots;
+        for (const auto& param : letParams) {
+            slots.push_back(declareSlot(scope, param));
+        }
+        for (auto slot = slots.rbegin(); slot != slots.rend(); ++slot) {
+            emit(OpCode::SET_LOCAL, -1);
+            emitOperand(*slot);
+        }
+        auto body = std::vector(params.begin() + 1, params.end());
+        declareDefines(current->scopes.back(), body);
+        compileBody(body, tail);
+        current->scopes.pop_back();
+    }
+
+    void BytecodeCompiler::compileBegin(const std::vector<ValuePtr>& params, bool tail) {
+        compileBody(params, tail);
+    }
+
+    void BytecodeCompiler::compileQuasiquoteImpl(const ValuePtr& value, size_t depth) {
+        if (!containsUnquote(value, depth)) {
+            return compileConstant(value);
+        }
+        auto pair = valueCast<PairValue>(value);
+        auto head = pair->getCar()->asSymbol();
+        if (head == Symbol::UNQUOTE && depth == 0) {
+            auto operands = pair->getCdr()->toVector();
+            Utils::checkParams("unquote", 1, operands);
+            compileExpr(operands[0]);
+        } else {
+            compileQuasiquoteImpl(pair->getCar(), depth);
+            compileQuasiquoteImpl(pair->getCdr(), operandDepth(head, depth));
+            emit(OpCode::CONS, -1);
+        }
+    }
+
+    void BytecodeCompiler::compileQuasiquote(const std::vector<ValuePtr>& params, bool tail) {
+        Utils::checkParams("quasiquote", 1, params);
+        compileQuasiquoteImpl(params[0], 0);
+    }
+
+    void BytecodeCompiler::compileUnquote(const std::vector<ValuePtr>& params, bool tail) {
+        throw LispError("unquote: Invalid context.");
+    }
+
+    void BytecodeCompiler::compileAnd(const std::vector<ValuePtr>& params, bool tail) {
+        if (params.empty()) {
+            return compileConstant(Value::boolean(true));
+        }
+        std::vector<size_t> toEnd;
+        for (size_t i = 0; i + 1 < params.size(); i++) {
+            compileExpr(params[i]);
+            toEnd.push_back(emitJump(OpCode::JUMP_IF_FALSE_KEEP, -1));
+        }
+        compileExpr(params.back(), tail);
+        for (auto jump : toEnd) patchJump(jump);
+    }
+
+    void BytecodeCompiler::compileOr(const std::vector<ValuePtr>& params, bool tail) {
+        if (params.empty()) {
+            return compileConstant(Value::boolean(false));
+        }
+        std::vector<size_t> toEnd;
+        for (size_t i = 0; i + 1 < params.size(); i++) {
+            compileExpr(params[i]);
+            toEnd.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP, -1));
+        }
+        compileExpr(params.back(), tail);
+        for (auto jump : toEnd) patchJump(jump);
+    }
+
+    void BytecodeCompiler::compileLambda(const std::vector<ValuePtr>& params, bool tail) {
+        if (params.empty()) throw LispError("lambda: expected at least 1 argument.");
+        std::vector<Symbol> lambdaParams;
+        if (params[0]->is<SymbolValue>()) {
+            lambdaParams.push_back(*params[0]->asSymbol());
+        } else {
+            lambdaParams = lambdaParameters(params[0]);
+        }
+        compileFunction("<anonymous>", lambdaParams, std::vector(params.begin() + 1, params.end()));
+        emit(OpCode::CLOSURE, 1);
+        emitOperand(current->proto->protos.size() - 1);
+    }
+}
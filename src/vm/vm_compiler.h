@@ -0,0 +1,75 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+
+#ifndef MINI_LISP_VM_COMPILER_H
+#define MINI_LISP_VM_COMPILER_H
+
+#include <optional>
+#include <unordered_map>
+
+#include "bytecode.h"
+
+namespace VM {
+    // Compiles parsed forms to bytecode. Variables bound by lambda, let and
+    // internal define are resolved to frame slots here; everything else is a
+    // global looked up by name.
+    class BytecodeCompiler {
+        struct Scope {
+            std::unordered_map<Symbol, uint32_t> slots;
+        };
+
+        struct Function {
+            std::shared_ptr<Proto> proto;
+            Function* enclosing;
+            std::vector<Scope> scopes;
+            size_t depth = 0;
+        };
+
+        Function* current = nullptr;
+
+        BytecodeCompiler() = default;
+
+        void emit(OpCode op, int stackEffect);
+        void emitOperand(uint32_t operand);
+        size_t emitJump(OpCode op, int stackEffect);
+        void patchJump(size_t at);
+        void adjustStack(int stackEffect);
+
+        uint32_t addConstant(const ValuePtr& value);
+        uint32_t addGlobal(Symbol name);
+        uint32_t declareSlot(Scope& scope, Symbol name);
+        void declareDefines(Scope& scope, const std::vector<ValuePtr>& body);
+
+        // `tail` marks the last expression of a function body, whose call may reuse the activation
+        void compileExpr(const ValuePtr& expr, bool tail = false);
+        void compileConstant(const ValuePtr& value);
+        void compileFail(const std::string& message);
+        void compileSymbol(Symbol name);
+        void compileCall(const ValuePtr& expr, bool tail);
+        void compileBody(const std::vector<ValuePtr>& body, bool tail);
+        ProtoPtr compileFunction(const std::string& name, const std::vector<Symbol>& params, const std::vector<ValuePtr>& body);
+
+        void compileDefine(const std::vector<ValuePtr>& params, bool tail);
+        void compileQuote(const std::vector<ValuePtr>& params, bool tail);
+        void compileIf(const std::vector<ValuePtr>& params, bool tail);
+        void compileCond(const std::vector<ValuePtr>& params, bool tail);
+        void compileLet(const std::vector<ValuePtr>& params, bool tail);
+        void compileBegin(const std::vector<ValuePtr>& params, bool tail);
+        void compileQuasiquote(const std::vector<ValuePtr>& params, bool tail);
+        void compileQuasiquoteImpl(const ValuePtr& value, size_t depth);
+        void compileUnquote(const std::vector<ValuePtr>& params, bool tail);
+        void compileAnd(const std::vector<ValuePtr>& params, bool tail);
+        void compileOr(const std::vector<ValuePtr>& params, bool tail);
+        void compileLambda(const std::vector<ValuePtr>& params, bool tail);
+
+        using FormCompiler = void (BytecodeCompiler::*)(const std::vector<ValuePtr>&, bool);
+        static const std::unordered_map<Symbol, FormCompiler> FORMS;
+
+    public:
+        // Compiles a top level form into a parameterless proto
+        static ProtoPtr compileTopLevel(const ValuePtr& expr);
+    };
+}
+
+#endif //MINI_LISP_VM_COMPILER_H
@@ -0,0 +1,64 @@
+//
+// Created by timetraveler314 on 6/5/24.
+//
+
+#include "word.h"
+
+#include "value.h"
+#include "error.h"
+
+Word Word::from(const ValuePtr& value) {
+    return from(*value);
+}
+
+Word Word::from(const Value& value) {
+    switch (value.getType()) {
+        case ValueType::NUMERIC_VALUE:
+            return number(static_cast<const NumericValue&>(value).getValue());
+        case ValueType::FIXNUM_VALUE:
+            return fixnum(static_cast<const FixnumValue&>(value).getValue());
+        case ValueType::BOOLEAN_VALUE:
+            return boolean(static_cast<const BooleanValue&>(value).getValue());
+        case ValueType::NIL_VALUE:
+            return nil();
+        case ValueType::SYMBOL_VALUE:
+            return symbol(static_cast<const SymbolValue&>(value).getSymbol());
+        default:
+            return object(&value);
+    }
+}
+
+ValuePtr Word::toValue(const ValuePtr& owner) const {
+    if (isFixnum()) return Value::integer(asFixnum());
+    if (isFlonum()) return Value::number(asFlonum());
+    switch (tag()) {
+        case NIL:
+            return Value::nil();
+        case BOOLEAN:
+            return Value::boolean(asBoolean());
+        case SYMBOL:
+            return std::make_shared<SymbolValue>(asSymbol());
+        case OBJECT:
+            if (owner.get() != asObject()) throw LispError("Internal error: object word without its owner.");
+            return owner;
+        default:
+            throw LispError("Internal error: unassigned word.");
+    }
+}
+
+ValueType Word::getType() const {
+    if (isFixnum()) return ValueType::FIXNUM_VALUE;
+    if (isFlonum()) return ValueType::NUMERIC_VALUE;
+    switch (tag()) {
+        case NIL:
+            return ValueType::NIL_VALUE;
+        case BOOLEAN:
+            return ValueType::BOOLEAN_VALUE;
+        case SYMBOL:
+            return ValueType::SYMBOL_VALUE;
+        case OBJECT:
+            return asObject()->getType();
+        default:
+            throw LispError("Internal error: unassigned word.");
+    }
+}
@@ -0,0 +1,172 @@
+//
+// Created by timetraveler314 on 6/5/24.
+//
+
+#ifndef MINI_LISP_WORD_H
+#define MINI_LISP_WORD_H
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "symbol.h"
+
+class Value;
+enum class ValueType;
+using ValuePtr = std::shared_ptr<Value>;
+
+// A value packed into 64 bits by NaN boxing. Flonums are stored as the double
+// itself (every NaN is canonicalized to one positive quiet NaN), so the
+// negative quiet NaN space is free for tagged immediates: fixnums, (),
+// booleans, symbol ids, and pointers to heap values. Numbers, booleans, ()
+// and symbols therefore need no allocation.
+//
+// Fixnums are the exact integers with a 48-bit payload. Every fixnum converts
+// to a double exactly, so comparisons across fixnums and flonums can use doubles.
+//
+// A Word does not own the heap value it points to. Whoever stores an object
+// word also stores the ValuePtr keeping it alive (its owner).
+class Word {
+    static_assert(sizeof(void*) == 8, "Word packs pointers into 48 bits");
+
+    enum Tag : uint64_t {
+        FIXNUM = 0xFFF8,
+        UNDEFINED = 0xFFF9, // An unassigned variable slot
+        NIL = 0xFFFA,
+        BOOLEAN = 0xFFFB,
+        SYMBOL = 0xFFFC,
+        OBJECT = 0xFFFD,
+    };
+    static constexpr int TAG_SHIFT = 48;
+    static constexpr uint64_t PAYLOAD_MASK = (uint64_t{1} << TAG_SHIFT) - 1;
+
+    uint64_t bits;
+
+    constexpr explicit Word(Tag tag, uint64_t payload): bits{static_cast<uint64_t>(tag) << TAG_SHIFT | payload} {}
+
+    constexpr uint64_t tag() const {
+        return bits >> TAG_SHIFT;
+    }
+
+public:
+    static constexpr int64_t FIXNUM_MIN = -(int64_t{1} << (TAG_SHIFT - 1));
+    static constexpr int64_t FIXNUM_MAX = (int64_t{1} << (TAG_SHIFT - 1)) - 1;
+
+    constexpr Word(): Word(UNDEFINED, 0) {}
+
+    static Word number(double value) {
+        Word word(UNDEFINED, 0);
+        word.bits = value != value ? std::bit_cast<uint64_t>(std::numeric_limits<double>::quiet_NaN())
+                                   : std::bit_cast<uint64_t>(value);
+        return word;
+    }
+
+    // `value` must be within [FIXNUM_MIN, FIXNUM_MAX]
+    static constexpr Word fixnum(int64_t value) {
+        return Word(FIXNUM, static_cast<uint64_t>(value) & PAYLOAD_MASK);
+    }
+
+    static constexpr bool fitsFixnum(int64_t value) {
+        return FIXNUM_MIN <= value && value <= FIXNUM_MAX;
+    }
+
+    // A fixnum if `value` fits one, otherwise undefined: the value needs a bignum
+    static constexpr Word integer(int64_t value) {
+        return fitsFixnum(value) ? fixnum(value) : Word();
+    }
+
+    static constexpr Word nil() {
+        return Word(NIL, 0);
+    }
+
+    static constexpr Word boolean(bool value) {
+        return Word(BOOLEAN, value);
+    }
+
+    static constexpr Word symbol(Symbol symbol) {
+        return Word(SYMBOL, symbol.getId());
+    }
+
+    static Word object(const Value* value) {
+        return Word(OBJECT, reinterpret_cast<uintptr_t>(value));
+    }
+
+    // Flonums, fixnums, booleans, () and symbols become immediates, anything
+    // else (bignums included) an object word
+    static Word from(const Value& value);
+    static Word from(const ValuePtr& value);
+
+    // A value for this word; object words yield their `owner`
+    ValuePtr toValue(const ValuePtr& owner = nullptr) const;
+
+    constexpr bool isNumber() const {
+        return tag() < UNDEFINED;
+    }
+
+    constexpr bool isFlonum() const {
+        return tag() < FIXNUM;
+    }
+
+    constexpr bool isFixnum() const {
+        return tag() == FIXNUM;
+    }
+
+    constexpr bool isUndefined() const {
+        return tag() == UNDEFINED;
+    }
+
+    constexpr bool isNil() const {
+        return tag() == NIL;
+    }
+
+    constexpr bool isBoolean() const {
+        return tag() == BOOLEAN;
+    }
+
+    constexpr bool isSymbol() const {
+        return tag() == SYMBOL;
+    }
+
+    constexpr bool isObject() const {
+        return tag() == OBJECT;
+    }
+
+    // Only #f is false
+    constexpr bool isFalse() const {
+        return bits == boolean(false).bits;
+    }
+
+    // Any number as a double, exact for fixnums
+    double asNumber() const {
+        return isFixnum() ? static_cast<double>(asFixnum()) : asFlonum();
+    }
+
+    double asFlonum() const {
+        return std::bit_cast<double>(bits);
+    }
+
+    constexpr int64_t asFixnum() const {
+        // Sign-extends the payload
+        return static_cast<int64_t>(bits << (64 - TAG_SHIFT)) >> (64 - TAG_SHIFT);
+    }
+
+    constexpr bool asBoolean() const {
+        return bits & 1;
+    }
+
+    constexpr Symbol asSymbol() const {
+        return Symbol::fromId(static_cast<uint32_t>(bits & PAYLOAD_MASK));
+    }
+
+    Value* asObject() const {
+        return reinterpret_cast<Value*>(bits & PAYLOAD_MASK);
+    }
+
+    ValueType getType() const;
+
+    // Identity of immediates and objects, not numeric equality
+    constexpr bool operator==(const Word& other) const = default;
+};
+
+#endif //MINI_LISP_WORD_H
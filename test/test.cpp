@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "../src/value.h"
+#include "../src/arena.h"
 #include "../src/token.h"
 #include "../src/tokenizer.h"
 #include "../src/error.h"
@@ -15,6 +16,11 @@
 
 #include "test_builtins.cpp"
 #include "test_special_forms.cpp"
+#include "test_vm.cpp"
+#include "test_gc.cpp"
+#include "test_bigint.cpp"
+#include "test_simd.cpp"
+#include "test_ndarray.cpp"
 
 struct TestCtx {
     std::shared_ptr<EvalEnv> env = EvalEnv::createGlobal();
@@ -57,7 +63,81 @@ TEST(ValueTest, IsTemplate){
     EXPECT_FALSE(symbolValue->is<PairValue>());
 
     // SelfEvaluatingValue
+    EXPECT_TRUE(stringValue->is<SelfEvaluatingValue>());
+    EXPECT_TRUE(stringValue->is<AtomicValue>());
+    EXPECT_FALSE(symbolValue->is<SelfEvaluatingValue>());
+    EXPECT_TRUE(symbolValue->is<AtomicValue>());
+
+    // Categories and casts
+    ValuePtr pair = std::make_shared<PairValue>(stringValue, std::make_shared<NilValue>());
+    EXPECT_FALSE(pair->is<AtomicValue>());
+    EXPECT_EQ(valueCast<PairValue>(pair).get(), pair.get());
+    EXPECT_EQ(valueCast<SymbolValue>(pair), nullptr);
+    EXPECT_TRUE(Builtins::builtinMap.at("+")->is<ProcedureValue>());
+}
+
+TEST(ValueTest, SharedConstants) {
+    EXPECT_EQ(Value::nil(), Value::nil());
+    EXPECT_EQ(Value::boolean(true), Value::boolean(true));
+    EXPECT_EQ(Value::boolean(false)->toString(), "#f");
+    EXPECT_EQ(Value::number(42), Value::number(42.0));
+    EXPECT_EQ(Value::number(-3)->toString(), "-3");
+    EXPECT_NE(Value::number(0.5), Value::number(0.5));
+    EXPECT_NE(Value::number(-0.0), Value::number(0)); // Keeps its sign
+    EXPECT_EQ(Value::fromVector({}), Value::nil());
+}
+
+TEST(ValueTest, PooledPairs) {
+    auto pair = PairValue::create(Value::number(1), Value::nil());
+    EXPECT_EQ(pair->toString(), "(1)");
+    auto address = pair.get();
+    pair.reset();
+    EXPECT_EQ(PairValue::create(Value::number(2), Value::nil()).get(), address); // The freed cell is reused first
+}
+
+TEST(ValueTest, ArenaNumbers) {
+    auto& arena = Arena::instance();
+    arena.beginRegion();
+    auto number = Value::number(0.5);
+    EXPECT_TRUE(arena.contains(number.get()));
+    auto promoted = Value::promote(number);
+    EXPECT_FALSE(arena.contains(promoted.get()));
+    EXPECT_EQ(promoted->toString(), number->toString());
+
+    // A chunk whose values are all gone is reused from its start
+    auto address = number.get();
+    number.reset();
+    EXPECT_EQ(Value::number(1.5).get(), address);
+
+    auto env = EvalEnv::createGlobal();
+    env->defineBinding("x", Value::number(2.5));
+    EXPECT_FALSE(arena.contains(env->lookupBinding("x")->get()));
+}
 
+// Forms keeping computed numbers pin a bounded number of chunks
+TEST(ValueTest, ArenaStaysBounded) {
+    auto& arena = Arena::instance();
+    TestCtx ctx;
+    ctx.eval("(define k 2000)");
+    ctx.eval("(define l '())");
+    ctx.eval("(define fs '())");
+    ctx.eval("(define (keep x) (lambda () x))");
+    for (int i = 0; i < 5000; i++) {
+        arena.beginRegion();
+        ctx.eval("(define k (+ k 1))");
+        ctx.eval("(define l (cons (* k 3) l))");
+        ctx.eval("(define fs (cons (keep (* k 2.5)) fs))"); // The closure's frame keeps the number
+    }
+    EXPECT_LE(arena.chunkCount(), Arena::MAX_CHUNKS);
+    // Numbers stored in pairs leave the arena
+    auto list = valueCast<PairValue>(*ctx.env->lookupBinding("l"));
+    EXPECT_FALSE(arena.contains(list->getCar().get()));
+    EXPECT_EQ(ctx.eval("(car l)"), "21000");
+    EXPECT_EQ(ctx.eval("((car fs))"), "17500");
+    // Allocation goes on in the arena once chunks are free again
+    ctx.eval("(define fs '())");
+    arena.beginRegion();
+    EXPECT_TRUE(arena.contains(Value::number(0.5).get()));
 }
 
 TEST(ValueTest, ToString) {
@@ -82,6 +162,14 @@ TEST(ValueTest, AsInteger) {
 
     auto doubleValue = NumericValue(1.5);
     EXPECT_EQ(doubleValue.asInteger(), std::nullopt);
+
+    // Integers beyond int have none rather than wrapping around
+    EXPECT_EQ(Value::integer(2147483647)->asInteger(), 2147483647);
+    EXPECT_EQ(Value::integer(-2147483648)->asInteger(), -2147483648);
+    EXPECT_EQ(Value::integer(4294967297)->asInteger(), std::nullopt);
+    EXPECT_EQ(Value::integer(-4294967296)->asInteger(), std::nullopt);
+    EXPECT_EQ(NumericValue(4294967297.0).asInteger(), std::nullopt);
+    EXPECT_THROW(Utils::isInteger.resolve(Value::integer(4294967296)), LispError);
 }
 
 TEST(ValueTest, ToVector) {
@@ -149,8 +237,8 @@ TEST(ValueTest, IsEqual) {
     // LambdaValue : The implementation compares the address of the lambda environment
     auto env = EvalEnv::createGlobal();
     auto lambdaBody = std::vector<ValuePtr>();
-    auto lambdaParams1 = std::vector<std::string>{"xs"};
-    auto lambdaParams2 = std::vector<std::string>{"ys"};
+    auto lambdaParams1 = std::vector<Symbol>{"xs"};
+    auto lambdaParams2 = std::vector<Symbol>{"ys"};
     auto lambdaValue1 = std::make_shared<LambdaValue>(env, lambdaParams1, lambdaBody);
     auto lambdaValue2 = std::make_shared<LambdaValue>(env, lambdaParams1, lambdaBody);
     auto lambdaValue3 = std::make_shared<LambdaValue>(env, lambdaParams2, lambdaBody);
@@ -159,6 +247,45 @@ TEST(ValueTest, IsEqual) {
     EXPECT_FALSE(lambdaValue1->isEqual(lambdaValue3));
 }
 
+TEST(SymbolTest, Interning) {
+    Symbol a("interned"), b(std::string("interned")), c("other");
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(&a.name(), &b.name()); // One copy of the name
+    EXPECT_EQ(Symbol("quote"), Symbol::QUOTE);
+
+    auto x = std::make_shared<SymbolValue>("interned");
+    auto y = std::make_shared<SymbolValue>(a);
+    EXPECT_TRUE(x->isEqual(y));
+    EXPECT_EQ(x->toString(), "interned");
+}
+
+TEST(WordTest, Boxing) {
+    EXPECT_TRUE(Word::number(1.5).isNumber());
+    EXPECT_EQ(Word::number(-0.25).asNumber(), -0.25);
+    EXPECT_TRUE(Word::number(std::nan("")).isNumber()); // NaNs do not alias tagged words
+    EXPECT_TRUE(Word::boolean(false).isFalse());
+    EXPECT_FALSE(Word::nil().isFalse());
+    EXPECT_EQ(Word::symbol(Symbol("boxed")).asSymbol(), Symbol("boxed"));
+
+    auto list = Value::fromVector({std::make_shared<NumericValue>(1.0)});
+    auto word = Word::from(list);
+    EXPECT_TRUE(word.isObject());
+    EXPECT_EQ(word.asObject(), list.get());
+    EXPECT_EQ(word.toValue(list), list);
+    EXPECT_EQ(Word::from(std::make_shared<NumericValue>(2.0)), Word::number(2.0));
+    EXPECT_EQ(Word::from(std::make_shared<NilValue>()).getType(), ValueType::NIL_VALUE);
+    EXPECT_EQ(Word::number(3.0).toValue()->toString(), "3");
+
+    EXPECT_TRUE(Word::fixnum(-7).isFixnum());
+    EXPECT_FALSE(Word::fixnum(-7).isFlonum());
+    EXPECT_EQ(Word::fixnum(Word::FIXNUM_MIN).asFixnum(), Word::FIXNUM_MIN);
+    EXPECT_EQ(Word::fixnum(Word::FIXNUM_MAX).asNumber(), static_cast<double>(Word::FIXNUM_MAX));
+    EXPECT_TRUE(Word::integer(Word::FIXNUM_MAX + 1).isUndefined());
+    EXPECT_EQ(Word::from(Value::integer(-7)), Word::fixnum(-7));
+    EXPECT_EQ(Word::fixnum(5000).toValue()->getType(), ValueType::FIXNUM_VALUE);
+}
+
 TEST(UtilsTest, RequireParams) {
     std::vector<ValuePtr> params = {
             std::make_shared<NumericValue>(1.0),
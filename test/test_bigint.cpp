@@ -0,0 +1,64 @@
+//
+// Created by timetraveler314 on 6/11/24.
+//
+
+#include <random>
+
+#include "../src/bigint.h"
+
+namespace {
+    BigInt randomBigInt(std::mt19937& rng, size_t digits) {
+        std::string text = rng() % 2 ? "-" : "";
+        text += static_cast<char>('1' + rng() % 9);
+        for (size_t i = 1; i < digits; i++) text += static_cast<char>('0' + rng() % 10);
+        return *BigInt::parse(text);
+    }
+}
+
+TEST(BigIntTest, Conversions) {
+    for (auto text : {"0", "7", "-7", "4294967296", "-18446744073709551616", "100000000000000000000000000001"}) {
+        EXPECT_EQ(BigInt::parse(text)->toString(), text);
+    }
+    EXPECT_EQ(BigInt::parse("+12")->toString(), "12");
+    EXPECT_EQ(BigInt::parse("-0")->toString(), "0");
+    EXPECT_FALSE(BigInt::parse("12a"));
+    EXPECT_FALSE(BigInt::parse("-"));
+
+    EXPECT_EQ(BigInt(INT64_MIN).toInt64(), INT64_MIN);
+    EXPECT_EQ(BigInt(INT64_MAX).toString(), "9223372036854775807");
+    EXPECT_FALSE((BigInt(INT64_MAX) + BigInt(1)).toInt64());
+    EXPECT_EQ(BigInt::pow(2, 100).toDouble(), std::ldexp(1.0, 100));
+}
+
+TEST(BigIntTest, Arithmetic) {
+    auto a = *BigInt::parse("123456789012345678901234567890");
+    auto b = *BigInt::parse("-987654321098765432109876543210");
+    EXPECT_EQ((a + b).toString(), "-864197532086419753208641975320");
+    EXPECT_EQ((a - b).toString(), "1111111110111111111011111111100");
+    EXPECT_EQ((a * b).toString(), "-121932631137021795226185032733622923332237463801111263526900");
+    EXPECT_LT(BigInt::compare(b, a), 0);
+    EXPECT_EQ(BigInt::pow(3, 50).toString(), "717897987691852588770249");
+
+    auto [quotient, remainder] = BigInt::divide(b, a);
+    EXPECT_EQ(quotient.toString(), "-8");
+    EXPECT_EQ(remainder.toString(), "-9000000000900000000090");
+}
+
+TEST(BigIntTest, LargeOperands) {
+    std::mt19937 rng(314);
+    for (size_t digits : {400, 1000, 5000}) {
+        auto x = randomBigInt(rng, digits), y = randomBigInt(rng, digits / 3 + 1);
+        ASSERT_GT(x.size(), BigInt::KARATSUBA_THRESHOLD);
+        // Karatsuba agrees with the schoolbook method
+        auto product = x * y;
+        EXPECT_EQ(product, BigInt::multiplySchoolbook(x, y));
+        EXPECT_EQ(x * x, BigInt::multiplySchoolbook(x, x));
+
+        // x = q * y + r with |r| < |y|
+        auto [quotient, remainder] = BigInt::divide(x, y);
+        EXPECT_EQ(quotient * y + remainder, x);
+        EXPECT_LT(BigInt::compare(remainder.abs(), y.abs()), 0);
+        EXPECT_EQ(BigInt::divide(product, y).first, x);
+        EXPECT_TRUE(BigInt::divide(product, x).second.isZero());
+    }
+}
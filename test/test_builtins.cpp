@@ -2,10 +2,15 @@
 // Created by timetraveler314 on 5/12/24.
 //
 
+#include <fstream>
+
 #include <gtest/gtest.h>
 
+#include "../src/batch.h"
 #include "../src/builtins.h"
 #include "../src/eval_env.h"
+#include "../src/parser.h"
+#include "../src/tokenizer.h"
 
 static auto globalEnv = *EvalEnv::createGlobal();
 
@@ -26,6 +31,7 @@ TEST(BuiltinsTest, Display) {
     std::string output = testing::internal::GetCapturedStdout();
     ASSERT_EQ(output, "hello");
     ASSERT_EQ(result->getType(), ValueType::NIL_VALUE);
+    ASSERT_EQ(result, Value::nil()); // No allocation for the result
 
     testing::internal::CaptureStdout();
     auto result2 = Builtins::_display({std::make_shared<NumericValue>(1.0)}, globalEnv);
@@ -173,9 +179,9 @@ TEST(BuiltinsTest, Length) {
     auto result = Builtins::_length({
         std::make_shared<PairValue>(std::make_shared<NumericValue>(1.0),std::make_shared<PairValue>(std::make_shared<NumericValue>(2.0), std::make_shared<NilValue>()))
     }, globalEnv);
-    EXPECT_EQ(result->as<NumericValue>(), 2.0);
+    EXPECT_EQ(result->as<FixnumValue>(), 2);
     auto result2 = Builtins::_length({std::make_shared<NilValue>()}, globalEnv);
-    EXPECT_EQ(result2->as<NumericValue>(), 0.0);
+    EXPECT_EQ(result2->as<FixnumValue>(), 0);
 }
 
 TEST(BuiltinsTest, List) {
@@ -185,7 +191,7 @@ TEST(BuiltinsTest, List) {
 
 TEST(BuiltinsTest, Add) {
     auto resultZero = Builtins::_add({}, globalEnv);
-    ASSERT_EQ(resultZero->as<NumericValue>(), 0.0);
+    ASSERT_EQ(resultZero->as<FixnumValue>(), 0);
     auto result2 = Builtins::_add({std::make_shared<NumericValue>(1.0), std::make_shared<NumericValue>(2.0)}, globalEnv);
     ASSERT_EQ(result2->as<NumericValue>(), 3.0);
     auto result4 = Builtins::_add({std::make_shared<NumericValue>(1.0), std::make_shared<NumericValue>(2.0),
@@ -202,7 +208,7 @@ TEST(BuiltinsTest, Sub) {
 
 TEST(BuiltinsTest, Mul) {
     auto result = Builtins::_mul({}, globalEnv);
-    ASSERT_EQ(result->as<NumericValue>(), 1.0);
+    ASSERT_EQ(result->as<FixnumValue>(), 1);
     auto result2 = Builtins::_mul({std::make_shared<NumericValue>(1.0), std::make_shared<NumericValue>(2.0),
                                    std::make_shared<NumericValue>(3.0), std::make_shared<NumericValue>(4.0)}, globalEnv);
     ASSERT_EQ(result2->as<NumericValue>(), 24.0);
@@ -302,4 +308,422 @@ TEST(BuiltinsTest, IsZero) {
     ASSERT_TRUE(*result->as<BooleanValue>());
     auto result2 = Builtins::_is_zero({std::make_shared<NumericValue>(1.0)}, globalEnv);
     ASSERT_FALSE(*result2->as<BooleanValue>());
-}
\ No newline at end of file
+}
+
+class BuiltinsEvalTest : public testing::Test {
+protected:
+    std::shared_ptr<EvalEnv> env = EvalEnv::createGlobal();
+
+    ValuePtr eval(const std::string& input) {
+        Tokenizer tokenizer;
+        Parser parser(tokenizer);
+        auto valueTask = parser.parse();
+        tokenizer.feed(input);
+        return env->eval(valueTask.get_result().value());
+    }
+};
+
+TEST_F(BuiltinsEvalTest, Fixnums) {
+    // Integer literals and arithmetic on them are exact
+    EXPECT_EQ(eval("(+ 140737488355000 327)")->as<FixnumValue>(), 140737488355327);
+    EXPECT_EQ(eval("(* -4096 4096)")->as<FixnumValue>(), -16777216);
+    EXPECT_EQ(eval("(quotient 17 -5)")->as<FixnumValue>(), -3);
+    EXPECT_EQ(eval("(modulo -7 2)")->as<FixnumValue>(), 1);
+    EXPECT_EQ(eval("(modulo -4 2)")->as<FixnumValue>(), 0);
+    EXPECT_EQ(eval("(/ 12 4)")->as<FixnumValue>(), 3);
+    EXPECT_EQ(eval("(expt 3 20)")->as<FixnumValue>(), 3486784401);
+    EXPECT_EQ(eval("(/ 1 2)")->as<NumericValue>(), 0.5);
+
+    // A flonum operand gives a flonum, an overflow a bignum
+    EXPECT_EQ(eval("(+ 1 2.0)")->as<NumericValue>(), 3.0);
+    EXPECT_EQ(eval("(+ 140737488355327 1)")->getType(), ValueType::BIGNUM_VALUE);
+    EXPECT_EQ(eval("(* 140737488355327 140737488355327)")->getType(), ValueType::BIGNUM_VALUE);
+
+    EXPECT_TRUE(*eval("(= 3 3.0)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(< 140737488355326 140737488355327)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(integer? 3)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(odd? 140737488355327)")->as<BooleanValue>());
+    EXPECT_EQ(eval("(- 5)")->toString(), "-5");
+}
+
+TEST_F(BuiltinsEvalTest, Bignums) {
+    eval("(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))");
+    EXPECT_EQ(eval("(fact 30)")->toString(), "265252859812191058636308480000000");
+    EXPECT_EQ(eval("(expt 2 100)")->toString(), "1267650600228229401496703205376");
+    EXPECT_EQ(eval("(- (expt 2 100))")->toString(), "-1267650600228229401496703205376");
+    EXPECT_EQ(eval("123456789012345678901234567890")->toString(), "123456789012345678901234567890");
+
+    // Mixed with fixnums and flonums
+    EXPECT_EQ(eval("(+ (expt 2 64) 1)")->toString(), "18446744073709551617");
+    EXPECT_EQ(eval("(quotient (expt 10 30) 7)")->toString(), "142857142857142857142857142857");
+    EXPECT_EQ(eval("(remainder (expt 10 30) 7)")->as<FixnumValue>(), 1);
+    EXPECT_EQ(eval("(modulo (- (expt 10 30)) 7)")->as<FixnumValue>(), 6);
+    EXPECT_EQ(eval("(* (expt 2 100) 0.5)")->as<NumericValue>(), std::ldexp(1.0, 99));
+    EXPECT_TRUE(*eval("(< (expt 2 100) (expt 3 100))")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(> (expt 2 100) 1.0)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(even? (expt 2 100))")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(equal? (expt 2 100) (* (expt 2 50) (expt 2 50)))")->as<BooleanValue>());
+
+    // Results that fit go back to fixnums
+    EXPECT_EQ(eval("(- (+ (expt 2 100) 5) (expt 2 100))")->as<FixnumValue>(), 5);
+    EXPECT_EQ(eval("(/ (expt 2 100) (expt 2 98))")->as<FixnumValue>(), 4);
+    EXPECT_THROW(eval("(quotient (expt 2 100) 0)"), LispError);
+}
+
+TEST(BuiltinsTest, FastPaths) {
+    auto one = Value::number(1), two = Value::number(2);
+    auto pair = PairValue::create(one, two);
+    auto call = [](const char* name, Arguments args) {
+        return valueCast<BuiltinProcValue>(Builtins::builtinMap.at(name))->apply(args, globalEnv);
+    };
+    // One and two arguments take the specialized entry points, which agree with the general one
+    EXPECT_EQ(call("car", {pair}), one);
+    EXPECT_EQ(call("cdr", {pair}), two);
+    EXPECT_EQ(*call("+", {one, two})->as<NumericValue>(), 3.0);
+    EXPECT_EQ(*call("-", {two})->as<NumericValue>(), -2.0);
+    EXPECT_TRUE(*call("<", {one, two})->as<BooleanValue>());
+    EXPECT_TRUE(call("cons", {one, two})->isEqual(pair));
+    EXPECT_EQ(*call("+", {one, two, two})->as<NumericValue>(), 5.0);
+
+    // Bad arguments fall back to the general entry point for its errors
+    try {
+        call("car", {one});
+        FAIL();
+    } catch (const LispError& e) {
+        EXPECT_STREQ(e.what(), "car: expected argument 1 to be of type \"pair\"");
+    }
+    EXPECT_THROW(call("<", {one, pair}), LispError);
+
+    auto car = valueCast<BuiltinProcValue>(Builtins::builtinMap.at("car"));
+    EXPECT_TRUE(car->accepts(1));
+    EXPECT_FALSE(car->accepts(2));
+    EXPECT_TRUE(valueCast<BuiltinProcValue>(Builtins::builtinMap.at("list"))->accepts(5));
+}
+
+TEST_F(BuiltinsEvalTest, Memoize) {
+    // Each call of `square` that reaches the procedure prints a star
+    auto calls = [this](const std::string& input) {
+        testing::internal::CaptureStdout();
+        eval(input);
+        return testing::internal::GetCapturedStdout().size();
+    };
+    eval("(define square (memoize (lambda (x) (begin (display \"*\") (* x x))) 2))");
+    EXPECT_EQ(calls("(square 3)"), 1);
+    EXPECT_EQ(calls("(square 3)"), 0);
+    EXPECT_EQ(eval("(square 3)")->as<FixnumValue>(), 9);
+    // Exactness is part of the arguments
+    EXPECT_EQ(calls("(square 3.0)"), 1);
+    EXPECT_EQ(eval("(square 3.0)")->getType(), ValueType::NUMERIC_VALUE);
+    // The least recently used result goes first
+    EXPECT_EQ(calls("(square 4)"), 1);
+    EXPECT_EQ(calls("(square 3)"), 1);
+    EXPECT_EQ(calls("(square 4)"), 0);
+    EXPECT_EQ(calls("(square 3.0)"), 1);
+
+    eval("(define (slow-fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))");
+    eval("(define fib (memoize slow-fib))");
+    EXPECT_EQ(eval("(fib 60)")->as<FixnumValue>(), 1548008755920);
+    EXPECT_EQ(eval("(fib 100)")->toString(), "354224848179261915075");
+
+    // Mutating an argument after the call leaves the cached one alone
+    eval("(define first (memoize (lambda (x) (vector-ref x 0)) 1))");
+    eval("(define v (vector 1))");
+    EXPECT_EQ(eval("(first v)")->as<FixnumValue>(), 1);
+    eval("(vector-set! v 0 2)");
+    EXPECT_EQ(eval("(first v)")->as<FixnumValue>(), 2);
+    eval("(vector-set! v 0 1)");
+    EXPECT_EQ(eval("(first v)")->as<FixnumValue>(), 1);
+    eval("(define first-of-car (memoize (lambda (x) (vector-ref (car x) 0)) 1))");
+    eval("(define nested (list (vector 1)))");
+    EXPECT_EQ(eval("(first-of-car nested)")->as<FixnumValue>(), 1);
+    eval("(vector-set! (car nested) 0 3)");
+    EXPECT_EQ(eval("(first-of-car nested)")->as<FixnumValue>(), 3);
+    eval("(define sum (memoize (lambda (x) (f64vector-ref x 0)) 1))");
+    eval("(define w (f64vector 1 2))");
+    EXPECT_EQ(eval("(sum w)")->toString(), "1");
+    eval("(f64vector-set! w 0 5)");
+    EXPECT_EQ(eval("(sum w)")->toString(), "5");
+    eval("(define corner (memoize (lambda (x) (ndarray-ref x 0 0)) 1))");
+    eval("(define a (make-ndarray 2 2 1))");
+    EXPECT_EQ(eval("(corner a)")->toString(), "1");
+    eval("(ndarray-set! a 0 0 7)");
+    EXPECT_EQ(eval("(corner a)")->toString(), "7");
+    // Arguments containing themselves are copied with the cycle
+    eval("(define c (make-vector 2 1))");
+    eval("(vector-set! c 0 c)");
+    EXPECT_EQ(eval("(first-of-car (list c))")->toString(), "#(#(...) 1)");
+    EXPECT_EQ(eval("(vector-ref (first-of-car (list c)) 1)")->as<FixnumValue>(), 1);
+    eval("(vector-set! c 1 2)");
+    EXPECT_EQ(eval("(vector-ref (first-of-car (list c)) 1)")->as<FixnumValue>(), 2);
+    // Mutating a result leaves the cached one alone, on a miss and on a hit
+    eval("(define make (memoize (lambda (n) (list (make-vector 1 n) (f64vector n) (make-hash-table))) 1))");
+    eval("(define r (make 1))");
+    eval("(vector-set! (car r) 0 2)");
+    eval("(f64vector-set! (car (cdr r)) 0 2)");
+    eval("(hash-set! (car (cdr (cdr r))) 'k 2)");
+    EXPECT_EQ(eval("(make 1)")->toString(), "(#(1) #f64(1) #<hash-table>)");
+    EXPECT_EQ(eval("(hash-count (car (cdr (cdr (make 1)))))")->as<FixnumValue>(), 0);
+    eval("(vector-set! (car (make 1)) 0 3)");
+    eval("(hash-set! (car (cdr (cdr (make 1)))) 'k 3)");
+    EXPECT_EQ(eval("(make 1)")->toString(), "(#(1) #f64(1) #<hash-table>)");
+    EXPECT_EQ(eval("(hash-count (car (cdr (cdr (make 1)))))")->as<FixnumValue>(), 0);
+
+    EXPECT_THROW(eval("(memoize 1)"), LispError);
+    EXPECT_THROW(eval("(memoize car 0)"), LispError);
+    EXPECT_THROW(eval("(memoize car 4294967297)"), LispError);
+    EXPECT_EQ(eval("(memoize car)")->toString(), "#<procedure>");
+    EXPECT_TRUE(*eval("(procedure? (memoize car))")->as<BooleanValue>());
+}
+
+TEST_F(BuiltinsEvalTest, MemoizeFile) {
+    auto path = testing::TempDir() + "memoize_test.txt";
+    std::remove(path.c_str());
+    auto memoize = "(define f (memoize (lambda (x y) (begin (display \"*\") (list x y (expt 2 100) 0.5 \"a\\\"b\\nc\" 'sym))) 8 \"" + path + "\"))";
+    eval(memoize);
+    eval("(f 1 2.0)");
+    eval("(f '(a . b) \"s\")");
+    eval("(f car 1)"); // Not saved
+    auto saved = eval("(f 1 2.0)");
+
+    // Another process would start out with the saved results
+    eval(memoize);
+    testing::internal::CaptureStdout();
+    EXPECT_TRUE(eval("(f 1 2.0)")->isEqual(saved));
+    EXPECT_EQ(eval("(f '(a . b) \"s\")")->toString(), "((a . b) \"s\" 1267650600228229401496703205376 0.500000 \"a\\\"b\nc\" sym)");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    EXPECT_EQ(eval("(car (f 1 2.0))")->getType(), ValueType::FIXNUM_VALUE);
+    EXPECT_EQ(eval("(car (cdr (f 1 2.0)))")->getType(), ValueType::NUMERIC_VALUE);
+
+    // Beyond the capacity the file is compacted on loading
+    eval("(define g (memoize (lambda (x) x) 1 \"" + path + "\"))");
+    std::ifstream in(path);
+    EXPECT_EQ(std::count(std::istreambuf_iterator<char>(in), {}, '\n'), 1);
+    std::remove(path.c_str());
+}
+
+TEST_F(BuiltinsEvalTest, HashTables) {
+    eval("(define t (make-hash-table))");
+    EXPECT_TRUE(*eval("(hash-table? t)")->as<BooleanValue>());
+    eval("(hash-set! t 'a 1)");
+    eval("(hash-set! t \"a\" 2)");
+    eval("(hash-set! t '(1 (2 . \"x\")) 3)");
+    eval("(hash-set! t (expt 2 100) 4)");
+    EXPECT_EQ(eval("(hash-ref t 'a)")->as<FixnumValue>(), 1);
+    EXPECT_EQ(eval("(hash-ref t \"a\")")->as<FixnumValue>(), 2);
+    // Keys compare by equal?
+    EXPECT_EQ(eval("(hash-ref t (list 1 (cons 2 \"x\")))")->as<FixnumValue>(), 3);
+    EXPECT_EQ(eval("(hash-ref t (* (expt 2 50) (expt 2 50)))")->as<FixnumValue>(), 4);
+    EXPECT_EQ(eval("(hash-ref t 'b #f)")->toString(), "#f");
+    EXPECT_THROW(eval("(hash-ref t 'b)"), LispError);
+    EXPECT_EQ(eval("(hash-count t)")->as<FixnumValue>(), 4);
+
+    eval("(hash-set! t 'a 5)");
+    eval("(hash-remove! t \"a\")");
+    eval("(hash-remove! t 'missing)");
+    EXPECT_EQ(eval("(hash-ref t 'a)")->as<FixnumValue>(), 5);
+    EXPECT_EQ(eval("(hash-count t)")->as<FixnumValue>(), 3);
+    EXPECT_EQ(eval("(length (hash-keys t))")->as<FixnumValue>(), 3);
+    EXPECT_THROW(eval("(hash-set! '() 1 2)"), LispError);
+
+    // Growth, and probing past removed entries
+    eval("(define (fill i n) (if (< i n) (begin (hash-set! t i (* i i)) (fill (+ i 1) n)) '()))");
+    eval("(define (drain i n) (if (< i n) (begin (hash-remove! t i) (drain (+ i 2) n)) '()))");
+    eval("(fill 0 1000)");
+    eval("(drain 0 1000)");
+    eval("(fill 1000 1500)");
+    EXPECT_EQ(eval("(hash-count t)")->as<FixnumValue>(), 3 + 500 + 500);
+    EXPECT_EQ(eval("(hash-ref t 999)")->as<FixnumValue>(), 998001);
+    EXPECT_EQ(eval("(hash-ref t 1499.0)")->as<FixnumValue>(), 2247001);
+    EXPECT_EQ(eval("(hash-ref t 998 'none)")->toString(), "none");
+}
+
+TEST_F(BuiltinsEvalTest, Vectors) {
+    // Literals evaluate to themselves, elements unevaluated
+    EXPECT_EQ(eval("#(1 \"a\" (b . c) #(x) #t)")->toString(), "#(1 \"a\" (b . c) #(x) #t)");
+    EXPECT_EQ(eval("'#()")->toString(), "#()");
+    EXPECT_TRUE(*eval("(vector? #(1))")->as<BooleanValue>());
+    EXPECT_FALSE(*eval("(vector? '(1))")->as<BooleanValue>());
+
+    eval("(define v (make-vector 3 'x))");
+    eval("(vector-set! v 1 (+ 1 1))");
+    EXPECT_EQ(eval("v")->toString(), "#(x 2 x)");
+    EXPECT_EQ(eval("(vector-ref v 1)")->as<FixnumValue>(), 2);
+    EXPECT_EQ(eval("(vector-length v)")->as<FixnumValue>(), 3);
+    EXPECT_EQ(eval("(make-vector 2)")->toString(), "#(0 0)");
+    EXPECT_THROW(eval("(vector-ref v 3)"), LispError);
+    EXPECT_THROW(eval("(vector-set! v -1 0)"), LispError);
+    EXPECT_THROW(eval("(vector-ref '(1) 0)"), LispError);
+    // Indices beyond int are out of range rather than wrapped around
+    EXPECT_THROW(eval("(vector-ref v 4294967296)"), LispError);
+    EXPECT_THROW(eval("(vector-set! v 4294967297 0)"), LispError);
+    EXPECT_THROW(eval("(vector-ref v 1e30)"), LispError);
+    EXPECT_THROW(eval("(vector-ref v 100000000000000000000)"), LispError);
+    EXPECT_THROW(eval("(make-vector 4294967296000000000)"), LispError);
+    EXPECT_THROW(eval("(make-vector -4294967296)"), LispError);
+
+    EXPECT_EQ(eval("(vector-map (lambda (x) (* x x)) (vector 1 2 3))")->toString(), "#(1 4 9)");
+    EXPECT_EQ(eval("(vector->list #(1 2))")->toString(), "(1 2)");
+    EXPECT_EQ(eval("(list->vector '(1 2))")->toString(), "#(1 2)");
+    EXPECT_TRUE(*eval("(equal? (vector 1 '(2)) #(1 (2)))")->as<BooleanValue>());
+    EXPECT_FALSE(*eval("(eq? (vector 1) (vector 1))")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(eq? v v)")->as<BooleanValue>());
+
+    // Vectors containing themselves print, compare and hash without recursing forever
+    eval("(define c (make-vector 2 0))");
+    eval("(vector-set! c 0 c)");
+    eval("(vector-set! c 1 (list c))");
+    EXPECT_EQ(eval("c")->toString(), "#(#(...) (#(...)))");
+    eval("(define d (make-vector 2 0))");
+    eval("(vector-set! d 0 d)");
+    eval("(vector-set! d 1 (list c))");
+    EXPECT_TRUE(*eval("(equal? c c)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(equal? c d)")->as<BooleanValue>());
+    EXPECT_FALSE(*eval("(equal? c (vector c '()))")->as<BooleanValue>());
+    eval("(define h (make-hash-table))");
+    eval("(hash-set! h c 1)");
+    EXPECT_EQ(eval("(hash-ref h d)")->as<FixnumValue>(), 1);
+}
+
+TEST_F(BuiltinsEvalTest, F64Vectors) {
+    eval("(define x (f64vector 1 2 3.5))");
+    eval("(define y (list->f64vector '(4 5 6)))");
+    EXPECT_EQ(eval("x")->toString(), "#f64(1 2 3.500000)");
+    EXPECT_TRUE(*eval("(f64vector? x)")->as<BooleanValue>());
+    EXPECT_TRUE(*eval("(eq? x x)")->as<BooleanValue>());
+    EXPECT_FALSE(*eval("(eq? x (f64vector 1 2 3.5))")->as<BooleanValue>());
+    EXPECT_EQ(eval("(f64vector-ref x 2)")->as<NumericValue>(), 3.5);
+    EXPECT_EQ(eval("(f64vector-length (make-f64vector 10 1))")->as<FixnumValue>(), 10);
+    EXPECT_EQ(eval("(f64vector->list y)")->toString(), "(4 5 6)");
+    EXPECT_THROW(eval("(f64vector-ref x 3)"), LispError);
+    EXPECT_THROW(eval("(f64vector-ref x 4294967296)"), LispError);
+    EXPECT_THROW(eval("(f64vector-set! x 4294967297 0)"), LispError);
+    EXPECT_THROW(eval("(make-f64vector 4294967296000000000)"), LispError);
+    EXPECT_THROW(eval("(f64vector 1 'a)"), LispError);
+
+    EXPECT_EQ(eval("(f64vector+ x y)")->toString(), "#f64(5 7 9.500000)");
+    EXPECT_EQ(eval("(f64vector- y x)")->toString(), "#f64(3 3 2.500000)");
+    EXPECT_EQ(eval("(f64vector* x y)")->toString(), "#f64(4 10 21)");
+    EXPECT_EQ(eval("(f64vector/ y (f64vector 2 2 2))")->toString(), "#f64(2 2.500000 3)");
+    EXPECT_EQ(eval("(f64vector-scale 2 x)")->toString(), "#f64(2 4 7)");
+    EXPECT_EQ(eval("(f64vector-axpy 2 x y)")->toString(), "#f64(6 9 13)");
+    EXPECT_EQ(eval("(f64vector-dot x y)")->as<NumericValue>(), 35.0);
+    EXPECT_EQ(eval("(f64vector-sum x)")->as<NumericValue>(), 6.5);
+    EXPECT_EQ(eval("(f64vector-min y)")->as<NumericValue>(), 4.0);
+    EXPECT_EQ(eval("(f64vector-max y)")->as<NumericValue>(), 6.0);
+    EXPECT_THROW(eval("(f64vector+ x (f64vector 1))"), LispError);
+    EXPECT_THROW(eval("(f64vector-max (f64vector))"), LispError);
+
+    eval("(f64vector-set! x 0 10)");
+    EXPECT_EQ(eval("(f64vector-ref x 0)")->as<NumericValue>(), 10.0);
+    EXPECT_TRUE(*eval("(equal? (f64vector 1 2) (f64vector 1.0 2))")->as<BooleanValue>());
+
+    // map and reduce take f64vectors, builtins and lambdas alike
+    EXPECT_EQ(eval("(map - x)")->toString(), "#f64(-10 -2 -3.500000)");
+    EXPECT_EQ(eval("(map (lambda (a) (* a a)) y)")->toString(), "#f64(16 25 36)");
+    EXPECT_THROW(eval("(map (lambda (a) 'a) y)"), LispError);
+    EXPECT_EQ(eval("(reduce + y)")->as<NumericValue>(), 15.0);
+    EXPECT_EQ(eval("(reduce * y)")->as<NumericValue>(), 120.0);
+    EXPECT_EQ(eval("(reduce (lambda (a b) (- a b)) y)")->as<NumericValue>(), -7.0);
+
+    // The builtin fast paths on lists give the results of calling the builtin
+    EXPECT_EQ(eval("(reduce + '(1 2 3))")->as<FixnumValue>(), 6);
+    EXPECT_EQ(eval("(reduce * '(140737488355327 2 3))")->toString(), "844424930131962");
+    EXPECT_EQ(eval("(reduce * (list 140737488355327 140737488355327 1))")->getType(), ValueType::BIGNUM_VALUE);
+    EXPECT_EQ(eval("(reduce + (list 1 (expt 2 100) 1.5))")->getType(), ValueType::NUMERIC_VALUE);
+    EXPECT_EQ(eval("(map abs '(-1 2.5 -3))")->toString(), "(1 2.500000 3)");
+    EXPECT_EQ(eval("(map not '(#f 1))")->toString(), "(#t #f)");
+    EXPECT_THROW(eval("(reduce + '(1 a))"), LispError);
+}
+
+TEST_F(BuiltinsEvalTest, NDArrays) {
+    eval("(define a (list->ndarray '((1 2 3) (4 5 6))))");
+    EXPECT_EQ(eval("a")->toString(), "#2a((1 2 3) (4 5 6))");
+    EXPECT_TRUE(*eval("(ndarray? a)")->as<BooleanValue>());
+    EXPECT_EQ(eval("(ndarray-shape a)")->toString(), "(2 3)");
+    EXPECT_EQ(eval("(ndarray-ref a 1 2)")->as<NumericValue>(), 6.0);
+    EXPECT_EQ(eval("(make-ndarray 2 2 0.5)")->toString(), "#2a((0.500000 0.500000) (0.500000 0.500000))");
+    EXPECT_EQ(eval("(ndarray->list a)")->toString(), "((1 2 3) (4 5 6))");
+    EXPECT_THROW(eval("(ndarray-ref a 2 0)"), LispError);
+    EXPECT_THROW(eval("(ndarray-ref a 4294967296 0)"), LispError);
+    EXPECT_THROW(eval("(ndarray-set! a 0 4294967296 1)"), LispError);
+    EXPECT_THROW(eval("(make-ndarray 4294967296 4294967296)"), LispError);
+    EXPECT_THROW(eval("(make-ndarray 4294967296000000000 1)"), LispError);
+    EXPECT_THROW(eval("(list->ndarray '((1 2) (3)))"), LispError);
+
+    // Views share the elements of the array they come from
+    eval("(define t (ndarray-transpose a))");
+    eval("(define s (ndarray-slice a 0 2 1 3))");
+    EXPECT_EQ(eval("t")->toString(), "#2a((1 4) (2 5) (3 6))");
+    EXPECT_EQ(eval("s")->toString(), "#2a((2 3) (5 6))");
+    eval("(ndarray-set! t 2 1 60)");
+    EXPECT_EQ(eval("(ndarray-ref a 1 2)")->as<NumericValue>(), 60.0);
+    EXPECT_EQ(eval("(ndarray-ref s 1 1)")->as<NumericValue>(), 60.0);
+    eval("(define c (ndarray-copy s))");
+    eval("(ndarray-set! c 0 0 0)");
+    EXPECT_EQ(eval("(ndarray-ref a 0 1)")->as<NumericValue>(), 2.0);
+    EXPECT_THROW(eval("(ndarray-slice a 0 3 0 1)"), LispError);
+    EXPECT_THROW(eval("(ndarray-slice a 0 4294967297 0 1)"), LispError);
+    EXPECT_EQ(eval("(ndarray-shape (ndarray-slice a 1 1 0 3))")->toString(), "(0 3)");
+
+    // Elementwise operations take views as well
+    EXPECT_EQ(eval("(ndarray+ s (ndarray-transpose (ndarray-slice t 1 3 0 2)))")->toString(), "#2a((4 6) (10 120))");
+    EXPECT_EQ(eval("(ndarray- s s)")->toString(), "#2a((0 0) (0 0))");
+    EXPECT_EQ(eval("(ndarray* s s)")->toString(), "#2a((4 9) (25 3600))");
+    EXPECT_EQ(eval("(ndarray/ s (make-ndarray 2 2 2))")->toString(), "#2a((1 1.500000) (2.500000 30))");
+    EXPECT_EQ(eval("(ndarray-scale 2 t)")->toString(), "#2a((2 8) (4 10) (6 120))");
+    EXPECT_THROW(eval("(ndarray+ a t)"), LispError);
+
+    EXPECT_EQ(eval("(ndarray-matmul a t)")->toString(), "#2a((14 194) (194 3641))");
+    EXPECT_EQ(eval("(ndarray-matmul t s)")->toString(), "#2a((22 243) (29 306) (306 3609))");
+    EXPECT_THROW(eval("(ndarray-matmul a a)"), LispError);
+    EXPECT_TRUE(*eval("(equal? (ndarray-copy t) t)")->as<BooleanValue>());
+    EXPECT_FALSE(*eval("(eq? (ndarray-copy t) t)")->as<BooleanValue>());
+}
+
+TEST_F(BuiltinsEvalTest, ArrayMap) {
+    auto hasKernel = [&](const std::string& lambda) {
+        return Batch::bind(*valueCast<LambdaValue>(eval(lambda))).has_value();
+    };
+    eval("(define a 2)");
+    eval("(define b 1)");
+    eval("(define v (f64vector -2 -0.5 0 3))");
+    eval("(define (affine a b v) (array-map (lambda (x) (+ (* a x) b)) v))");
+    EXPECT_EQ(eval("(array-map (lambda (x) (+ (* a x) b)) v)")->toString(), "#f64(-3 0 1 7)");
+    EXPECT_EQ(eval("(affine 3 -1 v)")->toString(), "#f64(-7 -2.500000 -1 8)");
+    EXPECT_EQ(eval("(array-map (lambda (x) (if (< x 0) (- x) (* x x))) v)")->toString(), "#f64(2 0.500000 0 9)");
+    EXPECT_EQ(eval("(array-map (lambda (x) (if (not (>= x 0)) (abs x) (/ x))) (f64vector -4 4))")->toString(), "#f64(4 0.250000)");
+    EXPECT_EQ(eval("(array-map (lambda (x) (+)) v)")->toString(), "#f64(0 0 0 0)");
+    EXPECT_EQ(eval("(array-map (lambda (x) (* 10 x)) (ndarray-transpose (list->ndarray '((1 2) (3 4)))))")->toString(),
+              "#2a((10 30) (20 40))");
+
+    // Lambdas of arithmetic and comparisons get a kernel, anything else is called
+    EXPECT_TRUE(hasKernel("(lambda (x) (+ (* a x) b))"));
+    EXPECT_TRUE(hasKernel("(lambda (x) (if (= x 0) 0 (/ 1 x)))"));
+    EXPECT_FALSE(hasKernel("(lambda (x) (begin (+ (* a x) b)))"));
+    EXPECT_FALSE(hasKernel("(lambda (x) (+ x undefined-variable))"));
+    EXPECT_FALSE(hasKernel("(lambda (x y) (+ x y))"));
+    EXPECT_FALSE(hasKernel("(lambda (x) (< x 0))"));
+    EXPECT_EQ(eval("(array-map (lambda (x) (< x 0)) (f64vector))")->toString(), "#f64()");
+    EXPECT_THROW(eval("(array-map (lambda (x) (< x 0)) v)"), LispError);
+    EXPECT_EQ(eval("(let ((+ -)) (array-map (lambda (x) (+ x 1)) v))")->toString(), "#f64(-3 -1.500000 -1 2)");
+
+    // The kernel agrees with calling the lambda, across batches
+    eval("(define xs (make-f64vector 1000))");
+    eval("(define (fill i) (if (< i 1000) (begin (f64vector-set! xs i (- (* i 0.37) 100)) (fill (+ i 1)))))");
+    eval("(fill 0)");
+    EXPECT_TRUE(*eval("(equal? (array-map (lambda (x) (if (> x 0) (/ (- x a) 3) (* x x b))) xs)"
+                      "        (array-map (lambda (x) (begin (if (> x 0) (/ (- x a) 3) (* x x b)))) xs))")->as<BooleanValue>());
+
+    // Division by zero fails only where the division is taken
+    EXPECT_EQ(eval("(array-map (lambda (x) (if (= x 0) 0 (/ 1 x))) (f64vector 2 0))")->toString(), "#f64(0.500000 0)");
+    EXPECT_THROW(eval("(array-map (lambda (x) (/ 1 x)) (f64vector 2 0))"), LispError);
+    eval("(define z 0)");
+    EXPECT_THROW(eval("(array-map (lambda (x) (/ x z)) v)"), LispError);
+
+    // Kernels assume the names of the operators mean the builtins
+    eval("(define b 'b)");
+    EXPECT_THROW(eval("(array-map (lambda (x) (+ (* a x) b)) v)"), LispError);
+    eval("(define (scale x) (* a x))");
+    eval("(define * +)");
+    EXPECT_EQ(eval("(array-map scale v)")->toString(), "#f64(0 1.500000 2 5)");
+}
@@ -0,0 +1,69 @@
+//
+// Created by timetraveler314 on 6/7/24.
+//
+
+#include "../src/gc.h"
+
+class GCTest : public BuiltinsEvalTest {
+protected:
+    void testCycles() {
+        // Each call leaves a frame and the closure defined in it pointing at each other
+        eval("(define (make-adder n) (define (add x) (+ x n)) add)");
+        eval("(define kept (make-adder 1))");
+        GC::collect();
+        auto before = GC::stats().tracked;
+        for (int i = 0; i < 100; i++) eval("(make-adder 2)");
+        EXPECT_GE(GC::stats().tracked, before + 100);
+        EXPECT_GE(GC::collect(), 100);
+        EXPECT_EQ(GC::stats().tracked, before);
+
+        // Live closures and their frames survive
+        EXPECT_EQ(eval("(kept 41)")->toString(), "42");
+    }
+};
+
+TEST_F(GCTest, CollectsClosureCycles) {
+    testCycles();
+}
+
+TEST_F(GCTest, CollectsClosureCyclesVM) {
+    env->setEngine(Engine::VM);
+    testCycles();
+}
+
+TEST_F(GCTest, KeepsHandlesAlive) {
+    auto closure = eval("((lambda () (define (f) 42) f))");
+    auto list = eval("((lambda () (define (g) 7) (list g g)))");
+    GC::collect();
+    EXPECT_EQ(env->apply(closure, {})->toString(), "42");
+    auto g = list->toVector()[0];
+    EXPECT_EQ(env->apply(g, {})->toString(), "7");
+}
+
+TEST_F(GCTest, CollectsHashTableCycles) {
+    eval("(define kept (make-hash-table))");
+    eval("(hash-set! kept 'me kept)");
+    GC::collect();
+    auto before = GC::stats().tracked;
+    for (int i = 0; i < 100; i++) eval("(let ((h (make-hash-table))) (hash-set! h 'me h) 1)");
+    EXPECT_GE(GC::stats().tracked, before + 100);
+    EXPECT_GE(GC::collect(), 100);
+    EXPECT_EQ(GC::stats().tracked, before);
+
+    // Tables reachable from a live binding survive
+    EXPECT_TRUE(*eval("(eq? kept (hash-ref kept 'me))")->as<BooleanValue>());
+}
+
+TEST_F(GCTest, CollectsVectorCycles) {
+    eval("(define kept (vector 1 2))");
+    eval("(vector-set! kept 0 kept)");
+    GC::collect();
+    auto before = GC::stats().tracked;
+    for (int i = 0; i < 100; i++) eval("(let ((v (make-vector 2 0))) (vector-set! v 0 (list v)) 1)");
+    EXPECT_GE(GC::stats().tracked, before + 100);
+    EXPECT_GE(GC::collect(), 100);
+    EXPECT_EQ(GC::stats().tracked, before);
+
+    EXPECT_TRUE(*eval("(eq? kept (vector-ref kept 0))")->as<BooleanValue>());
+    EXPECT_EQ(eval("(vector-ref kept 1)")->toString(), "2");
+}
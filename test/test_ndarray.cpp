@@ -0,0 +1,41 @@
+//
+// Created by timetraveler314 on 6/17/24.
+//
+
+#include <random>
+
+#include "../src/ndarray.h"
+
+// Blocked products agree with the textbook triple loop, across block edges and on strided operands
+TEST(NDArrayTest, Matmul) {
+    std::mt19937 rng(314);
+    std::uniform_real_distribution<double> distribution(-1, 1);
+    auto random = [&](size_t rows, size_t cols) {
+        auto array = std::make_shared<NDArrayValue>(rows, cols);
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) (*array)(i, j) = distribution(rng);
+        }
+        return array;
+    };
+    auto expectProduct = [](const NDArrayValue& x, const NDArrayValue& y) {
+        auto product = NDArrayValue::matmul(x, y);
+        ASSERT_EQ(product->rows(), x.rows());
+        ASSERT_EQ(product->cols(), y.cols());
+        for (size_t i = 0; i < x.rows(); i++) {
+            for (size_t j = 0; j < y.cols(); j++) {
+                double expected = 0;
+                for (size_t p = 0; p < x.cols(); p++) expected += x(i, p) * y(p, j);
+                ASSERT_NEAR((*product)(i, j), expected, 1e-9);
+            }
+        }
+    };
+
+    expectProduct(*random(3, 5), *random(5, 1));
+    expectProduct(*random(70, 300), *random(300, 260));
+    // Large enough to be split between threads
+    auto x = random(200, 150), y = random(150, 200);
+    ASSERT_GE(x->rows() * x->cols() * y->cols(), NDArrayValue::PARALLEL_THRESHOLD);
+    expectProduct(*x, *y);
+    expectProduct(*y->transpose(), *x->transpose());
+    expectProduct(*x->slice(10, 190, 5, 140), *y->slice(5, 140, 1, 199));
+}
@@ -0,0 +1,85 @@
+//
+// Created by timetraveler314 on 6/16/24.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "../src/simd.h"
+
+// Every level available agrees with plain loops, at lengths covering the partial vectors at the end
+TEST(SimdTest, LevelsAgree) {
+    std::mt19937 rng(314);
+    std::uniform_real_distribution<double> distribution(-10, 10);
+    auto initial = Simd::level();
+    for (auto level : {Simd::Level::SCALAR, Simd::Level::SSE2, Simd::Level::AVX2}) {
+        Simd::setLevel(level);
+        for (size_t n : {1, 3, 4, 7, 8, 9, 31, 1000}) {
+            std::vector<double> x(n), y(n), out(n);
+            for (size_t i = 0; i < n; i++) {
+                x[i] = distribution(rng);
+                y[i] = distribution(rng) + 20; // Non-zero divisors
+            }
+            Simd::add(x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] + y[i]);
+            Simd::sub(x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] - y[i]);
+            Simd::mul(x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] * y[i]);
+            Simd::div(x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] / y[i]);
+            Simd::scale(2.5, x.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], 2.5 * x[i]);
+            out = y;
+            Simd::axpy(-3, x.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], y[i] + -3 * x[i]);
+            Simd::abs(x.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], std::abs(x[i]));
+
+            // Comparison masks pick elements by select, here against some equal elements
+            std::vector<double> z(x), mask(n);
+            for (size_t i = 0; i < n; i += 3) z[i] = distribution(rng);
+            Simd::less(x.data(), z.data(), mask.data(), n);
+            Simd::select(mask.data(), x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] < z[i] ? x[i] : y[i]);
+            Simd::lessEqual(x.data(), z.data(), mask.data(), n);
+            Simd::select(mask.data(), x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] <= z[i] ? x[i] : y[i]);
+            Simd::equal(x.data(), z.data(), mask.data(), n);
+            Simd::select(mask.data(), x.data(), y.data(), out.data(), n);
+            for (size_t i = 0; i < n; i++) ASSERT_EQ(out[i], x[i] == z[i] ? x[i] : y[i]);
+
+            double sum = 0, dot = 0;
+            for (size_t i = 0; i < n; i++) {
+                sum += x[i];
+                dot += x[i] * y[i];
+            }
+            // Sums may round differently in another order
+            EXPECT_NEAR(Simd::sum(x.data(), n), sum, 1e-9);
+            EXPECT_NEAR(Simd::dot(x.data(), y.data(), n), dot, 1e-9);
+            EXPECT_EQ(Simd::min(x.data(), n), *std::ranges::min_element(x));
+            EXPECT_EQ(Simd::max(x.data(), n), *std::ranges::max_element(x));
+        }
+    }
+    Simd::setLevel(initial);
+    EXPECT_EQ(Simd::level(), Simd::supported());
+}
+
+// A NaN anywhere makes min and max NaN at every level, in a full vector or in the tail
+TEST(SimdTest, MinMaxPropagateNaN) {
+    auto initial = Simd::level();
+    for (auto level : {Simd::Level::SCALAR, Simd::Level::SSE2, Simd::Level::AVX2}) {
+        Simd::setLevel(level);
+        for (size_t n : {1, 2, 5, 8, 9}) {
+            for (size_t at = 0; at < n; at++) {
+                std::vector<double> x(n);
+                for (size_t i = 0; i < n; i++) x[i] = double(i) - 3;
+                x[at] = std::nan("");
+                EXPECT_TRUE(std::isnan(Simd::min(x.data(), n))) << "n = " << n << ", NaN at " << at;
+                EXPECT_TRUE(std::isnan(Simd::max(x.data(), n))) << "n = " << n << ", NaN at " << at;
+            }
+        }
+    }
+    Simd::setLevel(initial);
+}
@@ -5,6 +5,8 @@
 #include "../src/eval_env.h"
 #include "../src/tokenizer.h"
 #include "../src/parser.h"
+#include "../src/folding.h"
+#include "../src/inlining.h"
 
 class SpecialFormsTest : public ::testing::Test {
 protected:
@@ -14,13 +16,16 @@ protected:
 
     std::shared_ptr<EvalEnv> env;
 
-    std::string eval(const std::string& input) {
+    ValuePtr parse(const std::string& input) {
         Tokenizer tokenizer;
         Parser parser(tokenizer);
         auto valueTask = parser.parse();
         tokenizer.feed(input);
-        auto result = env->eval(valueTask.get_result().value());
-        return result->toString();
+        return valueTask.get_result().value();
+    }
+
+    std::string eval(const std::string& input) {
+        return env->eval(parse(input))->toString();
     }
 };
 
@@ -104,4 +109,157 @@ TEST_F(SpecialFormsTest, Cond) {
     EXPECT_THROW(eval("(cond (#f 1) (else))"), LispError);
     EXPECT_THROW(eval("(cond (else 0) (#f 1))"), LispError);
     EXPECT_THROW(eval("(cond #f (#f 1))"), LispError);
-}
\ No newline at end of file
+}
+TEST_F(SpecialFormsTest, Let) {
+    EXPECT_EQ(eval("(let ((x 1) (y 2)) (+ x y))"), "3");
+    EXPECT_EQ(eval("(let ((x 1)) (let ((x 2) (y x)) (+ x y)))"), "3");
+
+    EXPECT_THROW(eval("(let ((x)) x)"), LispError);
+    EXPECT_THROW(eval("(let ((1 2)) 1)"), LispError);
+}
+
+TEST_F(SpecialFormsTest, Lambda) {
+    EXPECT_EQ(eval("((lambda (x y) (+ x y)) 1 2)"), "3");
+    EXPECT_EQ(eval("(define (adder n) (lambda (x) (+ x n)))"), "()");
+    EXPECT_EQ(eval("((adder 40) 2)"), "42");
+
+    // Malformed forms in a body are only reported once they are evaluated
+    EXPECT_EQ(eval("(define (broken) (if))"), "()");
+    EXPECT_THROW(eval("(broken)"), LispError);
+}
+
+TEST_F(SpecialFormsTest, LexicalScope) {
+    // Inner bindings shadow outer ones, closures see the frame they were created in
+    EXPECT_EQ(eval("(define x 'global)"), "()");
+    EXPECT_EQ(eval("(define (shadow x) (let ((x (+ x 1))) (lambda () x)))"), "()");
+    EXPECT_EQ(eval("((shadow 1))"), "2");
+    EXPECT_EQ(eval("x"), "global");
+
+    // Internal definitions live in the procedure's frame and may refer to each other
+    EXPECT_EQ(eval("(define (parity n) (define (ev? n) (if (= n 0) #t (od? (- n 1)))) (define (od? n) (if (= n 0) #f (ev? (- n 1)))) (ev? n))"), "()");
+    EXPECT_EQ(eval("(parity 7)"), "#f");
+    EXPECT_THROW(eval("ev?"), LispError);
+
+    // Globals referenced from a body may be defined later
+    EXPECT_EQ(eval("(define (later) (helper))"), "()");
+    EXPECT_THROW(eval("(later)"), LispError);
+    EXPECT_EQ(eval("(define (helper) 'found)"), "()");
+    EXPECT_EQ(eval("(later)"), "found");
+}
+
+TEST_F(SpecialFormsTest, TailCalls) {
+    // Calls in tail position of if, cond, let, begin, and, or run in constant stack space
+    EXPECT_EQ(eval("(define (loop n) (if (= n 0) 'done (loop (- n 1))))"), "()");
+    EXPECT_EQ(eval("(loop 200000)"), "done");
+    EXPECT_EQ(eval("(define (ev? n) (cond ((= n 0) #t) (else (let ((m (- n 1))) (od? m)))))"), "()");
+    EXPECT_EQ(eval("(define (od? n) (and (not (= n 0)) (begin (ev? (- n 1)))))"), "()");
+    EXPECT_EQ(eval("(ev? 200001)"), "#f");
+    EXPECT_EQ(eval("(define (count n acc) (or (and (= n 0) acc) (count (- n 1) (+ acc 1))))"), "()");
+    EXPECT_EQ(eval("(count 200000 0)"), "200000");
+}
+
+TEST_F(SpecialFormsTest, Quasiquote) {
+    EXPECT_EQ(eval("`(1 2)"), "(1 2)");
+    EXPECT_EQ(eval("`(1 ,(+ 1 1) (3 ,(+ 2 2)))"), "(1 2 (3 4))");
+    // Unquotes inside a nested quasiquote belong to it, unless unquoted once more
+    EXPECT_EQ(eval("`(1 `(2 ,(+ 1 2)))"), "(1 (quasiquote (2 (unquote (+ 1 2)))))");
+    EXPECT_EQ(eval("`(1 `(2 ,,(+ 1 2)))"), "(1 (quasiquote (2 (unquote 3))))");
+}
+
+TEST_F(SpecialFormsTest, ConstantFolding) {
+    auto fold = [this](const std::string& input, const Compiler::ScopePtr& scope = nullptr) {
+        auto folded = Folding::fold(parse(input), scope);
+        return folded ? folded->value->toString() : "not constant";
+    };
+    EXPECT_EQ(fold("(* 60 60 24)"), "86400");
+    EXPECT_EQ(fold("(+ 1 (if (< 1 2) (car '(2 3)) x))"), "3");
+    EXPECT_EQ(fold("(cond (#t 1))"), "not constant");
+    EXPECT_EQ(fold("(+ x 1)"), "not constant");
+    EXPECT_EQ(fold("(cons 1 2)"), "not constant"); // Allocates a fresh pair each time
+    EXPECT_EQ(fold("(/ 1 0)"), "not constant");
+    EXPECT_EQ(fold("(+ 1 2)", std::make_shared<Compiler::Scope>(nullptr, std::vector<Symbol>{"+"})), "not constant");
+    EXPECT_EQ(Folding::fold(parse("(= (- 2 1) (* 1 1))"), nullptr)->assumptions.size(), 3);
+    // Large exact products and powers are left to run
+    EXPECT_EQ(fold("(expt 2 100)"), "1267650600228229401496703205376");
+    EXPECT_EQ(fold("(expt 3 3000000)"), "not constant");
+    EXPECT_EQ(fold("(* (expt 2 1500) (expt 2 1500))"), "not constant");
+
+    // Folded code notices the builtins it assumed being redefined
+    EXPECT_EQ(eval("(define (minutes) (- 100 1))"), "()");
+    EXPECT_EQ(eval("(define (pick) (if (< 1 2) 'yes 'no))"), "()");
+    EXPECT_EQ(eval("(define (which) (cond ((> 1 2) 'a) ((= 1 1) 'b) (else 'c)))"), "()");
+    EXPECT_EQ(eval("(list (minutes) (pick) (which))"), "(99 yes b)");
+    EXPECT_EQ(eval("(define (- a b) 42)"), "()");
+    EXPECT_EQ(eval("(define (< a b) #f)"), "()");
+    EXPECT_EQ(eval("(define (= a b) #f)"), "()");
+    EXPECT_EQ(eval("(list (minutes) (pick) (which))"), "(42 no c)");
+
+    // Errors are left to the run time
+    EXPECT_EQ(eval("(define (fail) (/ 1 0))"), "()");
+    EXPECT_THROW(eval("(fail)"), LispError);
+    EXPECT_EQ(eval("(if #f (car '()) 1)"), "1");
+
+    // Branches a constant test skips are not folded, they may never run
+    EXPECT_EQ(eval("(define (dead x) (if (> 1 2) (* (expt 3 100) (expt 3 100)) x))"), "()");
+    EXPECT_EQ(eval("(dead 1)"), "1");
+    EXPECT_EQ(eval("(define (> a b) #t)"), "()");
+    EXPECT_EQ(eval("(dead 1)"), "265613988875874769338781322035779626829233452653394495974574961739092490901302182994384699044001");
+}
+
+TEST_F(SpecialFormsTest, Inlining) {
+    EXPECT_EQ(eval("(define (square x) (* x x))"), "()");
+    EXPECT_EQ(eval("(define (sum-squares a b) (+ (square a) (square b)))"), "()");
+    EXPECT_EQ(eval("(define (hypot2 a b) (let ((s (sum-squares a b))) s))"), "()");
+    EXPECT_EQ(eval("(hypot2 3 4)"), "25");
+    // Nested expansions and arguments that expand the same callee
+    EXPECT_EQ(eval("(define (f x) (square (square (+ x 1))))"), "()");
+    EXPECT_EQ(eval("(f 1)"), "16");
+
+    // Recursive procedures are not expanded, and a caller's local shadows the global name
+    EXPECT_FALSE(Inlining::define("loop", {"n"}, {parse("(if (= n 0) 0 (loop (- n 1)))")}));
+    EXPECT_EQ(eval("(define (g square) (square 2))"), "()");
+    EXPECT_EQ(eval("(g (lambda (x) 7))"), "7");
+    EXPECT_EQ(eval("(define (offset x) (+ x base))"), "()");
+    EXPECT_EQ(eval("(define base 100)"), "()");
+    EXPECT_EQ(eval("(define (h base) (offset base))"), "()");
+    EXPECT_EQ(eval("(h 1)"), "101");
+
+    // Redefining the callee takes effect in callers compiled before
+    EXPECT_EQ(eval("(define (square x) (+ x x))"), "()");
+    EXPECT_EQ(eval("(hypot2 3 4)"), "14");
+    EXPECT_EQ(eval("(define square 0)"), "()");
+    EXPECT_THROW(eval("(hypot2 3 4)"), LispError);
+
+    // An expansion releases its arguments when it returns, while the caller's frame lives on
+    static std::weak_ptr<Value> tracked;
+    env->defineBinding("track", std::make_shared<BuiltinProcValue>(BuiltinSpec{
+        .func = [](Arguments params, EvalEnv&) { tracked = params[0]; return params[0]; }, .minArgs = 1, .maxArgs = 1}));
+    env->defineBinding("released?", std::make_shared<BuiltinProcValue>(BuiltinSpec{
+        .func = [](Arguments, EvalEnv&) { return Value::boolean(tracked.expired()); }, .minArgs = 0, .maxArgs = 0}));
+    EXPECT_EQ(eval("(define (head xs) (car xs))"), "()");
+    EXPECT_EQ(eval("(define (run) (head (track (list 1 2 3))) (released?))"), "()");
+    EXPECT_EQ(eval("(run)"), "#t");
+}
+
+TEST_F(SpecialFormsTest, FrameEscape) {
+    auto captured = [this](const std::string& body) {
+        return Compiler::compileFunction({"x"}, {parse(body)}, nullptr).frame.captured;
+    };
+    EXPECT_FALSE(captured("(+ x 1)"));
+    EXPECT_FALSE(captured("(let ((y x)) (* y y))"));
+    EXPECT_TRUE(captured("(lambda (y) (+ x y))"));
+    EXPECT_TRUE(captured("(let ((y x)) (lambda () y))"));
+    EXPECT_TRUE(captured("(begin (define (inner) x) (inner))"));
+
+    // Frames from the frame stack are reused once their call returns, captured ones stay
+    EXPECT_EQ(eval("(define (make-adder n) (lambda (x) (+ x n)))"), "()");
+    EXPECT_EQ(eval("(define (twice f x) (f (f x)))"), "()");
+    EXPECT_EQ(eval("(define add1 (make-adder 1))"), "()");
+    EXPECT_EQ(eval("(define add10 (make-adder 10))"), "()");
+    EXPECT_EQ(eval("(list (twice add1 0) (twice add10 0) (twice add1 5))"), "(2 20 7)");
+
+    // A frame held by an error is left alone
+    EXPECT_EQ(eval("(define (fail x) (let ((y (car x))) y))"), "()");
+    EXPECT_THROW(eval("(twice fail 1)"), LispError);
+    EXPECT_EQ(eval("(twice add10 (let ((z 1)) z))"), "21");
+}
@@ -0,0 +1,113 @@
+//
+// Created by timetraveler314 on 6/3/24.
+//
+#include <gtest/gtest.h>
+#include "../src/eval_env.h"
+#include "../src/tokenizer.h"
+#include "../src/parser.h"
+#include "../src/vm/vm.h"
+
+class VMTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        env = EvalEnv::createGlobal();
+        env->setEngine(Engine::VM);
+    }
+
+    std::shared_ptr<EvalEnv> env;
+
+    static ValuePtr parse(const std::string& input) {
+        Tokenizer tokenizer;
+        Parser parser(tokenizer);
+        auto valueTask = parser.parse();
+        tokenizer.feed(input);
+        return valueTask.get_result().value();
+    }
+
+    std::string eval(const std::string& input) {
+        return env->eval(parse(input))->toString();
+    }
+};
+
+TEST_F(VMTest, Basics) {
+    EXPECT_EQ(eval("42"), "42");
+    EXPECT_EQ(eval("'(1 2)"), "(1 2)");
+    EXPECT_EQ(eval("(+ 1 (* 2 3))"), "7");
+    EXPECT_EQ(eval("(if (< 1 2) 'yes 'no)"), "yes");
+    EXPECT_EQ(eval("(if #f 1)"), "()");
+    EXPECT_EQ(eval("(and 1 2 3)"), "3");
+    EXPECT_EQ(eval("(and 1 #f 3)"), "#f");
+    EXPECT_EQ(eval("(or #f 2 3)"), "2");
+    EXPECT_EQ(eval("(cond (#f 1) ((+ 1 1)) (else 3))"), "2");
+    EXPECT_EQ(eval("(cond (#f 1) (else 2 3))"), "3");
+    EXPECT_EQ(eval("(begin 1 2 3)"), "3");
+    EXPECT_EQ(eval("`(1 ,(+ 1 1) 3)"), "(1 2 3)");
+    EXPECT_EQ(eval("(vector-ref #(1 (2) \"3\") 1)"), "(2)");
+}
+
+TEST_F(VMTest, Procedures) {
+    EXPECT_EQ(eval("(define (fact n) (if (= n 0) 1 (* n (fact (- n 1)))))"), "()");
+    EXPECT_EQ(eval("(fact 10)"), "3628800");
+
+    EXPECT_EQ(eval("(define (adder n) (lambda (x) (+ x n)))"), "()");
+    EXPECT_EQ(eval("((adder 40) 2)"), "42");
+    EXPECT_EQ(eval("(map (adder 1) '(1 2 3))"), "(2 3 4)");
+    EXPECT_EQ(eval("(let ((x 1) (y 2)) (let ((x 10)) (+ x y)))"), "12");
+
+    // Internal defines may refer to each other before they are evaluated
+    EXPECT_EQ(eval("(define (parity n) (define (ev? n) (if (= n 0) #t (od? (- n 1)))) (define (od? n) (if (= n 0) #f (ev? (- n 1)))) (ev? n))"), "()");
+    EXPECT_EQ(eval("(parity 10)"), "#t");
+
+    EXPECT_THROW(eval("((lambda (x) x))"), LispError);
+    EXPECT_THROW(eval("(1 2)"), LispError);
+    EXPECT_THROW(eval("undefined-variable"), LispError);
+}
+
+TEST_F(VMTest, GlobalsCanBeRebound) {
+    EXPECT_EQ(eval("(define (f x) (- x 1))"), "()");
+    EXPECT_EQ(eval("(f 3)"), "2");
+    EXPECT_EQ(eval("(define (- a b) (+ a b))"), "()");
+    EXPECT_EQ(eval("(f 3)"), "4");
+}
+
+TEST_F(VMTest, DeferredErrors) {
+    EXPECT_EQ(eval("(define (broken) (if))"), "()");
+    EXPECT_THROW(eval("(broken)"), LispError);
+}
+
+TEST_F(VMTest, DeepRecursion) {
+    // Activations live on the heap, so non-tail recursion is not bounded by the native stack
+    EXPECT_EQ(eval("(define (build n) (if (= n 0) '() (cons n (build (- n 1)))))"), "()");
+    EXPECT_EQ(eval("(length (build 300000))"), "300000");
+    EXPECT_EQ(eval("(define (loop n) (if (= n 0) 'done (loop (- n 1))))"), "()");
+    EXPECT_EQ(eval("(loop 300000)"), "done");
+
+    VM::setStackLimit(1 << 20);
+    EXPECT_EQ(eval("(length (build 100))"), "100");
+    EXPECT_THROW(eval("(build 300000)"), LispError);
+    EXPECT_EQ(eval("(loop 300000)"), "done"); // Tail calls reuse their activation
+    VM::setStackLimit(VM::DEFAULT_STACK_LIMIT);
+}
+
+TEST_F(VMTest, MatchesTreeEngine) {
+    auto tree = EvalEnv::createGlobal();
+    for (const auto& input : {
+            "(define (sum xs) (if (null? xs) 0 (+ (car xs) (sum (cdr xs)))))",
+            "(sum '(1 2 3 4))",
+            "(define lst (list 1 2 3))",
+            "(filter odd? (map (lambda (x) (* x x)) lst))",
+            "(reduce + (append lst lst))",
+            "(apply max2 '(1 2))",
+            "(define (max2 a b) (if (> a b) a b))",
+            "(apply max2 '(1 2))",
+            "(eval '(max2 3 4))",
+            "`(1 `(2 ,(+ 1 2)))",
+            "`(1 `(2 ,,(+ 1 2)))",
+            "`(1 `(2 ,(3 ,(+ 1 3))))",
+         }) {
+        std::string expected, actual;
+        try { expected = tree->eval(parse(input))->toString(); } catch (const LispError& e) { expected = "error"; }
+        try { actual = eval(input); } catch (const LispError& e) { actual = "error"; }
+        EXPECT_EQ(actual, expected) << input;
+    }
+}